@@ -13,6 +13,7 @@
 #include "fiber.h"
 #include "scheduler.h"
 #include "iomanager.h"
+#include "channel.h"
 #include "hook.h"
 #include "address.h"
 #include "socket.h"
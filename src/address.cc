@@ -1,5 +1,8 @@
 #include "address.h"
+#include "dns.h"
+#include "hook.h"
 #include "log.h"
+#include "offload.h"
 #include "endian.hpp"
 
 #include <sstream>
@@ -30,6 +33,30 @@ namespace HPS
         return result;
     }
 
+    //! 是否为数字形式的IPv4/IPv6地址
+    static bool IsNumericHost(const std::string &host)
+    {
+        in6_addr buf;
+        return inet_pton(AF_INET, host.c_str(), &buf) == 1 || inet_pton(AF_INET6, host.c_str(), &buf) == 1;
+    }
+
+    //! 端口是否为空或数字
+    static bool IsNumericPort(const char *service)
+    {
+        if (!service)
+        {
+            return true;
+        }
+        for (const char *p = service; *p; ++p)
+        {
+            if (!isdigit(*p))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
     Address::ptr Address::LookupAny(const std::string &host,
                                     int family, int type, int protocol)
     {
@@ -558,8 +585,38 @@ namespace HPS
         {
             node = host;
         }
-        //! 参数分别是：域名，端口，用户设定的 struct addrinfo 结构体，通过result指针参数返回一个指向addrinfo结构体链表的指针
-        int error = getaddrinfo(node.c_str(), service, &hints, &results);
+        //! hook的协程中用DnsResolver解析, 只挂起当前协程; 数字地址和服务名仍交给getaddrinfo
+        bool fallback = false;
+        if (is_hook_enable() && DnsResolver::IsEnabled() && ChannelWaiter::CanSuspend() && (family == AF_INET || family == AF_INET6 || family == AF_UNSPEC) && !IsNumericHost(node) && IsNumericPort(service))
+        {
+            std::vector<IPAddress::ptr> addrs;
+            if (DnsMgr::GetInstance()->resolve(addrs, node, family))
+            {
+                uint16_t port = service ? atoi(service) : 0;
+                for (auto &i : addrs)
+                {
+                    i->setPort(port);
+                    result.push_back(i);
+                }
+                return true;
+            }
+            LOG_DEBUG(g_logger) << "Address::Lookup resolve(" << host << ", "
+                                << family << ") fail, fallback to getaddrinfo";
+            fallback = true;
+        }
+        int error = 0;
+        //! 解析失败(域名不存在, 超时, 应答截断)时交给getaddrinfo: 它还会按nsswitch查其他来源, 截断时改用TCP;
+        //! 在卸载线程中执行, 只挂起当前协程
+        if (fallback)
+        {
+            error = OffloadMgr::GetInstance()->call([&]()
+                                                    { return getaddrinfo(node.c_str(), service, &hints, &results); });
+        }
+        else
+        {
+            //! 参数分别是：域名，端口，用户设定的 struct addrinfo 结构体，通过result指针参数返回一个指向addrinfo结构体链表的指针
+            error = getaddrinfo(node.c_str(), service, &hints, &results);
+        }
         if (error)
         {
             LOG_DEBUG(g_logger) << "Address::Lookup getaddress(" << host << ", "
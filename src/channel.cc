@@ -0,0 +1,138 @@
+#include "channel.h"
+
+#include <algorithm>
+
+namespace HPS
+{
+
+    ChannelWaiter::ChannelWaiter()
+    {
+        //! 只有调度器中的任务协程可以挂起, 其他情况阻塞线程
+        if (CanSuspend())
+        {
+            m_scheduler = Scheduler::GetThis();
+            m_fiber = Fiber::GetThis();
+            m_scheduler->addParkedFiber();
+        }
+    }
+
+    bool ChannelWaiter::CanSuspend()
+    {
+        return Scheduler::GetThis() && !Scheduler::InNonBlockingTask() && Fiber::GetThis().get() != Scheduler::GetMainFiber();
+    }
+
+    void ChannelWaiter::wait()
+    {
+        if (m_scheduler)
+        {
+            //! 唤醒可能先于挂起被调度, 调度器跳过仍在执行的协程直到它切出
+            Fiber::YieldToHold();
+        }
+        else
+        {
+            m_sem.wait();
+        }
+    }
+
+    void ChannelWaiter::wake()
+    {
+        if (m_scheduler)
+        {
+            Fiber::ptr fiber = std::move(m_fiber);
+            Scheduler::Priority priority = (Scheduler::Priority)fiber->getPriority();
+            m_scheduler->schedule(std::move(fiber), -1, priority);
+            m_scheduler->delParkedFiber();
+        }
+        else
+        {
+            m_sem.notify();
+        }
+    }
+
+    int ChannelSelect::addCase(Case *c)
+    {
+        m_cases.push_back(std::unique_ptr<Case>(c));
+        return m_cases.size() - 1;
+    }
+
+    //! 每次选择的起点, 多个分支就绪时轮流选择
+    static thread_local uint32_t t_select_start = 0;
+
+    int ChannelSelect::select(bool block)
+    {
+        if (m_cases.empty())
+        {
+            return -1;
+        }
+        //! 按地址顺序锁住所有通道, 登记期间不会有分支被唤醒
+        std::vector<ChannelBase *> channels;
+        for (auto &i : m_cases)
+        {
+            channels.push_back(i->channel());
+        }
+        std::sort(channels.begin(), channels.end());
+        channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+        for (auto i : channels)
+        {
+            i->m_mutex.lock();
+        }
+        auto unlock_all = [&channels]()
+        {
+            for (auto it = channels.rbegin(); it != channels.rend(); ++it)
+            {
+                (*it)->m_mutex.unlock();
+            }
+        };
+
+        int n = m_cases.size();
+        int start = t_select_start++ % n;
+        for (int k = 0; k < n; ++k)
+        {
+            int i = (start + k) % n;
+            ChannelWaiter::ptr wake;
+            int rt = m_cases[i]->tryLocked(wake);
+            if (rt != 0)
+            {
+                unlock_all();
+                if (wake)
+                {
+                    wake->wake();
+                }
+                m_cases[i]->finish();
+                if (m_cases[i]->result)
+                {
+                    *m_cases[i]->result = m_cases[i]->ok;
+                }
+                return i;
+            }
+        }
+        if (!block)
+        {
+            unlock_all();
+            return -1;
+        }
+
+        ChannelWaiter::ptr self(new ChannelWaiter);
+        for (int i = 0; i < n; ++i)
+        {
+            m_cases[i]->enqueueLocked(self, i);
+        }
+        unlock_all();
+        self->wait();
+
+        int index = self->getSelected();
+        ASSERT(index >= 0 && index < n);
+        //! 其他分支上的登记不再有效, 及时移除
+        for (auto &i : m_cases)
+        {
+            i->dequeue(self);
+        }
+        m_cases[index]->finish();
+        if (m_cases[index]->result)
+        {
+            *m_cases[index]->result = m_cases[index]->ok;
+        }
+        return index;
+    }
+
+}
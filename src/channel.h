@@ -0,0 +1,625 @@
+#ifndef __CHANNEL_H__
+#define __CHANNEL_H__
+
+#include "macro.h"
+#include "scheduler.h"
+
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace HPS
+{
+
+    /**
+     * @brief 通道操作的等待者
+     * @details 在调度器的协程中等待时挂起协程, 唤醒时放回其所在的调度器; 否则阻塞在信号量上.
+     *          select时同一个等待者登记在多个通道上, 由claim()保证只被一个分支唤醒
+     */
+    class ChannelWaiter : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<ChannelWaiter> ptr;
+
+        /**
+         * @brief 以当前协程(或线程)构造等待者
+         */
+        ChannelWaiter();
+
+        /**
+         * @brief 当前上下文能否挂起协程
+         * @details 调度器中的任务协程可以挂起, 非阻塞任务和调度器主协程不能
+         */
+        static bool CanSuspend();
+
+        /**
+         * @brief 抢占等待者, 成功者负责完成数据交换并调用wake()
+         * @param[in] index 完成的分支下标
+         * @return 是否抢占成功
+         */
+        bool claim(int index)
+        {
+            int expected = -1;
+            return m_selected.compare_exchange_strong(expected, index);
+        }
+
+        /**
+         * @brief 返回完成的分支下标, 未完成时为-1
+         */
+        int getSelected() const { return m_selected; }
+
+        /**
+         * @brief 等待被唤醒
+         */
+        void wait();
+
+        /**
+         * @brief 唤醒等待者
+         * @pre claim()成功
+         */
+        void wake();
+
+    private:
+        /// 协程所在的调度器, 为空时使用信号量
+        Scheduler *m_scheduler = nullptr;
+        /// 等待的协程
+        Fiber::ptr m_fiber;
+        /// 非协程等待时使用的信号量
+        Semaphore m_sem;
+        /// 完成的分支下标
+        std::atomic<int> m_selected = {-1};
+    };
+
+    /**
+     * @brief 通道的公共部分
+     */
+    class ChannelBase : Noncopyable
+    {
+    public:
+        typedef Spinlock MutexType;
+
+        virtual ~ChannelBase() {}
+
+        /**
+         * @brief 是否已关闭
+         */
+        bool isClosed()
+        {
+            MutexType::Lock lock(m_mutex);
+            return m_closed;
+        }
+
+    protected:
+        friend class ChannelSelect;
+        /// 保护缓冲区和等待队列
+        MutexType m_mutex;
+        /// 是否已关闭
+        bool m_closed = false;
+    };
+
+    template <class T>
+    class Channel;
+
+    /**
+     * @brief 多通道选择
+     * @details 添加若干发送/接收分支, wait()完成其中恰好一个分支;
+     *          多个分支就绪时从轮转的起点开始选择, 避免总是偏向前面的分支
+     */
+    class ChannelSelect : Noncopyable
+    {
+    public:
+        /**
+         * @brief 分支
+         */
+        class Case
+        {
+        public:
+            virtual ~Case() {}
+            /// 分支所在的通道
+            virtual ChannelBase *channel() = 0;
+            /**
+             * @brief 持有通道锁时尝试完成
+             * @param[out] wake 需要唤醒的对端等待者
+             * @return 1完成, -1通道已关闭, 0未就绪
+             */
+            virtual int tryLocked(ChannelWaiter::ptr &wake) = 0;
+            /// 持有通道锁时登记等待者
+            virtual void enqueueLocked(const ChannelWaiter::ptr &waiter, int index) = 0;
+            /// 从通道上移除等待者
+            virtual void dequeue(const ChannelWaiter::ptr &waiter) = 0;
+            /// 分支完成后在调用者的协程中取回结果, 设置ok
+            virtual void finish() = 0;
+
+            /// 操作是否成功(通道关闭时为false)
+            bool ok = false;
+            /// 调用者的结果地址
+            bool *result = nullptr;
+        };
+
+        /**
+         * @brief 添加接收分支
+         * @param[out] value 接收到的值
+         * @param[out] ok 是否接收成功, 通道关闭且无数据时为false
+         * @return 分支下标
+         */
+        template <class T>
+        int recv(Channel<T> &ch, T &value, bool *ok = nullptr);
+
+        /**
+         * @brief 添加发送分支
+         * @param[out] ok 是否发送成功, 通道关闭时为false
+         * @return 分支下标
+         */
+        template <class T>
+        int send(Channel<T> &ch, const T &value, bool *ok = nullptr);
+
+        /**
+         * @brief 等待直到一个分支完成
+         * @return 完成的分支下标, 没有分支时返回-1
+         */
+        int wait() { return select(true); }
+
+        /**
+         * @brief 不等待, 完成一个已就绪的分支
+         * @return 完成的分支下标, 没有就绪的分支时返回-1
+         */
+        int tryWait() { return select(false); }
+
+    private:
+        int addCase(Case *c);
+        int select(bool block);
+
+    private:
+        /// 分支
+        std::vector<std::unique_ptr<Case>> m_cases;
+    };
+
+    template <class T>
+    class ChannelRecvCase;
+    template <class T>
+    class ChannelSendCase;
+
+    /**
+     * @brief 协程间的有界通道
+     * @details 容量为0时为无缓冲通道, 发送者等到接收者取走数据才返回; 否则使用环形缓冲区.
+     *          发送和接收在协程中等待时只挂起协程, 不阻塞线程, 两端可以位于不同的调度器;
+     *          关闭后发送失败, 接收在取完缓冲区后失败.
+     *          等待中交换的值和结果放在堆上的Slot中, 对端不会写入等待者的栈(共享栈协程挂起时栈被换出)
+     */
+    template <class T>
+    class Channel : public ChannelBase
+    {
+    public:
+        typedef std::shared_ptr<Channel> ptr;
+
+        /**
+         * @brief 构造函数
+         * @param[in] capacity 缓冲区容量, 0为无缓冲
+         */
+        Channel(size_t capacity = 0)
+            : m_capacity(capacity), m_buffer(capacity)
+        {
+        }
+
+        ~Channel()
+        {
+            ASSERT(m_senders.empty() && m_receivers.empty());
+        }
+
+        /**
+         * @brief 发送, 缓冲区满时等待
+         * @return 是否发送成功, 通道关闭时返回false
+         */
+        bool send(const T &value)
+        {
+            T tmp(value);
+            return send(std::move(tmp));
+        }
+
+        /**
+         * @brief 发送, 缓冲区满时等待
+         * @return 是否发送成功, 通道关闭时返回false且不移动value
+         */
+        bool send(T &&value)
+        {
+            ChannelWaiter::ptr wake;
+            ChannelWaiter::ptr self;
+            SlotPtr slot;
+            {
+                MutexType::Lock lock(m_mutex);
+                int rt = trySendLocked(value, wake);
+                if (rt != 0)
+                {
+                    lock.unlock();
+                    if (wake)
+                    {
+                        wake->wake();
+                    }
+                    return rt == 1;
+                }
+                self.reset(new ChannelWaiter);
+                slot = std::make_shared<Slot>();
+                slot->value = std::move(value);
+                m_senders.push_back(Op(self, 0, slot));
+            }
+            self->wait();
+            if (!slot->ok)
+            {
+                value = std::move(slot->value);
+            }
+            return slot->ok;
+        }
+
+        /**
+         * @brief 接收, 无数据时等待
+         * @param[out] value 接收到的值
+         * @return 是否接收成功, 通道关闭且无数据时返回false
+         */
+        bool recv(T &value)
+        {
+            ChannelWaiter::ptr wake;
+            ChannelWaiter::ptr self;
+            SlotPtr slot;
+            {
+                MutexType::Lock lock(m_mutex);
+                int rt = tryRecvLocked(value, wake);
+                if (rt != 0)
+                {
+                    lock.unlock();
+                    if (wake)
+                    {
+                        wake->wake();
+                    }
+                    return rt == 1;
+                }
+                self.reset(new ChannelWaiter);
+                slot = std::make_shared<Slot>();
+                m_receivers.push_back(Op(self, 0, slot));
+            }
+            self->wait();
+            if (slot->ok)
+            {
+                value = std::move(slot->value);
+            }
+            return slot->ok;
+        }
+
+        /**
+         * @brief 不等待地发送
+         * @return 是否发送成功, 失败时不移动value
+         */
+        bool trySend(T &&value)
+        {
+            ChannelWaiter::ptr wake;
+            int rt;
+            {
+                MutexType::Lock lock(m_mutex);
+                rt = trySendLocked(value, wake);
+            }
+            if (wake)
+            {
+                wake->wake();
+            }
+            return rt == 1;
+        }
+
+        /**
+         * @brief 不等待地发送
+         */
+        bool trySend(const T &value)
+        {
+            T tmp(value);
+            return trySend(std::move(tmp));
+        }
+
+        /**
+         * @brief 不等待地接收
+         * @return 是否接收到数据
+         */
+        bool tryRecv(T &value)
+        {
+            ChannelWaiter::ptr wake;
+            int rt;
+            {
+                MutexType::Lock lock(m_mutex);
+                rt = tryRecvLocked(value, wake);
+            }
+            if (wake)
+            {
+                wake->wake();
+            }
+            return rt == 1;
+        }
+
+        /**
+         * @brief 关闭通道, 唤醒所有等待者
+         * @details 等待的发送者返回false; 等待的接收者返回false(等待说明缓冲区已空)
+         */
+        void close()
+        {
+            std::list<Op> ops;
+            {
+                MutexType::Lock lock(m_mutex);
+                if (m_closed)
+                {
+                    return;
+                }
+                m_closed = true;
+                ops.swap(m_senders);
+                ops.splice(ops.end(), m_receivers);
+            }
+            for (auto &i : ops)
+            {
+                if (i.waiter->claim(i.index))
+                {
+                    i.slot->ok = false;
+                    i.waiter->wake();
+                }
+            }
+        }
+
+        /**
+         * @brief 返回缓冲区容量
+         */
+        size_t capacity() const { return m_capacity; }
+
+        /**
+         * @brief 返回缓冲区中的数据数量
+         */
+        size_t size()
+        {
+            MutexType::Lock lock(m_mutex);
+            return m_size;
+        }
+
+    private:
+        template <class U>
+        friend class ChannelRecvCase;
+        template <class U>
+        friend class ChannelSendCase;
+
+        /**
+         * @brief 等待中的操作交换的数据, 由等待者和通道共同持有
+         */
+        struct Slot
+        {
+            /// 发送者的值或接收到的值
+            T value;
+            /// 操作结果
+            bool ok = false;
+        };
+        typedef std::shared_ptr<Slot> SlotPtr;
+
+        /**
+         * @brief 等待中的操作
+         */
+        struct Op
+        {
+            Op(const ChannelWaiter::ptr &w, int i, const SlotPtr &s)
+                : waiter(w), index(i), slot(s) {}
+            /// 等待者
+            ChannelWaiter::ptr waiter;
+            /// 等待者的分支下标
+            int index;
+            /// 交换的数据
+            SlotPtr slot;
+        };
+
+        /**
+         * @brief 从队列中取出一个可抢占的等待者, 已被其他分支抢占的等待者直接丢弃
+         */
+        static bool PopClaimed(std::list<Op> &ops, Op *&op)
+        {
+            while (!ops.empty())
+            {
+                if (ops.front().waiter->claim(ops.front().index))
+                {
+                    op = &ops.front();
+                    return true;
+                }
+                ops.pop_front();
+            }
+            return false;
+        }
+
+        /**
+         * @brief 持锁尝试发送: 交给等待的接收者或放入缓冲区
+         * @param[out] wake 需要唤醒的接收者
+         * @return 1成功, -1已关闭, 0需要等待; 只有成功时移动value
+         */
+        int trySendLocked(T &value, ChannelWaiter::ptr &wake)
+        {
+            if (m_closed)
+            {
+                return -1;
+            }
+            Op *op = nullptr;
+            if (PopClaimed(m_receivers, op))
+            {
+                op->slot->value = std::move(value);
+                op->slot->ok = true;
+                wake = std::move(op->waiter);
+                m_receivers.pop_front();
+                return 1;
+            }
+            if (m_size < m_capacity)
+            {
+                m_buffer[(m_head + m_size) % m_capacity] = std::move(value);
+                ++m_size;
+                return 1;
+            }
+            return 0;
+        }
+
+        /**
+         * @brief 持锁尝试接收: 从缓冲区或等待的发送者取数据
+         * @param[out] wake 需要唤醒的发送者
+         * @return 1成功, -1已关闭且无数据, 0需要等待
+         */
+        int tryRecvLocked(T &value, ChannelWaiter::ptr &wake)
+        {
+            Op *op = nullptr;
+            if (m_size > 0)
+            {
+                value = std::move(m_buffer[m_head]);
+                m_head = (m_head + 1) % m_capacity;
+                --m_size;
+                //! 缓冲区腾出位置, 放入一个等待的发送者的数据
+                if (PopClaimed(m_senders, op))
+                {
+                    m_buffer[(m_head + m_size) % m_capacity] = std::move(op->slot->value);
+                    ++m_size;
+                    op->slot->ok = true;
+                    wake = std::move(op->waiter);
+                    m_senders.pop_front();
+                }
+                return 1;
+            }
+            if (PopClaimed(m_senders, op))
+            {
+                value = std::move(op->slot->value);
+                op->slot->ok = true;
+                wake = std::move(op->waiter);
+                m_senders.pop_front();
+                return 1;
+            }
+            return m_closed ? -1 : 0;
+        }
+
+        /**
+         * @brief 移除等待者登记的所有操作
+         */
+        void dequeue(const ChannelWaiter::ptr &waiter)
+        {
+            MutexType::Lock lock(m_mutex);
+            m_senders.remove_if([&waiter](const Op &op)
+                                { return op.waiter == waiter; });
+            m_receivers.remove_if([&waiter](const Op &op)
+                                  { return op.waiter == waiter; });
+        }
+
+    private:
+        /// 缓冲区容量
+        size_t m_capacity;
+        /// 环形缓冲区
+        std::vector<T> m_buffer;
+        /// 缓冲区头部下标
+        size_t m_head = 0;
+        /// 缓冲区中的数据数量
+        size_t m_size = 0;
+        /// 等待的发送者
+        std::list<Op> m_senders;
+        /// 等待的接收者
+        std::list<Op> m_receivers;
+    };
+
+    /**
+     * @brief 接收分支
+     */
+    template <class T>
+    class ChannelRecvCase : public ChannelSelect::Case
+    {
+    public:
+        ChannelRecvCase(Channel<T> &ch, T &value)
+            : m_channel(ch), m_value(value), m_slot(std::make_shared<typename Channel<T>::Slot>()) {}
+
+        ChannelBase *channel() override { return &m_channel; }
+
+        int tryLocked(ChannelWaiter::ptr &wake) override
+        {
+            int rt = m_channel.tryRecvLocked(m_slot->value, wake);
+            m_slot->ok = rt == 1;
+            return rt;
+        }
+
+        void enqueueLocked(const ChannelWaiter::ptr &waiter, int index) override
+        {
+            m_channel.m_receivers.push_back(typename Channel<T>::Op(waiter, index, m_slot));
+        }
+
+        void dequeue(const ChannelWaiter::ptr &waiter) override
+        {
+            m_channel.dequeue(waiter);
+        }
+
+        void finish() override
+        {
+            ok = m_slot->ok;
+            if (ok)
+            {
+                m_value = std::move(m_slot->value);
+            }
+        }
+
+    private:
+        /// 通道
+        Channel<T> &m_channel;
+        /// 调用者的存放位置, 只在finish()中写入
+        T &m_value;
+        /// 接收到的值
+        typename Channel<T>::SlotPtr m_slot;
+    };
+
+    /**
+     * @brief 发送分支
+     */
+    template <class T>
+    class ChannelSendCase : public ChannelSelect::Case
+    {
+    public:
+        ChannelSendCase(Channel<T> &ch, const T &value)
+            : m_channel(ch), m_slot(std::make_shared<typename Channel<T>::Slot>())
+        {
+            m_slot->value = value;
+        }
+
+        ChannelBase *channel() override { return &m_channel; }
+
+        int tryLocked(ChannelWaiter::ptr &wake) override
+        {
+            int rt = m_channel.trySendLocked(m_slot->value, wake);
+            m_slot->ok = rt == 1;
+            return rt;
+        }
+
+        void enqueueLocked(const ChannelWaiter::ptr &waiter, int index) override
+        {
+            m_channel.m_senders.push_back(typename Channel<T>::Op(waiter, index, m_slot));
+        }
+
+        void dequeue(const ChannelWaiter::ptr &waiter) override
+        {
+            m_channel.dequeue(waiter);
+        }
+
+        void finish() override
+        {
+            ok = m_slot->ok;
+        }
+
+    private:
+        /// 通道
+        Channel<T> &m_channel;
+        /// 发送的值
+        typename Channel<T>::SlotPtr m_slot;
+    };
+
+    template <class T>
+    int ChannelSelect::recv(Channel<T> &ch, T &value, bool *ok)
+    {
+        Case *c = new ChannelRecvCase<T>(ch, value);
+        c->result = ok;
+        return addCase(c);
+    }
+
+    template <class T>
+    int ChannelSelect::send(Channel<T> &ch, const T &value, bool *ok)
+    {
+        Case *c = new ChannelSendCase<T>(ch, value);
+        c->result = ok;
+        return addCase(c);
+    }
+
+}
+
+#endif
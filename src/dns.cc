@@ -0,0 +1,689 @@
+#include "dns.h"
+#include "config.h"
+#include "log.h"
+#include "socket.h"
+#include "util.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace HPS
+{
+
+    static Logger::ptr g_logger = LOG_NAME("system");
+
+    static ConfigVar<bool>::ptr g_dns_enable =
+        Config::Lookup("dns.enable", true, "resolve names in hooked fibers with the async dns resolver");
+
+    static ConfigVar<std::vector<std::string>>::ptr g_dns_servers =
+        Config::Lookup("dns.servers", std::vector<std::string>(), "dns servers ip[:port], empty to use /etc/resolv.conf");
+
+    static ConfigVar<uint32_t>::ptr g_dns_timeout =
+        Config::Lookup<uint32_t>("dns.timeout", 2000, "dns query timeout per server in ms");
+
+    static ConfigVar<uint32_t>::ptr g_dns_attempts =
+        Config::Lookup<uint32_t>("dns.attempts", 2, "dns query rounds over all servers");
+
+    static ConfigVar<std::string>::ptr g_dns_resolv_conf =
+        Config::Lookup<std::string>("dns.resolv_conf", "/etc/resolv.conf", "resolver config providing nameserver, search and ndots");
+
+    static ConfigVar<std::string>::ptr g_dns_hosts_file =
+        Config::Lookup<std::string>("dns.hosts_file", "/etc/hosts", "hosts file consulted before dns");
+
+    static ConfigVar<uint32_t>::ptr g_dns_negative_ttl =
+        Config::Lookup<uint32_t>("dns.negative_ttl", 30, "seconds to cache nxdomain and empty answers");
+
+    static ConfigVar<uint32_t>::ptr g_dns_max_ttl =
+        Config::Lookup<uint32_t>("dns.max_ttl", 3600, "upper bound in seconds of cached answer ttl");
+
+    static ConfigVar<uint32_t>::ptr g_dns_cache_size =
+        Config::Lookup<uint32_t>("dns.cache_size", 16 * 1024, "max cached dns answers");
+
+    static const uint16_t DNS_TYPE_A = 1;
+    static const uint16_t DNS_TYPE_AAAA = 28;
+    static const uint16_t DNS_CLASS_IN = 1;
+    static const uint8_t DNS_RCODE_NXDOMAIN = 3;
+    //! 报文头第三字节中的TC(截断)位
+    static const uint8_t DNS_FLAG_TC = 0x02;
+    //! ndots的上限, 与glibc一致
+    static const size_t DNS_MAX_NDOTS = 15;
+
+    //! 两次检查hosts文件修改时间的最小间隔(毫秒)
+    static const uint64_t HOSTS_CHECK_INTERVAL = 1000;
+
+    static uint16_t ReadU16(const uint8_t *p)
+    {
+        return (p[0] << 8) | p[1];
+    }
+
+    static uint32_t ReadU32(const uint8_t *p)
+    {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    static void WriteU16(std::string &buf, uint16_t v)
+    {
+        buf.push_back(v >> 8);
+        buf.push_back(v & 0xff);
+    }
+
+    //! 查询id取自内核的随机数, 不可预测, 防止伪造应答
+    static uint16_t RandomId()
+    {
+        uint16_t id = 0;
+        if (getrandom(&id, sizeof(id), GRND_NONBLOCK) == sizeof(id))
+        {
+            return id;
+        }
+        //! 内核不支持getrandom时读取/dev/urandom
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0)
+        {
+            ssize_t n = read(fd, &id, sizeof(id));
+            close(fd);
+            if (n == sizeof(id))
+            {
+                return id;
+            }
+        }
+        LOG_ERROR(g_logger) << "dns random query id unavailable errno=" << errno
+                            << " errstr=" << strerror(errno);
+        return (uint16_t)GetCurrentUS() ^ (uint16_t)(GetCurrentUS() >> 16);
+    }
+
+    //! 跳过报文中的域名(标签序列或压缩指针)
+    static bool SkipName(const uint8_t *buf, size_t len, size_t &off)
+    {
+        while (off < len)
+        {
+            uint8_t n = buf[off];
+            if (n == 0)
+            {
+                ++off;
+                return true;
+            }
+            if ((n & 0xc0) == 0xc0)
+            {
+                off += 2;
+                return off <= len;
+            }
+            off += n + 1;
+        }
+        return false;
+    }
+
+    //! 构造查询报文, 域名不合法时返回false
+    static bool EncodeQuery(std::string &buf, uint16_t id, const std::string &name, uint16_t qtype)
+    {
+        buf.clear();
+        WriteU16(buf, id);
+        //! 期望递归查询
+        WriteU16(buf, 0x0100);
+        WriteU16(buf, 1);
+        WriteU16(buf, 0);
+        WriteU16(buf, 0);
+        WriteU16(buf, 0);
+        size_t begin = 0;
+        while (begin < name.size())
+        {
+            size_t end = name.find('.', begin);
+            if (end == std::string::npos)
+            {
+                end = name.size();
+            }
+            size_t n = end - begin;
+            if (n == 0 || n > 63)
+            {
+                return false;
+            }
+            buf.push_back(n);
+            buf.append(name, begin, n);
+            begin = end + 1;
+        }
+        buf.push_back(0);
+        WriteU16(buf, qtype);
+        WriteU16(buf, DNS_CLASS_IN);
+        return buf.size() <= 512;
+    }
+
+    //! 解析dns.servers中的ip[:port], [ipv6]:port
+    static Address::ptr ParseServer(const std::string &str)
+    {
+        std::string host = str;
+        uint16_t port = 53;
+        if (!str.empty() && str[0] == '[')
+        {
+            size_t end = str.find(']');
+            if (end == std::string::npos)
+            {
+                return nullptr;
+            }
+            host = str.substr(1, end - 1);
+            if (end + 1 < str.size() && str[end + 1] == ':')
+            {
+                port = atoi(str.c_str() + end + 2);
+            }
+        }
+        else if (std::count(str.begin(), str.end(), ':') == 1)
+        {
+            size_t pos = str.find(':');
+            host = str.substr(0, pos);
+            port = atoi(str.c_str() + pos + 1);
+        }
+        return IPAddress::Create(host.c_str(), port);
+    }
+
+    //! 返回地址的副本, 调用方会修改端口
+    static IPAddress::ptr CloneAddress(const IPAddress::ptr &addr)
+    {
+        return std::dynamic_pointer_cast<IPAddress>(Address::Create(addr->getAddr(), addr->getAddrLen()));
+    }
+
+    //! 读取hosts文件: 域名 -> 地址
+    static void LoadHosts(const std::string &path, std::unordered_multimap<std::string, IPAddress::ptr> &hosts)
+    {
+        std::ifstream ifs(path);
+        std::string line;
+        while (std::getline(ifs, line))
+        {
+            size_t pos = line.find('#');
+            if (pos != std::string::npos)
+            {
+                line.resize(pos);
+            }
+            std::istringstream iss(line);
+            std::string ip;
+            std::string host;
+            if (!(iss >> ip))
+            {
+                continue;
+            }
+            IPAddress::ptr addr = IPAddress::Create(ip.c_str());
+            if (!addr)
+            {
+                continue;
+            }
+            while (iss >> host)
+            {
+                std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+                hosts.insert(std::make_pair(host, addr));
+            }
+        }
+    }
+
+    DnsResolver::DnsResolver()
+    {
+    }
+
+    bool DnsResolver::IsEnabled()
+    {
+        return g_dns_enable->getValue();
+    }
+
+    bool DnsResolver::resolve(std::vector<IPAddress::ptr> &result, const std::string &name, int family)
+    {
+        std::string host = name;
+        std::transform(host.begin(), host.end(), host.begin(), ::tolower);
+        //! 以点结尾的是完整域名, 不补全后缀
+        bool absolute = !host.empty() && host.back() == '.';
+        if (absolute)
+        {
+            host.pop_back();
+        }
+        if (host.empty() || host.size() > 253)
+        {
+            return false;
+        }
+        if (lookupHosts(result, host, family))
+        {
+            ++m_hostsHits;
+            return true;
+        }
+        ResolvConf conf = getConfig();
+        //! 与glibc一致: 点的数量不少于ndots时先查原域名, 否则先依次补全search中的后缀
+        std::vector<std::string> names;
+        bool first = absolute || (size_t)std::count(host.begin(), host.end(), '.') >= conf.ndots;
+        if (first)
+        {
+            names.push_back(host);
+        }
+        if (!absolute)
+        {
+            for (auto &i : conf.search)
+            {
+                if (host.size() + 1 + i.size() <= 253)
+                {
+                    names.push_back(host + "." + i);
+                }
+            }
+        }
+        if (!first)
+        {
+            names.push_back(host);
+        }
+        for (auto &i : names)
+        {
+            bool failed = false;
+            if (resolveName(result, i, family, conf.servers, failed))
+            {
+                return true;
+            }
+            //! 只有域名不存在或没有记录时才尝试下一个, 超时或截断时交给调用方回退
+            if (failed)
+            {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool DnsResolver::resolveName(std::vector<IPAddress::ptr> &result, const std::string &name, int family,
+                                  const std::vector<Address::ptr> &servers, bool &failed)
+    {
+        bool found = false;
+        if (family == AF_INET || family == AF_UNSPEC)
+        {
+            Answer answer = lookup(name, DNS_TYPE_A, servers);
+            failed = failed || (answer.addrs.empty() && !answer.expire);
+            for (auto &i : answer.addrs)
+            {
+                result.push_back(CloneAddress(i));
+                found = true;
+            }
+        }
+        if (family == AF_INET6 || family == AF_UNSPEC)
+        {
+            Answer answer = lookup(name, DNS_TYPE_AAAA, servers);
+            failed = failed || (answer.addrs.empty() && !answer.expire);
+            for (auto &i : answer.addrs)
+            {
+                result.push_back(CloneAddress(i));
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    DnsResolver::Answer DnsResolver::lookup(const std::string &name, uint16_t qtype, const std::vector<Address::ptr> &servers)
+    {
+        std::string key = name + "#" + std::to_string(qtype);
+        Shard &shard = m_shards[std::hash<std::string>()(key) % SHARD_COUNT];
+        Promise<Answer> promise;
+        Future<Answer> future;
+        {
+            MutexType::Lock lock(shard.mutex);
+            auto it = shard.cache.find(key);
+            if (it != shard.cache.end())
+            {
+                if (it->second.expire > GetCurrentMS())
+                {
+                    ++m_hits;
+                    if (it->second.addrs.empty())
+                    {
+                        ++m_negativeHits;
+                    }
+                    return it->second;
+                }
+                shard.cache.erase(it);
+            }
+            //! 已有同一域名的查询在进行, 等待其结果
+            auto fit = shard.inflight.find(key);
+            if (fit != shard.inflight.end())
+            {
+                future = fit->second;
+            }
+            else
+            {
+                shard.inflight[key] = promise.getFuture();
+            }
+        }
+        if (future.valid())
+        {
+            ++m_joined;
+            return future.get();
+        }
+
+        ++m_misses;
+        Answer answer;
+        try
+        {
+            answer = query(name, qtype, servers);
+        }
+        catch (...)
+        {
+            //! 移除并完成进行中的查询, 否则等待同一域名的协程永远挂起, 之后的查询也都会加入它
+            {
+                MutexType::Lock lock(shard.mutex);
+                shard.inflight.erase(key);
+            }
+            ++m_failures;
+            promise.setException(std::current_exception());
+            throw;
+        }
+        {
+            MutexType::Lock lock(shard.mutex);
+            shard.inflight.erase(key);
+            if (answer.expire)
+            {
+                size_t limit = std::max<size_t>(g_dns_cache_size->getValue() / SHARD_COUNT, 1);
+                if (shard.cache.size() >= limit)
+                {
+                    uint64_t now = GetCurrentMS();
+                    for (auto it = shard.cache.begin(); it != shard.cache.end();)
+                    {
+                        if (it->second.expire <= now)
+                        {
+                            it = shard.cache.erase(it);
+                        }
+                        else
+                        {
+                            ++it;
+                        }
+                    }
+                    if (shard.cache.size() >= limit)
+                    {
+                        shard.cache.erase(shard.cache.begin());
+                    }
+                }
+                shard.cache[key] = answer;
+            }
+        }
+        promise.setValue(answer);
+        return answer;
+    }
+
+    DnsResolver::Answer DnsResolver::query(const std::string &name, uint16_t qtype, const std::vector<Address::ptr> &servers)
+    {
+        Answer answer;
+        uint16_t id = 0;
+        std::string request;
+        if (servers.empty() || !EncodeQuery(request, id, name, qtype))
+        {
+            ++m_failures;
+            return answer;
+        }
+        uint32_t timeout = g_dns_timeout->getValue();
+        uint32_t attempts = std::max<uint32_t>(g_dns_attempts->getValue(), 1);
+        uint8_t buf[1500];
+        for (uint32_t attempt = 0; attempt < attempts; ++attempt)
+        {
+            for (auto &server : servers)
+            {
+                Socket::ptr sock = Socket::CreateUDP(server);
+                if (!sock)
+                {
+                    LOG_ERROR(g_logger) << "dns query " << name << " create udp socket fail errno=" << errno
+                                        << " errstr=" << strerror(errno);
+                    continue;
+                }
+                sock->setRecvTimeout(timeout);
+                ++m_queries;
+                //! 每次发送使用新的随机id
+                id = RandomId();
+                request[0] = id >> 8;
+                request[1] = id & 0xff;
+                if (sock->sendTo(request.data(), request.size(), server) != (int)request.size())
+                {
+                    continue;
+                }
+                while (true)
+                {
+                    Address::ptr from = server->getFamily() == AF_INET6 ? Address::ptr(new IPv6Address) : Address::ptr(new IPv4Address);
+                    int n = sock->recvFrom(buf, sizeof(buf), from);
+                    if (n <= 0)
+                    {
+                        LOG_DEBUG(g_logger) << "dns query " << name << " type=" << qtype
+                                            << " server=" << *server << " timeout";
+                        break;
+                    }
+                    //! 忽略来源地址和端口不是所查询服务器, id不符或问题与请求不同的报文
+                    if (*from != *server || n < (int)request.size() || ReadU16(buf) != id || !(buf[2] & 0x80) ||
+                        ReadU16(buf + 4) != 1 || memcmp(buf + 12, request.data() + 12, request.size() - 12) != 0)
+                    {
+                        LOG_DEBUG(g_logger) << "dns query " << name << " server=" << *server
+                                            << " ignore response from " << *from;
+                        continue;
+                    }
+                    //! 截断的应答记录不完整, 不缓存, 由调用方回退到getaddrinfo(会改用TCP)
+                    if (buf[2] & DNS_FLAG_TC)
+                    {
+                        LOG_DEBUG(g_logger) << "dns query " << name << " server=" << *server << " truncated";
+                        ++m_truncated;
+                        return answer;
+                    }
+                    uint8_t rcode = buf[3] & 0x0f;
+                    if (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN)
+                    {
+                        LOG_DEBUG(g_logger) << "dns query " << name << " server=" << *server
+                                            << " rcode=" << (int)rcode;
+                        break;
+                    }
+                    size_t off = 12;
+                    uint16_t qdcount = ReadU16(buf + 4);
+                    uint16_t ancount = ReadU16(buf + 6);
+                    bool ok = true;
+                    for (uint16_t i = 0; i < qdcount && ok; ++i)
+                    {
+                        ok = SkipName(buf, n, off) && (off += 4) <= (size_t)n;
+                    }
+                    uint32_t ttl = g_dns_max_ttl->getValue();
+                    for (uint16_t i = 0; i < ancount && ok; ++i)
+                    {
+                        if (!SkipName(buf, n, off) || off + 10 > (size_t)n)
+                        {
+                            ok = false;
+                            break;
+                        }
+                        uint16_t type = ReadU16(buf + off);
+                        uint16_t cls = ReadU16(buf + off + 2);
+                        uint32_t rttl = ReadU32(buf + off + 4);
+                        uint16_t rdlen = ReadU16(buf + off + 8);
+                        off += 10;
+                        if (off + rdlen > (size_t)n)
+                        {
+                            ok = false;
+                            break;
+                        }
+                        //! CNAME等其他记录只跳过, 递归服务器会一并返回最终的地址记录
+                        if (cls == DNS_CLASS_IN && type == qtype && type == DNS_TYPE_A && rdlen == 4)
+                        {
+                            sockaddr_in addr;
+                            memset(&addr, 0, sizeof(addr));
+                            addr.sin_family = AF_INET;
+                            memcpy(&addr.sin_addr, buf + off, 4);
+                            answer.addrs.push_back(IPAddress::ptr(new IPv4Address(addr)));
+                            ttl = std::min(ttl, rttl);
+                        }
+                        else if (cls == DNS_CLASS_IN && type == qtype && type == DNS_TYPE_AAAA && rdlen == 16)
+                        {
+                            answer.addrs.push_back(IPAddress::ptr(new IPv6Address(buf + off)));
+                            ttl = std::min(ttl, rttl);
+                        }
+                        off += rdlen;
+                    }
+                    if (!ok)
+                    {
+                        answer.addrs.clear();
+                        break;
+                    }
+                    //! 域名不存在或没有该类型的记录时做否定缓存
+                    if (answer.addrs.empty())
+                    {
+                        ttl = g_dns_negative_ttl->getValue();
+                    }
+                    answer.expire = GetCurrentMS() + ttl * 1000ull;
+                    return answer;
+                }
+            }
+        }
+        ++m_failures;
+        return answer;
+    }
+
+    bool DnsResolver::lookupHosts(std::vector<IPAddress::ptr> &result, const std::string &name, int family)
+    {
+        bool check = false;
+        int64_t loaded = -1;
+        {
+            MutexType::Lock lock(m_mutex);
+            uint64_t now = GetCurrentMS();
+            if (now - m_hostsChecked >= HOSTS_CHECK_INTERVAL)
+            {
+                m_hostsChecked = now;
+                loaded = m_hostsMtime;
+                check = true;
+            }
+        }
+        //! 在锁外读取和解析文件, 每个检查间隔只有一个调用者重新加载, 其他调用者继续使用旧内容
+        if (check)
+        {
+            std::string path = g_dns_hosts_file->getValue();
+            struct stat st;
+            int64_t mtime = stat(path.c_str(), &st) == 0 ? (int64_t)st.st_mtime : -1;
+            if (mtime != loaded)
+            {
+                std::unordered_multimap<std::string, IPAddress::ptr> hosts;
+                LoadHosts(path, hosts);
+                MutexType::Lock lock(m_mutex);
+                m_hostsMtime = mtime;
+                m_hosts.swap(hosts);
+            }
+        }
+        bool found = false;
+        MutexType::Lock lock(m_mutex);
+        auto range = m_hosts.equal_range(name);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (family == AF_UNSPEC || family == it->second->getFamily())
+            {
+                result.push_back(CloneAddress(it->second));
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void DnsResolver::LoadResolvConf(const std::string &path, ResolvConf &conf)
+    {
+        std::ifstream ifs(path);
+        std::string line;
+        while (std::getline(ifs, line))
+        {
+            std::istringstream iss(line);
+            std::string key;
+            std::string value;
+            if (!(iss >> key >> value))
+            {
+                continue;
+            }
+            if (key == "nameserver")
+            {
+                Address::ptr addr = ParseServer(value.find(':') == std::string::npos ? value : "[" + value + "]");
+                if (addr)
+                {
+                    conf.servers.push_back(addr);
+                }
+            }
+            //! search与domain互相覆盖, 以最后出现的为准
+            else if (key == "search" || key == "domain")
+            {
+                conf.search.clear();
+                do
+                {
+                    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+                    if (!value.empty() && value.back() == '.')
+                    {
+                        value.pop_back();
+                    }
+                    if (!value.empty())
+                    {
+                        conf.search.push_back(value);
+                    }
+                } while (key == "search" && iss >> value);
+            }
+            else if (key == "options")
+            {
+                do
+                {
+                    if (value.compare(0, 6, "ndots:") == 0)
+                    {
+                        conf.ndots = std::min<size_t>(atoi(value.c_str() + 6), DNS_MAX_NDOTS);
+                    }
+                } while (iss >> value);
+            }
+        }
+    }
+
+    DnsResolver::ResolvConf DnsResolver::getConfig()
+    {
+        ResolvConf conf;
+        bool loaded = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_systemLoaded)
+            {
+                conf = m_system;
+                loaded = true;
+            }
+        }
+        //! 在锁外读取resolv.conf, 并发的首次调用各自读取, 只有第一个结果被保存
+        if (!loaded)
+        {
+            LoadResolvConf(g_dns_resolv_conf->getValue(), conf);
+            MutexType::Lock lock(m_mutex);
+            if (!m_systemLoaded)
+            {
+                m_systemLoaded = true;
+                m_system = conf;
+            }
+        }
+        std::vector<Address::ptr> servers;
+        for (auto &i : g_dns_servers->getValue())
+        {
+            Address::ptr addr = ParseServer(i);
+            if (addr)
+            {
+                servers.push_back(addr);
+            }
+            else
+            {
+                LOG_ERROR(g_logger) << "invalid dns server " << i;
+            }
+        }
+        if (!servers.empty())
+        {
+            conf.servers.swap(servers);
+        }
+        return conf;
+    }
+
+    void DnsResolver::clear()
+    {
+        for (auto &i : m_shards)
+        {
+            MutexType::Lock lock(i.mutex);
+            i.cache.clear();
+        }
+    }
+
+    DnsResolver::Stats DnsResolver::getStats() const
+    {
+        Stats stats;
+        stats.hits = m_hits;
+        stats.negative_hits = m_negativeHits;
+        stats.misses = m_misses;
+        stats.joined = m_joined;
+        stats.queries = m_queries;
+        stats.failures = m_failures;
+        stats.hosts_hits = m_hostsHits;
+        stats.truncated = m_truncated;
+        return stats;
+    }
+
+}
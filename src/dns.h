@@ -0,0 +1,180 @@
+#ifndef __DNS_H__
+#define __DNS_H__
+
+#include "address.h"
+#include "future.h"
+#include "singleton.h"
+
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace HPS
+{
+
+    /**
+     * @brief 协程友好的DNS解析器
+     * @details 先查hosts文件, 再通过hook的UDP socket向dns.servers(为空时取dns.resolv_conf)查询,
+     *          等待应答时只挂起当前协程. 按resolv.conf的search和ndots依次尝试补全后的域名.
+     *          结果按应答的TTL缓存在分片的缓存中, 域名不存在或没有记录时做否定缓存;
+     *          同一域名的并发查询只发出一次, 其余查询等待其结果.
+     *          解析失败(域名不存在, 超时, 应答截断)时Address::Lookup回退到getaddrinfo
+     */
+    class DnsResolver : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<DnsResolver> ptr;
+        typedef Mutex MutexType;
+
+        /**
+         * @brief 运行统计
+         */
+        struct Stats
+        {
+            /// 缓存命中(含否定缓存)
+            uint64_t hits = 0;
+            /// 否定缓存命中
+            uint64_t negative_hits = 0;
+            /// 缓存未命中
+            uint64_t misses = 0;
+            /// 等待同一域名进行中查询的次数
+            uint64_t joined = 0;
+            /// 发出的DNS查询报文数
+            uint64_t queries = 0;
+            /// 查询超时或服务器出错的次数
+            uint64_t failures = 0;
+            /// hosts文件命中
+            uint64_t hosts_hits = 0;
+            /// 应答被截断的次数
+            uint64_t truncated = 0;
+        };
+
+        DnsResolver();
+
+        /**
+         * @brief Address::Lookup是否使用解析器(配置dns.enable)
+         */
+        static bool IsEnabled();
+
+        /**
+         * @brief 解析域名
+         * @param[out] result 解析出的地址, 端口为0
+         * @param[in] name 域名
+         * @param[in] family AF_INET, AF_INET6 或 AF_UNSPEC
+         * @return 是否解析出地址
+         */
+        bool resolve(std::vector<IPAddress::ptr> &result, const std::string &name, int family = AF_INET);
+
+        /**
+         * @brief 清空缓存
+         */
+        void clear();
+
+        /**
+         * @brief 返回运行统计
+         */
+        Stats getStats() const;
+
+    private:
+        /**
+         * @brief 一种记录类型的解析结果
+         */
+        struct Answer
+        {
+            /// 地址
+            std::vector<IPAddress::ptr> addrs;
+            /// 过期时间(毫秒), 为0时不缓存
+            uint64_t expire = 0;
+        };
+
+        /**
+         * @brief resolv.conf中的配置
+         */
+        struct ResolvConf
+        {
+            /// 服务器
+            std::vector<Address::ptr> servers;
+            /// 补全域名的后缀
+            std::vector<std::string> search;
+            /// 域名中的点少于ndots时先尝试补全后缀
+            size_t ndots = 1;
+        };
+
+        /**
+         * @brief 缓存分片, 同时记录进行中的查询
+         */
+        struct Shard
+        {
+            MutexType mutex;
+            std::unordered_map<std::string, Answer> cache;
+            std::unordered_map<std::string, Future<Answer>> inflight;
+        };
+
+        /**
+         * @brief 解析一个完整的域名
+         * @param[out] failed 是否有记录类型查询失败(超时, 服务器出错, 应答截断)
+         */
+        bool resolveName(std::vector<IPAddress::ptr> &result, const std::string &name, int family,
+                         const std::vector<Address::ptr> &servers, bool &failed);
+
+        /**
+         * @brief 解析一种记录类型, 经过缓存和去重
+         * @return 查询失败时地址为空且不缓存(expire为0)
+         */
+        Answer lookup(const std::string &name, uint16_t qtype, const std::vector<Address::ptr> &servers);
+
+        /**
+         * @brief 依次向各DNS服务器查询
+         */
+        Answer query(const std::string &name, uint16_t qtype, const std::vector<Address::ptr> &servers);
+
+        /**
+         * @brief 查hosts文件, 文件修改后重新加载
+         */
+        bool lookupHosts(std::vector<IPAddress::ptr> &result, const std::string &name, int family);
+
+        /**
+         * @brief 读取resolv.conf中的nameserver, search(domain)和options ndots
+         */
+        static void LoadResolvConf(const std::string &path, ResolvConf &conf);
+
+        /**
+         * @brief 返回解析配置, dns.servers不为空时替换其中的服务器
+         */
+        ResolvConf getConfig();
+
+    private:
+        static const size_t SHARD_COUNT = 16;
+        /// 缓存分片
+        Shard m_shards[SHARD_COUNT];
+
+        /// 保护hosts和resolv.conf的内容
+        MutexType m_mutex;
+        /// hosts文件的内容: 域名 -> 地址
+        std::unordered_multimap<std::string, IPAddress::ptr> m_hosts;
+        /// 已加载的hosts文件的修改时间
+        int64_t m_hostsMtime = -1;
+        /// 上次检查hosts文件的时间(毫秒)
+        uint64_t m_hostsChecked = 0;
+        /// resolv.conf中的配置
+        ResolvConf m_system;
+        /// 是否已读取resolv.conf
+        bool m_systemLoaded = false;
+
+        /// 统计计数
+        std::atomic<uint64_t> m_hits = {0};
+        std::atomic<uint64_t> m_negativeHits = {0};
+        std::atomic<uint64_t> m_misses = {0};
+        std::atomic<uint64_t> m_joined = {0};
+        std::atomic<uint64_t> m_queries = {0};
+        std::atomic<uint64_t> m_failures = {0};
+        std::atomic<uint64_t> m_hostsHits = {0};
+        std::atomic<uint64_t> m_truncated = {0};
+    };
+
+    /// 默认的DNS解析器, Address::Lookup在hook的协程中使用
+    typedef Singleton<DnsResolver> DnsMgr;
+
+}
+
+#endif
@@ -6,6 +6,7 @@
 // #include "thread.h"
 #include <map>
 #include <vector>
+#include <string>
 
 namespace HPS
 {
@@ -9,7 +9,7 @@ namespace HPS
 {
     
     FdCtx::FdCtx(int fd)
-        : m_isInit(false), m_isSocket(false), m_sysNonblock(false), m_userNonblock(false), m_isClosed(false), m_fd(fd), m_recvTimeout(-1), m_sendTimeout(-1)
+        : m_isInit(false), m_isSocket(false), m_isPollable(false), m_sysNonblock(false), m_userNonblock(false), m_isClosed(false), m_fd(fd), m_recvTimeout(-1), m_sendTimeout(-1)
     {
         init();
     }
@@ -32,14 +32,18 @@ namespace HPS
         {
             m_isInit = false;
             m_isSocket = false;
+            m_isPollable = false;
         }
         else
         {
             m_isInit = true;
             m_isSocket = S_ISSOCK(fd_stat.st_mode);
+            //! 管道, eventfd等只有经hook创建时才可等待, 见setPollable
+            m_isPollable = m_isSocket;
         }
 
-        if (m_isSocket)
+        //! 可等待的句柄设为非阻塞, 由hook模拟阻塞语义
+        if (m_isPollable)
         {
             int flags = fcntl_f(m_fd, F_GETFL, 0);
             if (!(flags & O_NONBLOCK))
@@ -58,6 +62,27 @@ namespace HPS
         return m_isInit;
     }
 
+    void FdCtx::setPollable()
+    {
+        struct stat fd_stat;
+        if (m_isPollable || -1 == fstat(m_fd, &fd_stat))
+        {
+            return;
+        }
+        //! eventfd, epoll, timerfd等匿名句柄没有文件类型位
+        if (!S_ISFIFO(fd_stat.st_mode) && (fd_stat.st_mode & S_IFMT) != 0)
+        {
+            return;
+        }
+        int flags = fcntl_f(m_fd, F_GETFL, 0);
+        if (!(flags & O_NONBLOCK))
+        {
+            fcntl_f(m_fd, F_SETFL, flags | O_NONBLOCK);
+        }
+        m_isPollable = true;
+        m_sysNonblock = true;
+    }
+
     void FdCtx::setTimeout(int type, uint64_t v)
     {
         if (type == SO_RCVTIMEO)
@@ -84,6 +109,11 @@ namespace HPS
         }
     }
 
+    IoTimeoutNode *FdCtx::getTimeoutNode(int type)
+    {
+        return type == SO_RCVTIMEO ? &m_recvTimer : &m_sendTimer;
+    }
+
     FdManager::FdManager()
     {
         m_datas.resize(64);
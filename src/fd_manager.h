@@ -3,16 +3,34 @@
 
 #include "thread.h"
 #include "singleton.h"
+#include "timer.h"
 
 #include <memory>
 #include <vector>
 
 namespace HPS
 {
+    class IOManager;
+
+    /**
+     * @brief 阻塞读写的超时定时器节点
+     * @details 嵌入在FdCtx中, 每次EAGAIN挂入和摘下都不做内存分配
+     */
+    struct IoTimeoutNode : public TimerNode
+    {
+        /// 等待事件所在的IO管理器
+        IOManager *iom = nullptr;
+        /// 文件句柄
+        int fd = -1;
+        /// 等待的事件
+        uint32_t event = 0;
+        /// 超时时设为ETIMEDOUT
+        int cancelled = 0;
+    };
 
     /**
      * @brief 文件句柄上下文类
-     * @details 管理文件句柄类型(是否socket)
+     * @details 管理文件句柄类型(是否socket, 是否可由epoll等待)
      *          是否阻塞,是否关闭,读/写超时时间
      */
     class FdCtx : public std::enable_shared_from_this<FdCtx>
@@ -38,6 +56,18 @@ namespace HPS
          */
         bool isSocket() const { return m_isSocket; }
 
+        /**
+         * @brief 是否可由epoll等待(socket, 以及hook创建的管道, eventfd)
+         */
+        bool isPollable() const { return m_isPollable; }
+
+        /**
+         * @brief 将hook创建的管道, eventfd设为可等待
+         * @details 设置O_NONBLOCK会修改共享的打开文件描述, 只用于hook自己创建的句柄;
+         *          继承或打开的FIFO等匿名句柄保持原样, 读写直接调用系统函数
+         */
+        void setPollable();
+
         /**
          * @brief 是否已关闭
          */
@@ -79,6 +109,12 @@ namespace HPS
          */
         uint64_t getTimeout(int type);
 
+        /**
+         * @brief 获取超时定时器节点
+         * @param[in] type 类型SO_RCVTIMEO(读超时), SO_SNDTIMEO(写超时)
+         */
+        IoTimeoutNode *getTimeoutNode(int type);
+
     private:
         /**
          * @brief 初始化
@@ -90,6 +126,8 @@ namespace HPS
         bool m_isInit : 1;
         /// 是否socket
         bool m_isSocket : 1;
+        /// 是否可由epoll等待(已设为非阻塞)
+        bool m_isPollable : 1;
         /// 是否hook非阻塞
         bool m_sysNonblock : 1;
         /// 是否用户主动设置非阻塞
@@ -102,6 +140,10 @@ namespace HPS
         uint64_t m_recvTimeout;
         /// 写超时时间毫秒
         uint64_t m_sendTimeout;
+        /// 读超时定时器节点
+        IoTimeoutNode m_recvTimer;
+        /// 写超时定时器节点
+        IoTimeoutNode m_sendTimer;
     };
 
     /**
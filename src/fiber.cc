@@ -3,8 +3,10 @@
 #include "macro.h"
 #include "log.h"
 #include "scheduler.h"
+#include "stack_allocator.h"
 
 #include <atomic>
+#include <string.h>
 
 //# 实用函数
 namespace HPS
@@ -21,21 +23,62 @@ namespace HPS
     static ConfigVar<uint32_t>::ptr g_fiber_stack_size =
         Config::Lookup<uint32_t>("fiber.stack_size", 128 * 1024, "fiber stack size");
 
-    class MallocStackAllocator
+    static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_size =
+        Config::Lookup<uint32_t>("fiber.shared_stack_size", 1024 * 1024, "fiber shared stack size");
+
+    static ConfigVar<uint32_t>::ptr g_fiber_shared_stack_count =
+        Config::Lookup<uint32_t>("fiber.shared_stack_count", 4, "fiber shared stacks per thread");
+
+    static std::atomic<uint64_t> s_shared_saved_bytes{0};
+
+    /**
+     * @brief 共享执行栈
+     */
+    struct SharedStack
+    {
+        /// 栈底
+        char *stack = nullptr;
+        /// 栈大小
+        size_t size = 0;
+        /// 当前栈上的协程
+        Fiber *occupant = nullptr;
+    };
+
+    /**
+     * @brief 线程本地的共享栈池
+     */
+    struct SharedStackPool
     {
-    public:
-        static void *Alloc(size_t size)
+        std::vector<SharedStack *> stacks;
+        size_t next = 0;
+
+        SharedStack *get()
         {
-            return malloc(size);
+            if (stacks.empty())
+            {
+                uint32_t count = std::max<uint32_t>(g_fiber_shared_stack_count->getValue(), 1);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    SharedStack *ss = new SharedStack;
+                    ss->size = g_fiber_shared_stack_size->getValue();
+                    ss->stack = (char *)StackAllocator::Alloc(ss->size);
+                    stacks.push_back(ss);
+                }
+            }
+            return stacks[next++ % stacks.size()];
         }
 
-        static void Dealloc(void *vp, size_t size)
+        ~SharedStackPool()
         {
-            return free(vp);
+            for (auto i : stacks)
+            {
+                StackAllocator::Dealloc(i->stack, i->size);
+                delete i;
+            }
         }
     };
 
-    using StackAllocator = MallocStackAllocator;
+    static thread_local SharedStackPool t_shared_stacks;
 
     uint64_t Fiber::GetFiberId()
     {
@@ -48,23 +91,146 @@ namespace HPS
 
     //重置协程函数，并重置状态
     // INIT，TERM, EXCEPT
-    void Fiber::reset(std::function<void()> cb, bool join_schedule)
+    void Fiber::reset(Callback cb, bool join_schedule)
     {
-        ASSERT(m_stack);
+        ASSERT(m_stack || m_useSharedStack);
         ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
-        m_cb = cb;
+        m_cb = std::move(cb);
+        m_joinSchedule = join_schedule;
+        if (m_useSharedStack)
+        {
+            //! 共享栈协程在首次切入时才在共享栈上初始化上下文
+            releaseSharedStack();
+            m_boundThread = -1;
+        }
+        else
+        {
+            initContext();
+        }
+        m_state = INIT;
+    }
+
+    uint64_t Fiber::SharedStackSavedBytes()
+    {
+        return s_shared_saved_bytes;
+    }
+
+    void Fiber::attachSharedStack()
+    {
+        if (!m_sharedStack)
+        {
+            m_sharedStack = t_shared_stacks.get();
+            m_boundThread = HPS::GetThreadId();
+        }
+        ASSERT2(m_boundThread == HPS::GetThreadId(), "shared stack fiber_id=" << m_id
+                                                     << " bound_thread=" << m_boundThread);
+        SharedStack *ss = m_sharedStack;
+        if (ss->occupant == this)
+        {
+            return;
+        }
+        //! 共享栈只能由其他栈上的协程(调度协程/主协程)切入
+        ASSERT(!t_fiber || t_fiber->m_sharedStack != ss);
+        if (ss->occupant)
+        {
+            ss->occupant->saveSharedStack();
+        }
+        ss->occupant = this;
+        if (m_state == INIT)
+        {
+            m_stack = ss->stack;
+            m_stacksize = ss->size;
+            initContext();
+            m_stack = nullptr;
+        }
+        else if (m_saveBuffer)
+        {
+            memcpy(ss->stack + ss->size - m_saveSize, m_saveBuffer, m_saveSize);
+            free(m_saveBuffer);
+            s_shared_saved_bytes -= m_saveSize;
+            m_saveBuffer = nullptr;
+            m_saveSize = 0;
+        }
+    }
+
+    void Fiber::saveSharedStack()
+    {
+        SharedStack *ss = m_sharedStack;
+        ASSERT(ss && ss->occupant == this && !m_saveBuffer);
+        //! 从切出时的栈顶(额外包含x86_64的128字节red zone)拷贝到共享栈顶
+#if HPS_FIBER_USE_ASM
+        char *sp = (char *)m_ctx.sp;
+#elif defined(__x86_64__)
+        char *sp = (char *)m_ctx.uc_mcontext.gregs[REG_RSP];
+#elif defined(__aarch64__)
+        char *sp = (char *)m_ctx.uc_mcontext.sp;
+#else
+        char *sp = ss->stack;
+#endif
+        sp = std::max(sp - 128, ss->stack);
+        char *top = ss->stack + ss->size;
+        ASSERT(sp < top);
+        m_saveSize = top - sp;
+        m_saveBuffer = (char *)malloc(m_saveSize);
+        memcpy(m_saveBuffer, sp, m_saveSize);
+        s_shared_saved_bytes += m_saveSize;
+        ss->occupant = nullptr;
+    }
+
+    void Fiber::releaseSharedStack()
+    {
+        if (m_sharedStack && m_sharedStack->occupant == this)
+        {
+            m_sharedStack->occupant = nullptr;
+        }
+        m_sharedStack = nullptr;
+        if (m_saveBuffer)
+        {
+            free(m_saveBuffer);
+            s_shared_saved_bytes -= m_saveSize;
+            m_saveBuffer = nullptr;
+            m_saveSize = 0;
+        }
+    }
+
+    const char *Fiber::ContextBackend()
+    {
+#if HPS_FIBER_USE_ASM
+        return "asm";
+#else
+        return "ucontext";
+#endif
+    }
+
+    void Fiber::initContext()
+    {
+#if HPS_FIBER_USE_ASM
+        MakeAsmContext(&m_ctx, m_stack, m_stacksize, &Fiber::MainFunc);
+#else
         if (getcontext(&m_ctx))
         {
             ASSERT2(false, "getcontext");
         }
-
+        //! 将协程栈指针和大小赋值给协程上下文
         m_ctx.uc_link = nullptr;
         m_ctx.uc_stack.ss_sp = m_stack;
         m_ctx.uc_stack.ss_size = m_stacksize;
-        m_joinSchedule = join_schedule;
-
+        //! 将协程执行函数分配给协程上下文
         makecontext(&m_ctx, &Fiber::MainFunc, 0);
-        m_state = INIT;
+#endif
+    }
+
+    void Fiber::SwapContext(Fiber *from, Fiber *to)
+    {
+#if HPS_FIBER_USE_ASM
+        //! 只切换被调用者保存寄存器,没有rt_sigprocmask系统调用
+        SwapAsmContext(&from->m_ctx, &to->m_ctx);
+#else
+        if (swapcontext(&from->m_ctx, &to->m_ctx))
+        {
+            ASSERT2(false, "swapcontext");
+        }
+#endif
     }
 
     //设置当前协程
@@ -76,6 +242,9 @@ namespace HPS
     //协程切换到后台，并且设置为Ready状态
     void Fiber::YieldToReady()
     {
+#ifndef NDEBUG
+        ASSERT2(!Scheduler::InNonBlockingTask(), "nonblocking task must not yield");
+#endif
         Fiber::ptr cur = GetThis();
         ASSERT(cur->m_state == EXEC);
         cur->m_state = READY;
@@ -85,6 +254,9 @@ namespace HPS
     //协程切换到后台，并且设置为Hold状态
     void Fiber::YieldToHold()
     {
+#ifndef NDEBUG
+        ASSERT2(!Scheduler::InNonBlockingTask(), "nonblocking task must not yield");
+#endif
         Fiber::ptr cur = GetThis();
         ASSERT(cur->m_state == EXEC);
         // cur->m_state = HOLD;
@@ -108,24 +280,22 @@ namespace HPS
 namespace HPS
 {
     //# 1) 创建协程
-    Fiber::Fiber(std::function<void()> cb, size_t stacksize, bool join_schedule)
-        : m_id(++s_fiber_id), m_cb(cb), m_joinSchedule(join_schedule)
+    Fiber::Fiber(Callback cb, size_t stacksize, bool join_schedule, bool shared_stack)
+        : m_id(++s_fiber_id), m_cb(std::move(cb)), m_joinSchedule(join_schedule), m_useSharedStack(shared_stack)
     {
-        //! 分配协程栈指针和大小
-        ++s_fiber_count;
+        //! 共享栈协程在首次切入时绑定共享栈
+        if (m_useSharedStack)
+        {
+            ++s_fiber_count;
+            LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id << " shared_stack";
+            return;
+        }
+        //! 分配协程栈指针和大小, 分配失败抛出异常时不计数
         m_stacksize = stacksize ? stacksize : g_fiber_stack_size->getValue();
         m_stack = StackAllocator::Alloc(m_stacksize);
+        ++s_fiber_count;
         //! 初始化协程上下文
-        if (getcontext(&m_ctx))
-        {
-            ASSERT2(false, "getcontext");
-        }
-        //! 将协程栈指针和大小赋值给协程上下文
-        m_ctx.uc_link = nullptr;
-        m_ctx.uc_stack.ss_sp = m_stack;
-        m_ctx.uc_stack.ss_size = m_stacksize;
-        //! 将协程执行函数分配给协程上下文
-        makecontext(&m_ctx, &Fiber::MainFunc, 0);
+        initContext();
 
         LOG_DEBUG(g_logger) << "Fiber::Fiber id=" << m_id;
     }
@@ -135,11 +305,13 @@ namespace HPS
         m_state = EXEC;
         //! 创建时将本协程设为当前协程
         SetThis(this);
-        //! 初始化协程上下文
+#if !HPS_FIBER_USE_ASM
+        //! 初始化协程上下文(汇编实现在首次切出时保存)
         if (getcontext(&m_ctx))
         {
             ASSERT2(false, "getcontext");
         }
+#endif
 
         ++s_fiber_count;
 
@@ -162,23 +334,26 @@ namespace HPS
     //# 3) 主协程切换至运行协程
     void Fiber::call()
     {
+        if (m_useSharedStack)
+        {
+            attachSharedStack();
+        }
         SetThis(this);
         m_state = EXEC;
+        //! 切换协程上下文
         if (m_joinSchedule)
         {
-            if (swapcontext(&Scheduler::GetMainFiber()->m_ctx, &m_ctx))
-            {
-                ASSERT2(false, "swapcontext");
-            }
+            SwapContext(Scheduler::GetMainFiber(), this);
         }
         else
         {
-            if (swapcontext(&t_threadFiber->m_ctx, &m_ctx))
-            {
-                ASSERT2(false, "swapcontext");
-            }
+            SwapContext(t_threadFiber.get(), this);
+        }
+        //! 共享栈协程结束后栈内容无需保留;挂起时保留在共享栈上,被换出时才拷贝
+        if (m_useSharedStack && (m_state == TERM || m_state == EXCEPT))
+        {
+            releaseSharedStack();
         }
-        //! 切换协程上下文
     }
 
     //# 4) 协程执行
@@ -226,18 +401,12 @@ namespace HPS
         if (m_joinSchedule)
         {
             SetThis(Scheduler::GetMainFiber());
-            if (swapcontext(&m_ctx, &Scheduler::GetMainFiber()->m_ctx))
-            {
-                ASSERT2(false, "swapcontext");
-            }
+            SwapContext(this, Scheduler::GetMainFiber());
         }
         else
         {
             SetThis(t_threadFiber.get());
-            if (swapcontext(&m_ctx, &t_threadFiber->m_ctx))
-            {
-                ASSERT2(false, "swapcontext");
-            }
+            SwapContext(this, t_threadFiber.get());
         }
     }
 
@@ -247,8 +416,14 @@ namespace HPS
         LOG_DEBUG(g_logger) << "Fiber::~Fiber id=" << m_id
                             << " total=" << s_fiber_count;
         --s_fiber_count;
+        //! 共享栈协程只释放保存的栈内容
+        if (m_useSharedStack)
+        {
+            ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
+            releaseSharedStack();
+        }
         //! 有协程栈时，说明为其他协程，释放协程栈空间
-        if (m_stack)
+        else if (m_stack)
         {
             ASSERT(m_state == TERM || m_state == EXCEPT || m_state == INIT);
 
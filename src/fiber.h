@@ -1,6 +1,10 @@
 #ifndef __FIBER_H__
 #define __FIBER_H__
 
+#include "mpsc_queue.h"
+#include "fiber_context.h"
+#include "inline_function.h"
+
 #include <memory>
 #include <functional>
 #include <ucontext.h>
@@ -9,16 +13,22 @@ namespace HPS
 {
 
     class Scheduler;
+    struct SharedStack;
 
     /**
      * @brief 协程类
+     * @details 协程本身是唤醒队列的侵入式节点,唤醒时入队无需分配内存
+     *          共享栈模式下,协程运行在线程的少量共享执行栈上,
+     *          切换时才把被换出协程实际使用的栈拷贝到大小合适的堆内存中
      */
-    class Fiber : public std::enable_shared_from_this<Fiber>
+    class Fiber : public std::enable_shared_from_this<Fiber>, public MpscNode
     {
         friend class Scheduler;
 
     public:
         typedef std::shared_ptr<Fiber> ptr;
+        /// 协程执行函数, 捕获不超过48字节时不分配内存
+        typedef InlineFunction<48> Callback;
 
         /**
          * @brief 协程状态
@@ -53,8 +63,10 @@ namespace HPS
          * @param[in] cb 协程执行的函数
          * @param[in] stacksize 协程栈大小
          * @param[in] join_schedule  是否在MainFiber上调度
+         * @param[in] shared_stack 是否使用共享栈模式(忽略stacksize)
+         * @attention 共享栈协程首次运行后绑定到该线程,之后只在该线程上调度
          */
-        Fiber(std::function<void()> cb, size_t stacksize = 0, bool join_schedule  = false);
+        Fiber(Callback cb, size_t stacksize = 0, bool join_schedule  = false, bool shared_stack = false);
 
         /**
          * @brief 析构函数
@@ -66,7 +78,7 @@ namespace HPS
          * @pre getState() 为 INIT, TERM, EXCEPT
          * @post getState() = INIT
          */
-        void reset(std::function<void()> cb, bool join_schedule = false);
+        void reset(Callback cb, bool join_schedule = false);
 
         /**
          * @brief 将当前线程切换到执行状态
@@ -96,6 +108,21 @@ namespace HPS
          */
         void setUseCaller(bool join_schedule );
 
+        /**
+         * @brief 是否使用共享栈
+         */
+        bool isSharedStack() const { return m_useSharedStack; }
+
+        /**
+         * @brief 共享栈协程绑定的线程id,未绑定或非共享栈协程返回-1
+         */
+        int getBoundThread() const { return m_boundThread; }
+
+        /**
+         * @brief 最近一次被调度时的优先级(Scheduler::Priority)
+         */
+        int getPriority() const { return m_priority; }
+
     public:
         /**
          * @brief 设置当前线程的运行协程
@@ -142,6 +169,42 @@ namespace HPS
          */
         static uint64_t GetFiberId();
 
+        /**
+         * @brief 返回协程上下文切换的实现名称(asm/ucontext)
+         */
+        static const char *ContextBackend();
+
+        /**
+         * @brief 共享栈协程被换出后保存在堆上的栈字节总数
+         */
+        static uint64_t SharedStackSavedBytes();
+
+    private:
+        /**
+         * @brief 在协程栈上初始化上下文,入口为MainFunc
+         */
+        void initContext();
+
+        /**
+         * @brief 保存from的上下文并切换到to
+         */
+        static void SwapContext(Fiber *from, Fiber *to);
+
+        /**
+         * @brief 切入前占用共享栈:换出当前占用者并恢复自己的栈内容
+         */
+        void attachSharedStack();
+
+        /**
+         * @brief 把已切出协程实际使用的共享栈区域拷贝到堆上
+         */
+        void saveSharedStack();
+
+        /**
+         * @brief 释放共享栈的占用和保存的栈内容
+         */
+        void releaseSharedStack();
+
     private:
         /// 协程id
         uint64_t m_id = 0;
@@ -150,13 +213,31 @@ namespace HPS
         /// 协程状态
         State m_state = INIT;
         /// 协程上下文
+#if HPS_FIBER_USE_ASM
+        AsmContext m_ctx;
+#else
         ucontext_t m_ctx;
+#endif
         /// 协程运行栈指针
         void *m_stack = nullptr;
         /// 协程运行函数
-        std::function<void()> m_cb;
+        Callback m_cb;
         /// 是否参与协程器调度
         bool m_joinSchedule = false;
+        /// 在调度器唤醒队列中时持有自身的引用,出队时释放
+        Fiber::ptr m_wakeRef;
+        /// 是否使用共享栈
+        bool m_useSharedStack = false;
+        /// 共享栈模式下绑定的线程id
+        int m_boundThread = -1;
+        /// 共享栈模式下使用的共享栈
+        SharedStack *m_sharedStack = nullptr;
+        /// 共享栈模式下换出时保存的栈内容
+        char *m_saveBuffer = nullptr;
+        /// 保存的栈内容大小
+        size_t m_saveSize = 0;
+        /// 最近一次被调度时的优先级, 由调度器设置, 默认为Scheduler::PRIORITY_NORMAL
+        int m_priority = 1;
     };
 
 }
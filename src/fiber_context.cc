@@ -0,0 +1,110 @@
+#include "fiber_context.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+//! 栈布局(由低到高): mxcsr|x87cw, r12, r13, r14, r15, rbx, rbp, 返回地址
+asm(R"(
+    .text
+    .globl hps_swap_context
+    .type hps_swap_context,@function
+    .align 16
+hps_swap_context:
+    pushq %rbp
+    pushq %rbx
+    pushq %r15
+    pushq %r14
+    pushq %r13
+    pushq %r12
+    subq $8, %rsp
+    stmxcsr (%rsp)
+    fnstcw 4(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr (%rsp)
+    fldcw 4(%rsp)
+    addq $8, %rsp
+    popq %r12
+    popq %r13
+    popq %r14
+    popq %r15
+    popq %rbx
+    popq %rbp
+    ret
+    .size hps_swap_context,.-hps_swap_context
+    .section .note.GNU-stack,"",%progbits
+    .text
+)");
+#elif defined(__aarch64__)
+//! 栈布局(由低到高): d8-d15, x19-x28, x29, x30(返回地址)
+asm(R"(
+    .text
+    .globl hps_swap_context
+    .type hps_swap_context,%function
+    .align 4
+hps_swap_context:
+    sub sp, sp, #0xb0
+    stp d8, d9, [sp, #0x00]
+    stp d10, d11, [sp, #0x10]
+    stp d12, d13, [sp, #0x20]
+    stp d14, d15, [sp, #0x30]
+    stp x19, x20, [sp, #0x40]
+    stp x21, x22, [sp, #0x50]
+    stp x23, x24, [sp, #0x60]
+    stp x25, x26, [sp, #0x70]
+    stp x27, x28, [sp, #0x80]
+    stp x29, x30, [sp, #0x90]
+    mov x9, sp
+    str x9, [x0]
+    mov sp, x1
+    ldp d8, d9, [sp, #0x00]
+    ldp d10, d11, [sp, #0x10]
+    ldp d12, d13, [sp, #0x20]
+    ldp d14, d15, [sp, #0x30]
+    ldp x19, x20, [sp, #0x40]
+    ldp x21, x22, [sp, #0x50]
+    ldp x23, x24, [sp, #0x60]
+    ldp x25, x26, [sp, #0x70]
+    ldp x27, x28, [sp, #0x80]
+    ldp x29, x30, [sp, #0x90]
+    add sp, sp, #0xb0
+    ret
+    .size hps_swap_context,.-hps_swap_context
+    .section .note.GNU-stack,"",%progbits
+    .text
+)");
+#endif
+
+namespace HPS
+{
+
+#if HPS_HAS_ASM_CONTEXT
+    void MakeAsmContext(AsmContext *ctx, void *stack, size_t size, void (*entry)())
+    {
+        //! 栈顶16字节对齐
+        uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#if defined(__x86_64__)
+        uint64_t *sp = (uint64_t *)top;
+        //! 入口函数的返回地址为0, 入口时rsp满足 rsp + 8 16字节对齐
+        *--sp = 0;
+        *--sp = (uint64_t)entry;
+        //! rbp, rbx, r15, r14, r13, r12
+        for (int i = 0; i < 6; ++i)
+        {
+            *--sp = 0;
+        }
+        //! 默认mxcsr(0x1F80)和x87控制字(0x037F)
+        *--sp = ((uint64_t)0x037F << 32) | 0x1F80;
+        ctx->sp = sp;
+#elif defined(__aarch64__)
+        uint64_t *sp = (uint64_t *)(top - 0xb0);
+        memset(sp, 0, 0xb0);
+        //! x30(lr)
+        sp[0x98 / 8] = (uint64_t)entry;
+        ctx->sp = sp;
+#endif
+    }
+#endif
+
+}
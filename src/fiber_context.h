@@ -0,0 +1,66 @@
+#ifndef __FIBER_CONTEXT_H__
+#define __FIBER_CONTEXT_H__
+
+#include <stddef.h>
+
+/// 构建时开启HPS_FIBER_ASM_CONTEXT且平台支持时,协程使用汇编上下文切换
+#if defined(HPS_FIBER_ASM_CONTEXT) && (defined(__x86_64__) || defined(__aarch64__))
+#define HPS_FIBER_USE_ASM 1
+#else
+#define HPS_FIBER_USE_ASM 0
+#endif
+
+/// 当前平台是否提供汇编上下文切换
+#if defined(__x86_64__) || defined(__aarch64__)
+#define HPS_HAS_ASM_CONTEXT 1
+#else
+#define HPS_HAS_ASM_CONTEXT 0
+#endif
+
+extern "C"
+{
+    /**
+     * @brief 保存当前被调用者保存寄存器到栈上,切换到to_sp并恢复
+     * @param[out] from_sp 保存当前上下文的栈顶
+     * @param[in] to_sp 目标上下文的栈顶
+     * @attention 不保存信号屏蔽字,因此没有系统调用
+     */
+    void hps_swap_context(void **from_sp, void *to_sp);
+}
+
+namespace HPS
+{
+
+    /**
+     * @brief 汇编实现的协程上下文
+     * @details 只保存被调用者保存寄存器(x86_64: rbx,rbp,r12-r15,mxcsr,x87控制字;
+     *          aarch64: x19-x30,d8-d15),寄存器保存在协程自己的栈上
+     */
+    struct AsmContext
+    {
+        /// 切出时的栈顶
+        void *sp = nullptr;
+    };
+
+#if HPS_HAS_ASM_CONTEXT
+    /**
+     * @brief 在栈上构造初始上下文,首次切入时执行entry
+     * @param[out] ctx 上下文
+     * @param[in] stack 栈底指针
+     * @param[in] size 栈大小
+     * @param[in] entry 入口函数,不允许返回
+     */
+    void MakeAsmContext(AsmContext *ctx, void *stack, size_t size, void (*entry)());
+
+    /**
+     * @brief 从from切换到to
+     */
+    inline void SwapAsmContext(AsmContext *from, AsmContext *to)
+    {
+        hps_swap_context(&from->sp, to->sp);
+    }
+#endif
+
+}
+
+#endif
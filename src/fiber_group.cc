@@ -0,0 +1,168 @@
+#include "fiber_group.h"
+#include "log.h"
+
+namespace HPS
+{
+
+    static Logger::ptr g_logger = LOG_NAME("system");
+
+    void WaitGroup::add(int64_t n)
+    {
+        MutexType::Lock lock(m_mutex);
+        m_count += n;
+        ASSERT(m_count >= 0);
+    }
+
+    void WaitGroup::done()
+    {
+        std::vector<ChannelWaiter::ptr> waiters;
+        {
+            MutexType::Lock lock(m_mutex);
+            ASSERT(m_count > 0);
+            if (--m_count > 0)
+            {
+                return;
+            }
+            waiters.swap(m_waiters);
+        }
+        for (auto &i : waiters)
+        {
+            if (i->claim(0))
+            {
+                i->wake();
+            }
+        }
+    }
+
+    void WaitGroup::wait()
+    {
+        ChannelWaiter::ptr waiter;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_count == 0)
+            {
+                return;
+            }
+            waiter.reset(new ChannelWaiter);
+            m_waiters.push_back(waiter);
+        }
+        waiter->wait();
+    }
+
+    int64_t WaitGroup::count()
+    {
+        MutexType::Lock lock(m_mutex);
+        return m_count;
+    }
+
+    FiberGroup::FiberGroup(Scheduler *sc)
+        : m_scheduler(sc ? sc : Scheduler::GetThis()), m_cancelled(new std::atomic<bool>(false))
+    {
+        ASSERT(m_scheduler);
+    }
+
+    FiberGroup::~FiberGroup()
+    {
+        cancel();
+        m_children.wait();
+    }
+
+    void FiberGroup::spawn(std::function<void()> cb)
+    {
+        if (*m_cancelled)
+        {
+            return;
+        }
+        m_children.add();
+        m_scheduler->schedule([this, cb]() mutable
+                              { runChild(cb); });
+    }
+
+    void FiberGroup::runChild(std::function<void()> &cb)
+    {
+        //! 排队期间组已取消时不再执行
+        if (!*m_cancelled)
+        {
+            try
+            {
+                cb();
+            }
+            catch (FiberGroupCancelled &)
+            {
+            }
+            catch (...)
+            {
+                bool first = false;
+                {
+                    MutexType::Lock lock(m_mutex);
+                    if (!m_exception)
+                    {
+                        m_exception = std::current_exception();
+                        first = true;
+                    }
+                }
+                if (first)
+                {
+                    LOG_DEBUG(g_logger) << "fiber group child failed, cancel siblings";
+                }
+                cancel();
+            }
+        }
+        //! 最后一步, 之后组可能已被析构
+        m_children.done();
+    }
+
+    void FiberGroup::join()
+    {
+        m_children.wait();
+        Timer::ptr timer;
+        std::exception_ptr e;
+        {
+            MutexType::Lock lock(m_mutex);
+            timer.swap(m_timer);
+            e = m_exception;
+        }
+        if (timer)
+        {
+            timer->cancel();
+        }
+        if (e)
+        {
+            std::rethrow_exception(e);
+        }
+    }
+
+    void FiberGroup::cancel()
+    {
+        *m_cancelled = true;
+        Timer::ptr timer;
+        {
+            MutexType::Lock lock(m_mutex);
+            timer.swap(m_timer);
+        }
+        if (timer)
+        {
+            timer->cancel();
+        }
+    }
+
+    void FiberGroup::cancelAfter(TimerManager *tm, uint64_t timeout_ms)
+    {
+        //! 回调只持有取消标记, 组析构之后触发也是安全的
+        std::shared_ptr<std::atomic<bool>> cancelled = m_cancelled;
+        Timer::ptr timer = tm->addTimer(timeout_ms, [cancelled]()
+                                        { *cancelled = true; },
+                                        false, true);
+        Timer::ptr old;
+        {
+            MutexType::Lock lock(m_mutex);
+            old.swap(m_timer);
+            m_timer = timer;
+        }
+        if (old)
+        {
+            old->cancel();
+        }
+    }
+
+}
@@ -0,0 +1,148 @@
+#ifndef __FIBER_GROUP_H__
+#define __FIBER_GROUP_H__
+
+#include "channel.h"
+#include "timer.h"
+
+#include <exception>
+#include <stdexcept>
+#include <vector>
+
+namespace HPS
+{
+
+    /**
+     * @brief 等待一组任务完成
+     * @details 在协程中等待时只挂起当前协程, 否则阻塞线程
+     */
+    class WaitGroup : Noncopyable
+    {
+    public:
+        typedef Spinlock MutexType;
+
+        /**
+         * @brief 增加未完成的任务数量
+         */
+        void add(int64_t n = 1);
+
+        /**
+         * @brief 一个任务完成, 数量归零时唤醒所有等待者
+         */
+        void done();
+
+        /**
+         * @brief 等待未完成的任务数量归零
+         */
+        void wait();
+
+        /**
+         * @brief 返回未完成的任务数量
+         */
+        int64_t count();
+
+    private:
+        /// 保护计数和等待者
+        MutexType m_mutex;
+        /// 未完成的任务数量
+        int64_t m_count = 0;
+        /// 等待者
+        std::vector<ChannelWaiter::ptr> m_waiters;
+    };
+
+    /**
+     * @brief 协程组被取消时由throwIfCancelled()抛出
+     */
+    class FiberGroupCancelled : public std::runtime_error
+    {
+    public:
+        FiberGroupCancelled()
+            : std::runtime_error("fiber group cancelled") {}
+    };
+
+    /**
+     * @brief 有作用域的协程组
+     * @details spawn()在调度器上创建子协程, join()只挂起父协程等待全部子协程结束,
+     *          并重新抛出第一个子协程的异常. 子协程抛出异常或超时时取消整个组:
+     *          尚未开始的子协程不再执行, 运行中的子协程通过isCancelled()/throwIfCancelled()协作退出.
+     *          析构时取消并等待所有子协程, 子协程不会比组存活得更久
+     */
+    class FiberGroup : Noncopyable
+    {
+    public:
+        typedef Spinlock MutexType;
+
+        /**
+         * @brief 构造函数
+         * @param[in] sc 子协程所在的调度器, 为空时使用当前调度器
+         */
+        FiberGroup(Scheduler *sc = nullptr);
+
+        /**
+         * @brief 析构函数, 取消并等待所有子协程
+         */
+        ~FiberGroup();
+
+        /**
+         * @brief 创建子协程
+         * @details 组已取消时直接丢弃
+         */
+        void spawn(std::function<void()> cb);
+
+        /**
+         * @brief 等待所有子协程结束
+         * @exception 重新抛出第一个子协程的异常(FiberGroupCancelled除外)
+         */
+        void join();
+
+        /**
+         * @brief 取消组
+         */
+        void cancel();
+
+        /**
+         * @brief 超时后取消组
+         * @param[in] tm 计时的定时器管理器(如IOManager)
+         * @param[in] timeout_ms 超时时间(毫秒)
+         */
+        void cancelAfter(TimerManager *tm, uint64_t timeout_ms);
+
+        /**
+         * @brief 是否已取消
+         */
+        bool isCancelled() const { return *m_cancelled; }
+
+        /**
+         * @brief 已取消时抛出FiberGroupCancelled, 由子协程在检查点调用
+         */
+        void throwIfCancelled() const
+        {
+            if (*m_cancelled)
+            {
+                throw FiberGroupCancelled();
+            }
+        }
+
+    private:
+        /**
+         * @brief 子协程的入口
+         */
+        void runChild(std::function<void()> &cb);
+
+    private:
+        /// 子协程所在的调度器
+        Scheduler *m_scheduler;
+        /// 未结束的子协程
+        WaitGroup m_children;
+        /// 是否已取消, 与超时定时器共享
+        std::shared_ptr<std::atomic<bool>> m_cancelled;
+        /// 保护异常和定时器
+        MutexType m_mutex;
+        /// 第一个子协程的异常
+        std::exception_ptr m_exception;
+        /// 超时取消的定时器
+        Timer::ptr m_timer;
+    };
+
+}
+
+#endif
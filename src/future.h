@@ -0,0 +1,479 @@
+#ifndef __FUTURE_H__
+#define __FUTURE_H__
+
+#include "channel.h"
+#include "timer.h"
+
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace HPS
+{
+
+    /**
+     * @brief Future超时异常
+     */
+    class FutureTimeout : public std::runtime_error
+    {
+    public:
+        FutureTimeout()
+            : std::runtime_error("future timeout") {}
+    };
+
+    /**
+     * @brief 不返回值的异步操作的结果
+     */
+    struct Unit
+    {
+    };
+
+    /**
+     * @brief 异步操作的结果类型, void提升为Unit
+     */
+    template <class R>
+    struct LiftVoid
+    {
+        typedef R type;
+    };
+
+    template <>
+    struct LiftVoid<void>
+    {
+        typedef Unit type;
+    };
+
+    /**
+     * @brief 执行函数并把结果设置到Promise, 函数返回void时设置Unit
+     */
+    template <class R>
+    struct PromiseSetter
+    {
+        template <class P, class F, class... Args>
+        static void Apply(const P &promise, F &f, Args &&...args)
+        {
+            promise.setValue(f(std::forward<Args>(args)...));
+        }
+    };
+
+    template <>
+    struct PromiseSetter<void>
+    {
+        template <class P, class F, class... Args>
+        static void Apply(const P &promise, F &f, Args &&...args)
+        {
+            f(std::forward<Args>(args)...);
+            promise.setValue(Unit());
+        }
+    };
+
+    /**
+     * @brief Future与Promise共享的状态
+     * @details 完成时在完成方的上下文中依次执行登记的回调, 完成之后登记的回调立即执行
+     */
+    template <class T>
+    class FutureState : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<FutureState> ptr;
+        typedef Spinlock MutexType;
+        typedef std::function<void()> Callback;
+
+        /**
+         * @brief 是否已完成
+         */
+        bool isReady()
+        {
+            MutexType::Lock lock(m_mutex);
+            return m_ready;
+        }
+
+        /**
+         * @brief 设置结果, 已完成时返回false
+         */
+        template <class V>
+        bool setValue(V &&value)
+        {
+            std::vector<Callback> cbs;
+            {
+                MutexType::Lock lock(m_mutex);
+                if (m_ready)
+                {
+                    return false;
+                }
+                m_value = std::forward<V>(value);
+                m_ready = true;
+                cbs.swap(m_callbacks);
+            }
+            for (auto &i : cbs)
+            {
+                i();
+            }
+            return true;
+        }
+
+        /**
+         * @brief 设置异常, 已完成时返回false
+         */
+        bool setException(std::exception_ptr e)
+        {
+            std::vector<Callback> cbs;
+            {
+                MutexType::Lock lock(m_mutex);
+                if (m_ready)
+                {
+                    return false;
+                }
+                m_exception = e;
+                m_ready = true;
+                cbs.swap(m_callbacks);
+            }
+            for (auto &i : cbs)
+            {
+                i();
+            }
+            return true;
+        }
+
+        /**
+         * @brief 登记完成回调
+         */
+        void addCallback(Callback cb)
+        {
+            {
+                MutexType::Lock lock(m_mutex);
+                if (!m_ready)
+                {
+                    m_callbacks.push_back(std::move(cb));
+                    return;
+                }
+            }
+            cb();
+        }
+
+        /**
+         * @brief 等待完成; 在协程中只挂起当前协程
+         */
+        void wait()
+        {
+            if (isReady())
+            {
+                return;
+            }
+            ChannelWaiter::ptr waiter(new ChannelWaiter);
+            addCallback([waiter]()
+                        {
+                if (waiter->claim(0))
+                {
+                    waiter->wake();
+                } });
+            waiter->wait();
+        }
+
+        /**
+         * @brief 返回结果
+         * @pre 已完成且没有异常
+         */
+        const T &value() const { return m_value; }
+
+        /**
+         * @brief 返回异常, 没有异常时为空
+         * @pre 已完成
+         */
+        std::exception_ptr exception() const { return m_exception; }
+
+    private:
+        /// 保护完成状态和回调
+        MutexType m_mutex;
+        /// 是否已完成
+        bool m_ready = false;
+        /// 结果
+        T m_value;
+        /// 异常
+        std::exception_ptr m_exception;
+        /// 完成回调
+        std::vector<Callback> m_callbacks;
+    };
+
+    template <class T>
+    class Promise;
+
+    /**
+     * @brief 异步结果
+     * @details get()在协程中只挂起当前协程, 不阻塞线程; 可以复制, 多个副本共享同一结果.
+     *          T需要可默认构造和复制
+     */
+    template <class T>
+    class Future
+    {
+    public:
+        typedef T value_type;
+
+        /**
+         * @brief 构造无效的Future
+         */
+        Future() {}
+
+        explicit Future(typename FutureState<T>::ptr state)
+            : m_state(std::move(state)) {}
+
+        /**
+         * @brief 是否关联了结果
+         */
+        bool valid() const { return (bool)m_state; }
+
+        /**
+         * @brief 是否已完成
+         */
+        bool isReady() const { return m_state && m_state->isReady(); }
+
+        /**
+         * @brief 等待完成
+         */
+        void wait() const { m_state->wait(); }
+
+        /**
+         * @brief 等待并返回结果
+         * @exception 结果为异常时重新抛出
+         */
+        T get() const
+        {
+            m_state->wait();
+            if (m_state->exception())
+            {
+                std::rethrow_exception(m_state->exception());
+            }
+            return m_state->value();
+        }
+
+        /**
+         * @brief 返回异常, 未完成或没有异常时为空
+         */
+        std::exception_ptr getException() const
+        {
+            return isReady() ? m_state->exception() : std::exception_ptr();
+        }
+
+        /**
+         * @brief 完成后在调度器上执行后续操作
+         * @param[in] sc 执行后续操作的调度器, 为空时在完成方的上下文中直接执行
+         * @param[in] f 后续操作, 参数为已完成的Future
+         * @return 后续操作的结果, 后续操作返回void时为Unit; 后续操作抛出的异常保存在结果中
+         */
+        template <class F>
+        Future<typename LiftVoid<typename std::result_of<F(Future<T>)>::type>::type> then(Scheduler *sc, F f) const
+        {
+            typedef typename std::result_of<F(Future<T>)>::type R;
+            Promise<typename LiftVoid<R>::type> promise;
+            Future<typename LiftVoid<R>::type> rt = promise.getFuture();
+            Future<T> self = *this;
+            m_state->addCallback([sc, f, self, promise]()
+                                 {
+                std::function<void()> task = [f, self, promise]() mutable
+                {
+                    try
+                    {
+                        PromiseSetter<R>::Apply(promise, f, self);
+                    }
+                    catch (...)
+                    {
+                        promise.setException(std::current_exception());
+                    }
+                };
+                if (sc)
+                {
+                    sc->schedule(std::move(task));
+                }
+                else
+                {
+                    task();
+                } });
+            return rt;
+        }
+
+        /**
+         * @brief 完成后在当前调度器上执行后续操作
+         */
+        template <class F>
+        Future<typename LiftVoid<typename std::result_of<F(Future<T>)>::type>::type> then(F f) const
+        {
+            return then(Scheduler::GetThis(), std::move(f));
+        }
+
+        /**
+         * @brief 限定完成时间
+         * @param[in] tm 计时的定时器管理器(如IOManager)
+         * @param[in] timeout_ms 超时时间(毫秒)
+         * @return 超时前完成时为原结果, 否则为FutureTimeout异常
+         */
+        Future<T> withTimeout(TimerManager *tm, uint64_t timeout_ms) const
+        {
+            Promise<T> promise;
+            Future<T> rt = promise.getFuture();
+            Timer::ptr timer = tm->addTimer(timeout_ms, [promise]() mutable
+                                            { promise.setException(std::make_exception_ptr(FutureTimeout())); });
+            Future<T> self = *this;
+            m_state->addCallback([self, promise, timer]() mutable
+                                 {
+                timer->cancel();
+                if (self.getException())
+                {
+                    promise.setException(self.getException());
+                }
+                else
+                {
+                    promise.setValue(self.m_state->value());
+                } });
+            return rt;
+        }
+
+    private:
+        /// 共享状态
+        typename FutureState<T>::ptr m_state;
+    };
+
+    /**
+     * @brief 设置异步结果的一端
+     * @details 可以复制, 只有第一次设置生效
+     */
+    template <class T>
+    class Promise
+    {
+    public:
+        Promise()
+            : m_state(std::make_shared<FutureState<T>>()) {}
+
+        /**
+         * @brief 返回关联的Future
+         */
+        Future<T> getFuture() const { return Future<T>(m_state); }
+
+        /**
+         * @brief 设置结果
+         * @return 是否设置成功, 已完成时返回false
+         */
+        bool setValue(const T &value) const { return m_state->setValue(value); }
+
+        /**
+         * @brief 设置结果
+         */
+        bool setValue(T &&value) const { return m_state->setValue(std::move(value)); }
+
+        /**
+         * @brief 设置异常
+         */
+        bool setException(std::exception_ptr e) const { return m_state->setException(e); }
+
+    private:
+        /// 共享状态
+        typename FutureState<T>::ptr m_state;
+    };
+
+    /**
+     * @brief 在调度器的新协程中执行函数
+     * @param[in] sc 调度器, 为空时使用当前调度器
+     * @return 函数的结果, 函数返回void时为Unit; 函数抛出的异常保存在结果中
+     */
+    template <class F>
+    Future<typename LiftVoid<typename std::result_of<F()>::type>::type> Async(Scheduler *sc, F f)
+    {
+        typedef typename std::result_of<F()>::type R;
+        if (!sc)
+        {
+            sc = Scheduler::GetThis();
+        }
+        ASSERT(sc);
+        Promise<typename LiftVoid<R>::type> promise;
+        Future<typename LiftVoid<R>::type> rt = promise.getFuture();
+        sc->schedule(std::function<void()>([f, promise]() mutable
+                                           {
+            try
+            {
+                PromiseSetter<R>::Apply(promise, f);
+            }
+            catch (...)
+            {
+                promise.setException(std::current_exception());
+            } }));
+        return rt;
+    }
+
+    /**
+     * @brief 全部完成
+     * @return 按顺序排列的全部结果; 任一失败时为最先出现的异常
+     */
+    template <class T>
+    Future<std::vector<T>> WhenAll(const std::vector<Future<T>> &futures)
+    {
+        struct Context
+        {
+            Promise<std::vector<T>> promise;
+            std::vector<T> values;
+            std::atomic<size_t> left;
+        };
+        std::shared_ptr<Context> ctx(new Context);
+        ctx->values.resize(futures.size());
+        ctx->left = futures.size();
+        Future<std::vector<T>> rt = ctx->promise.getFuture();
+        if (futures.empty())
+        {
+            ctx->promise.setValue(std::vector<T>());
+            return rt;
+        }
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            Future<T> f = futures[i];
+            f.then(nullptr, [ctx, i](Future<T> f)
+                   {
+                if (f.getException())
+                {
+                    ctx->promise.setException(f.getException());
+                }
+                else
+                {
+                    ctx->values[i] = f.get();
+                }
+                //! 每个下标只由一个回调写入, 最后完成的回调发布全部结果
+                if (--ctx->left == 0)
+                {
+                    ctx->promise.setValue(std::move(ctx->values));
+                } });
+        }
+        return rt;
+    }
+
+    /**
+     * @brief 任一完成
+     * @return 最先完成的下标及结果; 最先完成的失败时为其异常
+     */
+    template <class T>
+    Future<std::pair<size_t, T>> WhenAny(const std::vector<Future<T>> &futures)
+    {
+        Promise<std::pair<size_t, T>> promise;
+        Future<std::pair<size_t, T>> rt = promise.getFuture();
+        if (futures.empty())
+        {
+            promise.setException(std::make_exception_ptr(std::invalid_argument("WhenAny of no futures")));
+            return rt;
+        }
+        for (size_t i = 0; i < futures.size(); ++i)
+        {
+            futures[i].then(nullptr, [promise, i](Future<T> f)
+                            {
+                if (f.getException())
+                {
+                    promise.setException(f.getException());
+                }
+                else
+                {
+                    promise.setValue(std::make_pair(i, f.get()));
+                } });
+        }
+        return rt;
+    }
+
+}
+
+#endif
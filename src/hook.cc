@@ -5,9 +5,17 @@
 #include "iomanager.h"
 #include "fd_manager.h"
 #include "macro.h"
+#include "offload.h"
 
+#include <algorithm>
 #include <dlfcn.h>
 #include <stdarg.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <vector>
 
 HPS::Logger::ptr g_logger = LOG_NAME("system");
 namespace HPS
@@ -17,8 +25,18 @@ namespace HPS
         HPS::Config::Lookup("tcp.connect.timeout", 5000, "tcp connect timeout");
 
     static thread_local bool t_hook_enable = false;
+    //! 线程内do_io/io_uring实际发起的读写系统调用次数
+    static thread_local uint64_t t_hook_io_count = 0;
+
+    static HPS::ConfigVar<bool>::ptr g_hook_offload_file_io =
+        HPS::Config::Lookup("hook.offload_file_io", true, "route hooked regular file io through the offload pool");
+
+    static HPS::ConfigVar<uint32_t>::ptr g_hook_offload_min_bytes =
+        HPS::Config::Lookup<uint32_t>("hook.offload_min_bytes", 16 * 1024, "min bytes of a regular file read/write to offload");
 
     static uint64_t s_connect_timeout = -1;
+    static bool s_offload_file_io = true;
+    static uint32_t s_offload_min_bytes = 16 * 1024;
 
     bool is_hook_enable()
     {
@@ -30,6 +48,11 @@ namespace HPS
         t_hook_enable = flag;
     }
 
+    uint64_t get_hook_io_count()
+    {
+        return t_hook_io_count;
+    }
+
 }
 
 //# 整体逻辑
@@ -40,16 +63,35 @@ namespace HPS
     XX(sleep)        \
     XX(usleep)       \
     XX(nanosleep)    \
+    XX(clock_nanosleep) \
     XX(socket)       \
     XX(connect)      \
     XX(accept)       \
+    XX(accept4)      \
+    XX(socketpair)   \
+    XX(pipe)         \
+    XX(pipe2)        \
+    XX(eventfd)      \
+    XX(dup)          \
+    XX(dup2)         \
+    XX(dup3)         \
+    XX(poll)         \
+    XX(ppoll)        \
+    XX(select)       \
+    XX(epoll_wait)   \
     XX(read)         \
     XX(readv)        \
+    XX(pread)        \
+    XX(preadv2)      \
     XX(recv)         \
     XX(recvfrom)     \
     XX(recvmsg)      \
     XX(write)        \
     XX(writev)       \
+    XX(pwrite)       \
+    XX(fsync)        \
+    XX(sendfile)     \
+    XX(splice)       \
     XX(send)         \
     XX(sendto)       \
     XX(sendmsg)      \
@@ -87,6 +129,13 @@ namespace HPS
                 LOG_INFO(g_logger) << "tcp connect timeout changed from "
                                          << old_value << " to " << new_value;
                 s_connect_timeout = new_value; });
+
+            s_offload_file_io = g_hook_offload_file_io->getValue();
+            g_hook_offload_file_io->addListener([](const bool &old_value, const bool &new_value)
+                                                { s_offload_file_io = new_value; });
+            s_offload_min_bytes = g_hook_offload_min_bytes->getValue();
+            g_hook_offload_min_bytes->addListener([](const uint32_t &old_value, const uint32_t &new_value)
+                                                  { s_offload_min_bytes = new_value; });
         }
     };
 
@@ -99,6 +148,299 @@ struct timer_info
     int cancelled = 0;
 };
 
+//! 读写超时: 在定时器管理器锁内执行, 取消事件唤醒等待的协程
+static void OnIoTimeout(HPS::TimerNode *node)
+{
+    HPS::IoTimeoutNode *t = static_cast<HPS::IoTimeoutNode *>(node);
+    if (t->cancelled)
+    {
+        return;
+    }
+    t->cancelled = ETIMEDOUT;
+    t->iom->cancelEvent(t->fd, (HPS::IOManager::Event)(t->event));
+}
+
+//! io_uring后端可用时返回IO管理器: 协程中阻塞模式的socket,
+//! 且协程不在共享栈上(内核异步读写的缓冲区可能位于栈上, 换出时会被覆盖)
+static HPS::IOManager *uring_iom(int fd, HPS::FdCtx::ptr &ctx)
+{
+    if (!HPS::t_hook_enable)
+    {
+        return nullptr;
+    }
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    if (!iom || !iom->hasUring() || HPS::Fiber::GetThis()->isSharedStack())
+    {
+        return nullptr;
+    }
+    ctx = HPS::FdMgr::GetInstance()->get(fd);
+    if (!ctx || ctx->isClose() || !ctx->isSocket() || ctx->getUserNonblock())
+    {
+        return nullptr;
+    }
+    return iom;
+}
+
+//! 通过io_uring提交操作本身并等待完成, 返回false时走epoll方式
+//! timeout_so为0时使用timeout_ms作为超时时间
+template <typename Prep>
+static bool uring_io(int fd, int timeout_so, uint64_t timeout_ms, Prep prep, ssize_t &n)
+{
+    HPS::FdCtx::ptr ctx;
+    HPS::IOManager *iom = uring_iom(fd, ctx);
+    if (!iom)
+    {
+        return false;
+    }
+    io_uring_sqe sqe;
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = fd;
+    prep(sqe);
+    int res = 0;
+    uint64_t to = timeout_so ? ctx->getTimeout(timeout_so) : timeout_ms;
+    if (!iom->uringSubmit(sqe, to, res))
+    {
+        return false;
+    }
+    if (res < 0)
+    {
+        //! 只有链接的超时操作会取消读写
+        errno = res == -ECANCELED ? ETIMEDOUT : -res;
+        n = -1;
+    }
+    else
+    {
+        n = res;
+    }
+    return true;
+}
+
+//! 普通文件(及块设备)的读写不会返回EAGAIN, 只能在其他线程上阻塞:
+//! 协程中开启hook时交给offload线程池, 当前协程挂起.
+//! 小于hook.offload_min_bytes的读写(如带缓冲的流和日志)只是页缓存拷贝, 切换线程反而更慢.
+//! 共享栈上的协程不交出: 缓冲区可能位于栈上, 挂起换出后线程写入会破坏其他协程的栈
+static bool offload_file(int fd, size_t bytes)
+{
+    if (!HPS::t_hook_enable || !HPS::s_offload_file_io || bytes < HPS::s_offload_min_bytes || !HPS::ChannelWaiter::CanSuspend()
+        || HPS::Fiber::GetThis()->isSharedStack())
+    {
+        return false;
+    }
+    //! 不为文件创建句柄上下文, 以免在未hook的线程上关闭后残留
+    HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd);
+    if (ctx && ctx->isPollable())
+    {
+        return false;
+    }
+    struct stat fd_stat;
+    if (-1 == fstat(fd, &fd_stat))
+    {
+        return false;
+    }
+    return S_ISREG(fd_stat.st_mode) || S_ISBLK(fd_stat.st_mode);
+}
+
+//! iovec的总字节数
+static size_t iov_bytes(const struct iovec *iov, int iovcnt)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        bytes += iov[i].iov_len;
+    }
+    return bytes;
+}
+
+//! 在offload线程池中执行原始调用, 返回false时由调用方直接执行
+template <typename OriginFun, typename... Args>
+static bool offload_io(int fd, size_t bytes, ssize_t &n, OriginFun fun, Args... args)
+{
+    if (!offload_file(fd, bytes))
+    {
+        return false;
+    }
+    int err = 0;
+    HPS::OffloadMgr::GetInstance()->run([&]()
+                                        {
+        n = fun(fd, args...);
+        err = errno; });
+    errno = err;
+    return true;
+}
+
+//! 可以只挂起当前协程时返回IO管理器: 开启hook, 在IO管理器的任务协程中
+static HPS::IOManager *hook_iom()
+{
+    if (!HPS::t_hook_enable)
+    {
+        return nullptr;
+    }
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    return iom && HPS::ChannelWaiter::CanSuspend() ? iom : nullptr;
+}
+
+//! 句柄关闭(或被dup2覆盖)前清除等待的事件和句柄上下文
+static void forget_fd(int fd)
+{
+    HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd);
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    if (ctx)
+    {
+        if (iom)
+        {
+            iom->cancelAll(fd);
+            iom->uringCancel(fd);
+        }
+        HPS::FdMgr::GetInstance()->del(fd);
+    }
+    //! poll可能为未登记的句柄留下持久注册
+    if (iom)
+    {
+        iom->delFd(fd);
+    }
+}
+
+//! 挂起当前协程us微秒, 由微秒精度的定时器唤醒
+static void hook_sleep_us(uint64_t us)
+{
+    HPS::Fiber::ptr fiber = HPS::Fiber::GetThis();
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    iom->addTimerUs(us, std::bind((void(HPS::Scheduler::*)(HPS::Fiber::ptr, int thread, HPS::Scheduler::Priority)) & HPS::IOManager::schedule, iom, fiber, -1, (HPS::Scheduler::Priority)fiber->getPriority()),
+                    false, true);
+    HPS::Fiber::YieldToHold();
+}
+
+//! timespec换算为微秒, 不足1微秒的部分向上取整, 不会提前唤醒
+static uint64_t timespec_to_us(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000 * 1000ull + (ts->tv_nsec + 999) / 1000;
+}
+
+//! 登记新建的句柄, 替换未hook关闭时残留的同号上下文;
+//! pollable为true时句柄由hook创建(管道, eventfd), 可设为非阻塞由hook等待
+static HPS::FdCtx::ptr register_fd(int fd, bool user_nonblock, bool pollable = false)
+{
+    HPS::FdMgr::GetInstance()->del(fd);
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    if (iom)
+    {
+        iom->delFd(fd);
+    }
+    HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd, true);
+    if (ctx && pollable)
+    {
+        ctx->setPollable();
+    }
+    if (ctx && user_nonblock)
+    {
+        ctx->setUserNonblock(true);
+    }
+    return ctx;
+}
+
+//! dup出的句柄继承原句柄的非阻塞设置和超时
+static void register_dup_fd(int oldfd, int newfd)
+{
+    HPS::FdCtx::ptr old = HPS::FdMgr::GetInstance()->get(oldfd);
+    if (!old)
+    {
+        HPS::FdMgr::GetInstance()->del(newfd);
+        return;
+    }
+    //! 复制的句柄共享打开文件描述, 原句柄已设为非阻塞
+    HPS::FdCtx::ptr ctx = register_fd(newfd, old->getUserNonblock(), old->isPollable());
+    if (ctx)
+    {
+        ctx->setTimeout(SO_RCVTIMEO, old->getTimeout(SO_RCVTIMEO));
+        ctx->setTimeout(SO_SNDTIMEO, old->getTimeout(SO_SNDTIMEO));
+    }
+}
+
+//! 在IO管理器上实现poll: 先不阻塞地检查, 未就绪时为每个句柄登记事件并由定时器限时,
+//! 其他协程已在等待的事件共享其注册. 任一事件就绪或超时后撤销其余登记并重新检查.
+//! 边缘触发可能带来虚假唤醒, 循环直到就绪或超时
+static int hook_poll(HPS::IOManager *iom, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    uint64_t deadline = timeout < 0 ? (uint64_t)-1 : HPS::GetCurrentMS() + timeout;
+    while (true)
+    {
+        int rt = poll_f(fds, nfds, 0);
+        if (rt != 0 || timeout == 0)
+        {
+            return rt;
+        }
+        uint64_t now = HPS::GetCurrentMS();
+        if (now >= deadline)
+        {
+            return 0;
+        }
+        uint64_t wait_ms = deadline == (uint64_t)-1 ? (uint64_t)-1 : deadline - now;
+
+        HPS::ChannelWaiter::ptr waiter(new HPS::ChannelWaiter);
+        std::function<void()> wake = [waiter]()
+        {
+            if (waiter->claim(0))
+            {
+                waiter->wake();
+            }
+        };
+        //! 登记的事件及共享等待者id, id为0表示独自登记
+        std::vector<std::tuple<int, HPS::IOManager::Event, uint64_t>> added;
+        for (nfds_t i = 0; i < nfds; ++i)
+        {
+            if (fds[i].fd < 0)
+            {
+                continue;
+            }
+            HPS::IOManager::Event events[2] = {HPS::IOManager::NONE, HPS::IOManager::NONE};
+            if (fds[i].events & (POLLIN | POLLPRI | POLLRDHUP))
+            {
+                events[0] = HPS::IOManager::READ;
+            }
+            if (fds[i].events & POLLOUT)
+            {
+                events[1] = HPS::IOManager::WRITE;
+            }
+            for (auto event : events)
+            {
+                if (event == HPS::IOManager::NONE)
+                {
+                    continue;
+                }
+                uint64_t watcher = 0;
+                //! 登记失败(如epoll_ctl出错)时改为短间隔重新检查
+                if (iom->watchEvent(fds[i].fd, event, wake, watcher) != 0)
+                {
+                    wait_ms = std::min<uint64_t>(wait_ms, 10);
+                    continue;
+                }
+                added.push_back(std::make_tuple(fds[i].fd, event, watcher));
+            }
+        }
+        HPS::Timer::ptr timer;
+        if (wait_ms != (uint64_t)-1)
+        {
+            timer = iom->addTimer(wait_ms, wake, false, true);
+        }
+        waiter->wait();
+        if (timer)
+        {
+            timer->cancel();
+        }
+        for (auto &i : added)
+        {
+            if (std::get<2>(i))
+            {
+                iom->delWatcher(std::get<0>(i), std::get<1>(i), std::get<2>(i));
+            }
+            else
+            {
+                iom->delEvent(std::get<0>(i), std::get<1>(i));
+            }
+        }
+    }
+}
+
 //# 6) 自定义IO(!!!)
 template <typename OriginFun, typename... Args>
 static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name,
@@ -121,72 +463,77 @@ static ssize_t do_io(int fd, OriginFun fun, const char *hook_fun_name,
         errno = EBADF;
         return -1;
     }
-    //! 不是socket句柄或用户主动设为阻塞
-    if (!ctx->isSocket() || ctx->getUserNonblock())
+    //! 不可等待的句柄或用户主动设为非阻塞
+    if (!ctx->isPollable() || ctx->getUserNonblock())
     {
         return fun(fd, std::forward<Args>(args)...);
     }
     //! 获取socket接收或发送的超时时间
     uint64_t to = ctx->getTimeout(timeout_so);
-    std::shared_ptr<timer_info> tinfo(new timer_info);
+    //! 超时定时器嵌入在句柄上下文中, 等待期间ctx保证其有效
+    HPS::IoTimeoutNode *tnode = ctx->getTimeoutNode(timeout_so);
 
 retry:
     //! foward完美转发参数
+    ++HPS::t_hook_io_count;
     ssize_t n = fun(fd, std::forward<Args>(args)...);
     //! 读写时发生中断
     while (n == -1 && errno == EINTR)
     {
         //! 重新调用，读完为止
+        ++HPS::t_hook_io_count;
         n = fun(fd, std::forward<Args>(args)...);
     }
     //! 连续做read操作而没有数据可读
     if (n == -1 && errno == EAGAIN)
     {
         HPS::IOManager *iom = HPS::IOManager::GetThis();
-        HPS::Timer::ptr timer;
-        std::weak_ptr<timer_info> winfo(tinfo);
+        tnode->cancelled = 0;
         //! 句柄存在超时时间
         if (to != (uint64_t)-1)
         {
-            timer = iom->addConditionTimer(
-                to, [winfo, fd, iom, event]()
-                {
-                auto t = winfo.lock();
-                if(!t || t->cancelled) {
-                    return;
-                }
-                t->cancelled = ETIMEDOUT;
-                //! 执行并取消事件
-                iom->cancelEvent(fd, (HPS::IOManager::Event)(event)); },
-                winfo);
+            tnode->iom = iom;
+            tnode->fd = fd;
+            tnode->event = event;
+            iom->armTimer(tnode, to, &OnIoTimeout);
         }
-        //! 添加事件的回调为空,默认当前协程为回调
-        int rt = iom->addEvent(fd, (HPS::IOManager::Event)(event));
-        //! 添加事件失败，rt!=0
-        if (UNLIKELY(rt))
+        //! 添加事件的回调为空,默认当前协程为回调, 唤醒时沿用当前协程的优先级
+        int rt = iom->addEvent(fd, (HPS::IOManager::Event)(event), nullptr, true);
+        //! 添加事件失败，rt<0
+        if (UNLIKELY(rt < 0))
         {
             LOG_ERROR(g_logger) << hook_fun_name << " addEvent("
                                 << fd << ", " << event << ")";
-            if (timer)
+            if (to != (uint64_t)-1)
             {
-                timer->cancel();
+                iom->disarmTimer(tnode);
             }
             return -1;
         }
+        else if (rt > 0)
+        {
+            //! 持久注册模式下事件已就绪, 无需等待
+            if (to != (uint64_t)-1)
+            {
+                iom->disarmTimer(tnode);
+            }
+            goto retry;
+        }
         else
         {
             //! 添加事件成功
             //! 让出协程执行权限???
             HPS::Fiber::YieldToHold();
             //! 当条件定时器超时时,会唤醒协程,当数据回来时,也会唤醒协程???
-            if (timer)
+            //! 摘下后超时回调不会再执行, cancelled可安全读取
+            if (to != (uint64_t)-1)
             {
-                timer->cancel();
+                iom->disarmTimer(tnode);
             }
             //! 通过定时任务唤醒
-            if (tinfo->cancelled)
+            if (tnode->cancelled)
             {
-                errno = tinfo->cancelled;
+                errno = tnode->cancelled;
                 return -1;
             }
             //! 有IO事件,需要重新读
@@ -210,10 +557,7 @@ extern "C"
             return sleep_f(seconds);
         }
 
-        HPS::Fiber::ptr fiber = HPS::Fiber::GetThis();
-        HPS::IOManager *iom = HPS::IOManager::GetThis();
-        iom->addTimer(seconds * 1000, std::bind((void(HPS::Scheduler::*)(HPS::Fiber::ptr, int thread)) & HPS::IOManager::schedule, iom, fiber, -1));
-        HPS::Fiber::YieldToHold();
+        hook_sleep_us(seconds * 1000 * 1000ull);
         return 0;
     }
 
@@ -223,10 +567,7 @@ extern "C"
         {
             return usleep_f(usec);
         }
-        HPS::Fiber::ptr fiber = HPS::Fiber::GetThis();
-        HPS::IOManager *iom = HPS::IOManager::GetThis();
-        iom->addTimer(usec / 1000, std::bind((void(HPS::Scheduler::*)(HPS::Fiber::ptr, int thread)) & HPS::IOManager::schedule, iom, fiber, -1));
-        HPS::Fiber::YieldToHold();
+        hook_sleep_us(usec);
         return 0;
     }
 
@@ -237,11 +578,36 @@ extern "C"
             return nanosleep_f(req, rem);
         }
 
-        int timeout_ms = req->tv_sec * 1000 + req->tv_nsec / 1000 / 1000;
-        HPS::Fiber::ptr fiber = HPS::Fiber::GetThis();
-        HPS::IOManager *iom = HPS::IOManager::GetThis();
-        iom->addTimer(timeout_ms, std::bind((void(HPS::Scheduler::*)(HPS::Fiber::ptr, int thread)) & HPS::IOManager::schedule, iom, fiber, -1));
-        HPS::Fiber::YieldToHold();
+        if (req->tv_sec < 0 || req->tv_nsec < 0 || req->tv_nsec >= 1000 * 1000 * 1000)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        hook_sleep_us(timespec_to_us(req));
+        return 0;
+    }
+
+    int clock_nanosleep(clockid_t clockid, int flags, const struct timespec *request, struct timespec *remain)
+    {
+        //! CPU时间等时钟无法用定时器等待, 交给原函数
+        if (!HPS::t_hook_enable || (clockid != CLOCK_REALTIME && clockid != CLOCK_MONOTONIC))
+        {
+            return clock_nanosleep_f(clockid, flags, request, remain);
+        }
+        if (request->tv_sec < 0 || request->tv_nsec < 0 || request->tv_nsec >= 1000 * 1000 * 1000)
+        {
+            return EINVAL;
+        }
+        uint64_t us = timespec_to_us(request);
+        if (flags & TIMER_ABSTIME)
+        {
+            //! 绝对时间换算为相对于该时钟当前时间的间隔
+            struct timespec now;
+            clock_gettime(clockid, &now);
+            uint64_t now_us = now.tv_sec * 1000 * 1000ull + now.tv_nsec / 1000;
+            us = us > now_us ? us - now_us : 0;
+        }
+        hook_sleep_us(us);
         return 0;
     }
 
@@ -256,7 +622,7 @@ extern "C"
         {
             return fd;
         }
-        HPS::FdMgr::GetInstance()->get(fd, true);
+        register_fd(fd, type & SOCK_NONBLOCK);
         return fd;
     }
 
@@ -283,6 +649,17 @@ extern "C"
             return connect_f(fd, addr, addrlen);
         }
 
+        ssize_t res = 0;
+        if (uring_io(fd, 0, timeout_ms, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_CONNECT;
+            sqe.addr = (uint64_t)addr;
+            sqe.off = addrlen; },
+                     res))
+        {
+            return res;
+        }
+
         int n = connect_f(fd, addr, addrlen);
         if (n == 0)
         {
@@ -309,10 +686,10 @@ extern "C"
                 }
                 t->cancelled = ETIMEDOUT;
                 iom->cancelEvent(fd, HPS::IOManager::WRITE); },
-                winfo);
+                winfo, false, true);
         }
 
-        int rt = iom->addEvent(fd, HPS::IOManager::WRITE);
+        int rt = iom->addEvent(fd, HPS::IOManager::WRITE, nullptr, true);
         if (rt == 0)
         {
             HPS::Fiber::YieldToHold();
@@ -332,7 +709,11 @@ extern "C"
             {
                 timer->cancel();
             }
-            LOG_ERROR(g_logger) << "connect addEvent(" << fd << ", WRITE) error";
+            //! 大于0表示持久注册模式下已可写
+            if (rt < 0)
+            {
+                LOG_ERROR(g_logger) << "connect addEvent(" << fd << ", WRITE) error";
+            }
         }
 
         int error = 0;
@@ -359,27 +740,312 @@ extern "C"
 
     int accept(int s, struct sockaddr *addr, socklen_t *addrlen)
     {
-        int fd = do_io(s, accept_f, "accept", HPS::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+        ssize_t rt = 0;
+        int fd = 0;
+        if (uring_io(s, SO_RCVTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_ACCEPT;
+            sqe.addr = (uint64_t)addr;
+            sqe.addr2 = (uint64_t)addrlen; },
+                     rt))
+        {
+            fd = rt;
+        }
+        else
+        {
+            fd = do_io(s, accept_f, "accept", HPS::IOManager::READ, SO_RCVTIMEO, addr, addrlen);
+        }
         if (fd >= 0)
         {
-            HPS::FdMgr::GetInstance()->get(fd, true);
+            register_fd(fd, false);
         }
         return fd;
     }
 
+    int accept4(int s, struct sockaddr *addr, socklen_t *addrlen, int flags)
+    {
+        int fd = do_io(s, accept4_f, "accept4", HPS::IOManager::READ, SO_RCVTIMEO, addr, addrlen, flags);
+        if (fd >= 0)
+        {
+            register_fd(fd, flags & SOCK_NONBLOCK);
+        }
+        return fd;
+    }
+
+    int socketpair(int domain, int type, int protocol, int sv[2])
+    {
+        int rt = socketpair_f(domain, type, protocol, sv);
+        if (rt == 0 && HPS::t_hook_enable)
+        {
+            register_fd(sv[0], type & SOCK_NONBLOCK);
+            register_fd(sv[1], type & SOCK_NONBLOCK);
+        }
+        return rt;
+    }
+
+    int pipe(int pipefd[2])
+    {
+        return pipe2(pipefd, 0);
+    }
+
+    int pipe2(int pipefd[2], int flags)
+    {
+        int rt = pipe2_f(pipefd, flags);
+        if (rt == 0 && HPS::t_hook_enable)
+        {
+            register_fd(pipefd[0], flags & O_NONBLOCK, true);
+            register_fd(pipefd[1], flags & O_NONBLOCK, true);
+        }
+        return rt;
+    }
+
+    int eventfd(unsigned int initval, int flags)
+    {
+        int fd = eventfd_f(initval, flags);
+        if (fd >= 0 && HPS::t_hook_enable)
+        {
+            register_fd(fd, flags & EFD_NONBLOCK, true);
+        }
+        return fd;
+    }
+
+    int dup(int oldfd)
+    {
+        int fd = dup_f(oldfd);
+        if (fd >= 0 && HPS::t_hook_enable)
+        {
+            register_dup_fd(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int dup2(int oldfd, int newfd)
+    {
+        if (!HPS::t_hook_enable || oldfd == newfd)
+        {
+            return dup2_f(oldfd, newfd);
+        }
+        //! newfd被隐式关闭
+        forget_fd(newfd);
+        int fd = dup2_f(oldfd, newfd);
+        if (fd >= 0)
+        {
+            register_dup_fd(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int dup3(int oldfd, int newfd, int flags)
+    {
+        if (!HPS::t_hook_enable || oldfd == newfd)
+        {
+            return dup3_f(oldfd, newfd, flags);
+        }
+        forget_fd(newfd);
+        int fd = dup3_f(oldfd, newfd, flags);
+        if (fd >= 0)
+        {
+            register_dup_fd(oldfd, fd);
+        }
+        return fd;
+    }
+
+    int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+    {
+        HPS::IOManager *iom = hook_iom();
+        if (!iom)
+        {
+            return poll_f(fds, nfds, timeout);
+        }
+        return hook_poll(iom, fds, nfds, timeout);
+    }
+
+    int ppoll(struct pollfd *fds, nfds_t nfds, const struct timespec *tmo_p, const sigset_t *sigmask)
+    {
+        //! 需要原子地替换信号掩码时无法模拟
+        HPS::IOManager *iom = hook_iom();
+        if (!iom || sigmask)
+        {
+            return ppoll_f(fds, nfds, tmo_p, sigmask);
+        }
+        int timeout = tmo_p ? tmo_p->tv_sec * 1000 + (tmo_p->tv_nsec + 999999) / 1000000 : -1;
+        return hook_poll(iom, fds, nfds, timeout);
+    }
+
+    int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+    {
+        HPS::IOManager *iom = hook_iom();
+        if (!iom)
+        {
+            return select_f(nfds, readfds, writefds, exceptfds, timeout);
+        }
+        std::vector<pollfd> fds;
+        for (int fd = 0; fd < nfds; ++fd)
+        {
+            short events = 0;
+            if (readfds && FD_ISSET(fd, readfds))
+            {
+                events |= POLLIN;
+            }
+            if (writefds && FD_ISSET(fd, writefds))
+            {
+                events |= POLLOUT;
+            }
+            if (exceptfds && FD_ISSET(fd, exceptfds))
+            {
+                events |= POLLPRI;
+            }
+            if (events)
+            {
+                pollfd pfd;
+                pfd.fd = fd;
+                pfd.events = events;
+                pfd.revents = 0;
+                fds.push_back(pfd);
+            }
+        }
+        int ms = timeout ? timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000 : -1;
+        int rt = hook_poll(iom, fds.data(), fds.size(), ms);
+        if (rt < 0)
+        {
+            return rt;
+        }
+        for (auto &i : fds)
+        {
+            if (i.revents & POLLNVAL)
+            {
+                errno = EBADF;
+                return -1;
+            }
+        }
+        rt = 0;
+        for (auto &i : fds)
+        {
+            if (readfds && FD_ISSET(i.fd, readfds) && !(i.revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                FD_CLR(i.fd, readfds);
+            }
+            if (writefds && FD_ISSET(i.fd, writefds) && !(i.revents & (POLLOUT | POLLERR)))
+            {
+                FD_CLR(i.fd, writefds);
+            }
+            if (exceptfds && FD_ISSET(i.fd, exceptfds) && !(i.revents & POLLPRI))
+            {
+                FD_CLR(i.fd, exceptfds);
+            }
+            rt += (readfds && FD_ISSET(i.fd, readfds)) + (writefds && FD_ISSET(i.fd, writefds)) + (exceptfds && FD_ISSET(i.fd, exceptfds));
+        }
+        return rt;
+    }
+
+    int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+    {
+        HPS::IOManager *iom = hook_iom();
+        if (!iom)
+        {
+            return epoll_wait_f(epfd, events, maxevents, timeout);
+        }
+        //! epoll句柄有事件就绪时可读, 等待它可读后再不阻塞地取出事件
+        uint64_t deadline = timeout < 0 ? (uint64_t)-1 : HPS::GetCurrentMS() + timeout;
+        while (true)
+        {
+            int rt = epoll_wait_f(epfd, events, maxevents, 0);
+            if (rt != 0 || timeout == 0)
+            {
+                return rt;
+            }
+            uint64_t now = HPS::GetCurrentMS();
+            if (now >= deadline)
+            {
+                return 0;
+            }
+            pollfd pfd;
+            pfd.fd = epfd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            rt = hook_poll(iom, &pfd, 1, deadline == (uint64_t)-1 ? -1 : (int)(deadline - now));
+            if (rt <= 0)
+            {
+                return rt;
+            }
+        }
+    }
+
     //# 7) 调用自定义钩子函数
     ssize_t read(int fd, void *buf, size_t count)
     {
+        ssize_t n = 0;
+        if (offload_io(fd, count, n, read_f, buf, count))
+        {
+            return n;
+        }
+        if (uring_io(fd, SO_RCVTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_RECV;
+            sqe.addr = (uint64_t)buf;
+            sqe.len = std::min<size_t>(count, UINT32_MAX); },
+                     n))
+        {
+            return n;
+        }
         return do_io(fd, read_f, "read", HPS::IOManager::READ, SO_RCVTIMEO, buf, count);
     }
 
+    ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+    {
+        ssize_t n = 0;
+        if (offload_io(fd, count, n, pread_f, buf, count, offset))
+        {
+            return n;
+        }
+        return pread_f(fd, buf, count, offset);
+    }
+
     ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
     {
+        ssize_t n = 0;
+        if (offload_io(fd, iov_bytes(iov, iovcnt), n, readv_f, iov, iovcnt))
+        {
+            return n;
+        }
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec *)iov;
+        msg.msg_iovlen = iovcnt;
+        if (uring_io(fd, SO_RCVTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_RECVMSG;
+            sqe.addr = (uint64_t)&msg; },
+                     n))
+        {
+            return n;
+        }
         return do_io(fd, readv_f, "readv", HPS::IOManager::READ, SO_RCVTIMEO, iov, iovcnt);
     }
 
+    ssize_t preadv2(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags)
+    {
+        ssize_t n = 0;
+        if (offload_io(fd, iov_bytes(iov, iovcnt), n, preadv2_f, iov, iovcnt, offset, flags))
+        {
+            return n;
+        }
+        return do_io(fd, preadv2_f, "preadv2", HPS::IOManager::READ, SO_RCVTIMEO, iov, iovcnt, offset, flags);
+    }
+
     ssize_t recv(int sockfd, void *buf, size_t len, int flags)
     {
+        ssize_t n = 0;
+        if (uring_io(sockfd, SO_RCVTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_RECV;
+            sqe.addr = (uint64_t)buf;
+            sqe.len = std::min<size_t>(len, UINT32_MAX);
+            sqe.msg_flags = flags; },
+                     n))
+        {
+            return n;
+        }
         return do_io(sockfd, recv_f, "recv", HPS::IOManager::READ, SO_RCVTIMEO, buf, len, flags);
     }
 
@@ -390,21 +1056,160 @@ extern "C"
 
     ssize_t recvmsg(int sockfd, struct msghdr *msg, int flags)
     {
+        ssize_t n = 0;
+        if (uring_io(sockfd, SO_RCVTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_RECVMSG;
+            sqe.addr = (uint64_t)msg;
+            sqe.msg_flags = flags; },
+                     n))
+        {
+            return n;
+        }
         return do_io(sockfd, recvmsg_f, "recvmsg", HPS::IOManager::READ, SO_RCVTIMEO, msg, flags);
     }
 
     ssize_t write(int fd, const void *buf, size_t count)
     {
+        ssize_t n = 0;
+        if (offload_io(fd, count, n, write_f, buf, count))
+        {
+            return n;
+        }
+        if (uring_io(fd, SO_SNDTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_SEND;
+            sqe.addr = (uint64_t)buf;
+            sqe.len = std::min<size_t>(count, UINT32_MAX); },
+                     n))
+        {
+            return n;
+        }
         return do_io(fd, write_f, "write", HPS::IOManager::WRITE, SO_SNDTIMEO, buf, count);
     }
 
+    ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset)
+    {
+        ssize_t n = 0;
+        if (offload_io(fd, count, n, pwrite_f, buf, count, offset))
+        {
+            return n;
+        }
+        return pwrite_f(fd, buf, count, offset);
+    }
+
+    int fsync(int fd)
+    {
+        //! 刷盘与数据量无关, 总是卸载
+        ssize_t n = 0;
+        if (offload_io(fd, SIZE_MAX, n, fsync_f))
+        {
+            return n;
+        }
+        return fsync_f(fd);
+    }
+
+    ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+    {
+        return do_io(out_fd, sendfile_f, "sendfile", HPS::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+    }
+
+    ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags)
+    {
+        HPS::IOManager *iom = hook_iom();
+        if (!iom || (flags & SPLICE_F_NONBLOCK))
+        {
+            return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+        }
+        HPS::FdCtx::ptr in = HPS::FdMgr::GetInstance()->get(fd_in);
+        HPS::FdCtx::ptr out = HPS::FdMgr::GetInstance()->get(fd_out);
+        bool wait_in = in && in->isPollable() && !in->isClose();
+        bool wait_out = out && out->isPollable() && !out->isClose();
+        if ((!wait_in && !wait_out) || (wait_in && in->getUserNonblock()) || (wait_out && out->getUserNonblock()))
+        {
+            return splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+        }
+        uint64_t to = std::min(wait_in ? in->getTimeout(SO_RCVTIMEO) : (uint64_t)-1,
+                               wait_out ? out->getTimeout(SO_SNDTIMEO) : (uint64_t)-1);
+        while (true)
+        {
+            ssize_t n = splice_f(fd_in, off_in, fd_out, off_out, len, flags);
+            if (n >= 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                return n;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            //! 不知道哪一端未就绪, 只等待当前未就绪的一端
+            pollfd fds[2];
+            nfds_t nfds = 0;
+            if (wait_in)
+            {
+                fds[nfds].fd = fd_in;
+                fds[nfds].events = POLLIN;
+                fds[nfds++].revents = 0;
+            }
+            if (wait_out)
+            {
+                fds[nfds].fd = fd_out;
+                fds[nfds].events = POLLOUT;
+                fds[nfds++].revents = 0;
+            }
+            poll_f(fds, nfds, 0);
+            nfds_t pending = 0;
+            for (nfds_t i = 0; i < nfds; ++i)
+            {
+                if (!fds[i].revents)
+                {
+                    fds[pending++] = fds[i];
+                }
+            }
+            int rt = hook_poll(iom, fds, pending ? pending : nfds, to == (uint64_t)-1 ? -1 : (int)to);
+            if (rt == 0)
+            {
+                errno = ETIMEDOUT;
+                return -1;
+            }
+            if (rt < 0)
+            {
+                return -1;
+            }
+        }
+    }
+
     ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
     {
+        ssize_t n = 0;
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = (iovec *)iov;
+        msg.msg_iovlen = iovcnt;
+        if (uring_io(fd, SO_SNDTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_SENDMSG;
+            sqe.addr = (uint64_t)&msg; },
+                     n))
+        {
+            return n;
+        }
         return do_io(fd, writev_f, "writev", HPS::IOManager::WRITE, SO_SNDTIMEO, iov, iovcnt);
     }
 
     ssize_t send(int s, const void *msg, size_t len, int flags)
     {
+        ssize_t n = 0;
+        if (uring_io(s, SO_SNDTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_SEND;
+            sqe.addr = (uint64_t)msg;
+            sqe.len = std::min<size_t>(len, UINT32_MAX);
+            sqe.msg_flags = flags; },
+                     n))
+        {
+            return n;
+        }
         return do_io(s, send_f, "send", HPS::IOManager::WRITE, SO_SNDTIMEO, msg, len, flags);
     }
 
@@ -415,6 +1220,16 @@ extern "C"
 
     ssize_t sendmsg(int s, const struct msghdr *msg, int flags)
     {
+        ssize_t n = 0;
+        if (uring_io(s, SO_SNDTIMEO, 0, [&](io_uring_sqe &sqe)
+                     {
+            sqe.opcode = IORING_OP_SENDMSG;
+            sqe.addr = (uint64_t)msg;
+            sqe.msg_flags = flags; },
+                     n))
+        {
+            return n;
+        }
         return do_io(s, sendmsg_f, "sendmsg", HPS::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
     }
 
@@ -425,16 +1240,7 @@ extern "C"
             return close_f(fd);
         }
 
-        HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd);
-        if (ctx)
-        {
-            auto iom = HPS::IOManager::GetThis();
-            if (iom)
-            {
-                iom->cancelAll(fd);
-            }
-            HPS::FdMgr::GetInstance()->del(fd);
-        }
+        forget_fd(fd);
         return close_f(fd);
     }
 
@@ -449,7 +1255,7 @@ extern "C"
             int arg = va_arg(va, int);
             va_end(va);
             HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd);
-            if (!ctx || ctx->isClose() || !ctx->isSocket())
+            if (!ctx || ctx->isClose() || !ctx->isPollable())
             {
                 return fcntl_f(fd, cmd, arg);
             }
@@ -470,7 +1276,7 @@ extern "C"
             va_end(va);
             int arg = fcntl_f(fd, cmd);
             HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(fd);
-            if (!ctx || ctx->isClose() || !ctx->isSocket())
+            if (!ctx || ctx->isClose() || !ctx->isPollable())
             {
                 return arg;
             }
@@ -486,6 +1292,17 @@ extern "C"
         break;
         case F_DUPFD:
         case F_DUPFD_CLOEXEC:
+        {
+            int arg = va_arg(va, int);
+            va_end(va);
+            int newfd = fcntl_f(fd, cmd, arg);
+            if (newfd >= 0 && HPS::t_hook_enable)
+            {
+                register_dup_fd(fd, newfd);
+            }
+            return newfd;
+        }
+        break;
         case F_SETFD:
         case F_SETOWN:
         case F_SETSIG:
@@ -546,7 +1363,7 @@ extern "C"
         {
             bool user_nonblock = !!*(int *)arg;
             HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(d);
-            if (!ctx || ctx->isClose() || !ctx->isSocket())
+            if (!ctx || ctx->isClose() || !ctx->isPollable())
             {
                 return ioctl_f(d, request, arg);
             }
@@ -2,7 +2,11 @@
 #define __HOOK_H__
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <stdint.h>
@@ -19,6 +23,10 @@ namespace HPS
      * @brief 设置当前线程的hook状态
      */
     void set_hook_enable(bool flag);
+    /**
+     * @brief 当前线程hook的IO函数实际发起的读写系统调用次数
+     */
+    uint64_t get_hook_io_count();
 }
 
 extern "C"
@@ -34,6 +42,9 @@ extern "C"
     typedef int (*nanosleep_fun)(const struct timespec *req, struct timespec *rem);
     extern nanosleep_fun nanosleep_f;
 
+    typedef int (*clock_nanosleep_fun)(clockid_t clockid, int flags, const struct timespec *request, struct timespec *remain);
+    extern clock_nanosleep_fun clock_nanosleep_f;
+
     // socket
     typedef int (*socket_fun)(int domain, int type, int protocol);
     extern socket_fun socket_f;
@@ -44,6 +55,44 @@ extern "C"
     typedef int (*accept_fun)(int s, struct sockaddr *addr, socklen_t *addrlen);
     extern accept_fun accept_f;
 
+    typedef int (*accept4_fun)(int s, struct sockaddr *addr, socklen_t *addrlen, int flags);
+    extern accept4_fun accept4_f;
+
+    typedef int (*socketpair_fun)(int domain, int type, int protocol, int sv[2]);
+    extern socketpair_fun socketpair_f;
+
+    // fd
+    typedef int (*pipe_fun)(int pipefd[2]);
+    extern pipe_fun pipe_f;
+
+    typedef int (*pipe2_fun)(int pipefd[2], int flags);
+    extern pipe2_fun pipe2_f;
+
+    typedef int (*eventfd_fun)(unsigned int initval, int flags);
+    extern eventfd_fun eventfd_f;
+
+    typedef int (*dup_fun)(int oldfd);
+    extern dup_fun dup_f;
+
+    typedef int (*dup2_fun)(int oldfd, int newfd);
+    extern dup2_fun dup2_f;
+
+    typedef int (*dup3_fun)(int oldfd, int newfd, int flags);
+    extern dup3_fun dup3_f;
+
+    // poll
+    typedef int (*poll_fun)(struct pollfd *fds, nfds_t nfds, int timeout);
+    extern poll_fun poll_f;
+
+    typedef int (*ppoll_fun)(struct pollfd *fds, nfds_t nfds, const struct timespec *tmo_p, const sigset_t *sigmask);
+    extern ppoll_fun ppoll_f;
+
+    typedef int (*select_fun)(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+    extern select_fun select_f;
+
+    typedef int (*epoll_wait_fun)(int epfd, struct epoll_event *events, int maxevents, int timeout);
+    extern epoll_wait_fun epoll_wait_f;
+
     // read
     typedef ssize_t (*read_fun)(int fd, void *buf, size_t count);
     extern read_fun read_f;
@@ -51,6 +100,12 @@ extern "C"
     typedef ssize_t (*readv_fun)(int fd, const struct iovec *iov, int iovcnt);
     extern readv_fun readv_f;
 
+    typedef ssize_t (*pread_fun)(int fd, void *buf, size_t count, off_t offset);
+    extern pread_fun pread_f;
+
+    typedef ssize_t (*preadv2_fun)(int fd, const struct iovec *iov, int iovcnt, off_t offset, int flags);
+    extern preadv2_fun preadv2_f;
+
     typedef ssize_t (*recv_fun)(int sockfd, void *buf, size_t len, int flags);
     extern recv_fun recv_f;
 
@@ -67,6 +122,18 @@ extern "C"
     typedef ssize_t (*writev_fun)(int fd, const struct iovec *iov, int iovcnt);
     extern writev_fun writev_f;
 
+    typedef ssize_t (*pwrite_fun)(int fd, const void *buf, size_t count, off_t offset);
+    extern pwrite_fun pwrite_f;
+
+    typedef int (*fsync_fun)(int fd);
+    extern fsync_fun fsync_f;
+
+    typedef ssize_t (*sendfile_fun)(int out_fd, int in_fd, off_t *offset, size_t count);
+    extern sendfile_fun sendfile_f;
+
+    typedef ssize_t (*splice_fun)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned int flags);
+    extern splice_fun splice_f;
+
     typedef ssize_t (*send_fun)(int s, const void *msg, size_t len, int flags);
     extern send_fun send_f;
 
@@ -496,5 +496,31 @@ HttpResult::ptr HttpConnectionPool::doRequest(HttpRequest::ptr req
     return std::make_shared<HttpResult>((int)HttpResult::Error::OK, rsp, "ok");
 }
 
+Future<HttpResult::ptr> HttpConnectionPool::asyncGet(const std::string& url
+                                        , uint64_t timeout_ms
+                                        , const std::map<std::string, std::string>& headers
+                                        , const std::string& body) {
+    return asyncRequest(HttpMethod::GET, url, timeout_ms, headers, body);
+}
+
+Future<HttpResult::ptr> HttpConnectionPool::asyncRequest(HttpMethod method
+                                        , const std::string& url
+                                        , uint64_t timeout_ms
+                                        , const std::map<std::string, std::string>& headers
+                                        , const std::string& body) {
+    HttpConnectionPool::ptr self = shared_from_this();
+    return Async(Scheduler::GetThis(), [self, method, url, timeout_ms, headers, body]() {
+        return self->doRequest(method, url, timeout_ms, headers, body);
+    });
+}
+
+Future<HttpResult::ptr> HttpConnectionPool::asyncRequest(HttpRequest::ptr req
+                                        , uint64_t timeout_ms) {
+    HttpConnectionPool::ptr self = shared_from_this();
+    return Async(Scheduler::GetThis(), [self, req, timeout_ms]() {
+        return self->doRequest(req, timeout_ms);
+    });
+}
+
 }
 }
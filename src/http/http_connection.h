@@ -5,6 +5,7 @@
 #include "http.h"
 #include "../uri.h"
 #include "../thread.h"
+#include "../future.h"
 
 #include <list>
 
@@ -177,7 +178,7 @@ namespace HPS
             uint64_t m_request = 0;
         };
 
-        class HttpConnectionPool
+        class HttpConnectionPool : public std::enable_shared_from_this<HttpConnectionPool>
         {
         public:
             typedef std::shared_ptr<HttpConnectionPool> ptr;
@@ -259,6 +260,27 @@ namespace HPS
              */
             HttpResult::ptr doRequest(HttpRequest::ptr req, uint64_t timeout_ms);
 
+            /**
+             * @brief 在当前调度器的新协程中发送HTTP的GET请求
+             * @details 多个请求并发进行, 可用WhenAll/WhenAny组合; 请求协程持有连接池, 连接池存活到请求完成
+             * @return 请求结果
+             */
+            Future<HttpResult::ptr> asyncGet(const std::string &url, uint64_t timeout_ms, const std::map<std::string, std::string> &headers = {}, const std::string &body = "");
+
+            /**
+             * @brief 在当前调度器的新协程中发送HTTP请求
+             * @details 请求协程持有连接池, 连接池存活到请求完成
+             * @return 请求结果
+             */
+            Future<HttpResult::ptr> asyncRequest(HttpMethod method, const std::string &url, uint64_t timeout_ms, const std::map<std::string, std::string> &headers = {}, const std::string &body = "");
+
+            /**
+             * @brief 在当前调度器的新协程中发送HTTP请求
+             * @details 请求协程持有连接池, 连接池存活到请求完成
+             * @return 请求结果
+             */
+            Future<HttpResult::ptr> asyncRequest(HttpRequest::ptr req, uint64_t timeout_ms);
+
         private:
             static void ReleasePtr(HttpConnection *ptr, HttpConnectionPool *pool);
 
@@ -0,0 +1,224 @@
+#ifndef __INLINE_FUNCTION_H__
+#define __INLINE_FUNCTION_H__
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace HPS
+{
+
+    /**
+     * @brief 只可移动的void()可调用对象
+     * @details 不超过N字节且移动不抛异常的可调用对象直接存放在对象内部, 不分配内存,
+     *          更大的对象才在堆上分配; std::function本身也可内联存放.
+     *          移动时只搬运存储, 不会增减其中智能指针的引用计数
+     */
+    template <size_t N>
+    class InlineFunction
+    {
+    public:
+        /// 内联存储的大小
+        static const size_t INLINE_SIZE = N;
+
+        /**
+         * @brief 构造空对象
+         */
+        InlineFunction() {}
+
+        /**
+         * @brief 构造空对象
+         */
+        InlineFunction(std::nullptr_t) {}
+
+        /**
+         * @brief 从可调用对象构造, 空的std::function或空函数指针得到空对象
+         */
+        template <class F, class = typename std::enable_if<
+                               !std::is_same<typename std::decay<F>::type, InlineFunction>::value &&
+                               !std::is_same<typename std::decay<F>::type, std::nullptr_t>::value>::type>
+        InlineFunction(F &&f)
+        {
+            assign(std::forward<F>(f));
+        }
+
+        InlineFunction(InlineFunction &&other) noexcept
+        {
+            moveFrom(other);
+        }
+
+        InlineFunction &operator=(InlineFunction &&other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+                moveFrom(other);
+            }
+            return *this;
+        }
+
+        InlineFunction &operator=(std::nullptr_t)
+        {
+            reset();
+            return *this;
+        }
+
+        InlineFunction(const InlineFunction &) = delete;
+        InlineFunction &operator=(const InlineFunction &) = delete;
+
+        ~InlineFunction()
+        {
+            reset();
+        }
+
+        /**
+         * @brief 调用
+         * @pre 非空
+         */
+        void operator()()
+        {
+            m_ops->invoke(&m_storage);
+        }
+
+        /**
+         * @brief 是否非空
+         */
+        explicit operator bool() const { return m_ops != nullptr; }
+
+        /**
+         * @brief 可调用对象是否内联存放
+         */
+        bool isInline() const { return m_ops && m_ops->inlined; }
+
+        /**
+         * @brief 析构可调用对象, 置为空
+         */
+        void reset()
+        {
+            if (m_ops)
+            {
+                m_ops->destroy(&m_storage);
+                m_ops = nullptr;
+            }
+        }
+
+    private:
+        /**
+         * @brief 可调用对象的操作表
+         */
+        struct Ops
+        {
+            void (*invoke)(void *storage);
+            void (*move)(void *dst, void *src);
+            void (*destroy)(void *storage);
+            bool inlined;
+        };
+
+        /**
+         * @brief 内联存放的可调用对象的操作
+         */
+        template <class T>
+        struct InlineOps
+        {
+            static void invoke(void *storage) { (*static_cast<T *>(storage))(); }
+            static void move(void *dst, void *src)
+            {
+                new (dst) T(std::move(*static_cast<T *>(src)));
+                static_cast<T *>(src)->~T();
+            }
+            static void destroy(void *storage) { static_cast<T *>(storage)->~T(); }
+            static const Ops s_ops;
+        };
+
+        /**
+         * @brief 堆上存放的可调用对象的操作, 存储中只保存指针
+         */
+        template <class T>
+        struct HeapOps
+        {
+            static void invoke(void *storage) { (**static_cast<T **>(storage))(); }
+            static void move(void *dst, void *src) { *static_cast<T **>(dst) = *static_cast<T **>(src); }
+            static void destroy(void *storage) { delete *static_cast<T **>(storage); }
+            static const Ops s_ops;
+        };
+
+        static bool IsEmpty(const std::function<void()> &f) { return !f; }
+        template <class T>
+        static bool IsEmpty(T *f) { return !f; }
+        template <class T>
+        static bool IsEmpty(const T &) { return false; }
+
+        /**
+         * @brief 类型T能否内联存放
+         */
+        template <class T>
+        struct Fits : std::integral_constant<bool, sizeof(T) <= N && alignof(T) <= alignof(std::max_align_t) &&
+                                                       std::is_nothrow_move_constructible<T>::value>
+        {
+        };
+
+        template <class F>
+        void assign(F &&f)
+        {
+            typedef typename std::decay<F>::type T;
+            if (IsEmpty(f))
+            {
+                return;
+            }
+            //! 编译期分派, 放不下的类型不会实例化内联存放的placement new
+            construct<T>(std::forward<F>(f), Fits<T>());
+        }
+
+        template <class T, class F>
+        void construct(F &&f, std::true_type)
+        {
+            new (&m_storage) T(std::forward<F>(f));
+            m_ops = &InlineOps<T>::s_ops;
+        }
+
+        template <class T, class F>
+        void construct(F &&f, std::false_type)
+        {
+            *reinterpret_cast<T **>(&m_storage) = new T(std::forward<F>(f));
+            m_ops = &HeapOps<T>::s_ops;
+        }
+
+        void moveFrom(InlineFunction &other)
+        {
+            if (other.m_ops)
+            {
+                other.m_ops->move(&m_storage, &other.m_storage);
+                m_ops = other.m_ops;
+                other.m_ops = nullptr;
+            }
+        }
+
+    private:
+        typedef typename std::aligned_storage<N, alignof(std::max_align_t)>::type Storage;
+        /// 可调用对象的存储
+        Storage m_storage;
+        /// 操作表, 为空表示空对象
+        const Ops *m_ops = nullptr;
+    };
+
+    template <size_t N>
+    template <class T>
+    const typename InlineFunction<N>::Ops InlineFunction<N>::InlineOps<T>::s_ops = {
+        &InlineFunction<N>::InlineOps<T>::invoke,
+        &InlineFunction<N>::InlineOps<T>::move,
+        &InlineFunction<N>::InlineOps<T>::destroy,
+        true};
+
+    template <size_t N>
+    template <class T>
+    const typename InlineFunction<N>::Ops InlineFunction<N>::HeapOps<T>::s_ops = {
+        &InlineFunction<N>::HeapOps<T>::invoke,
+        &InlineFunction<N>::HeapOps<T>::move,
+        &InlineFunction<N>::HeapOps<T>::destroy,
+        false};
+
+}
+
+#endif
@@ -1,10 +1,16 @@
 #include "iomanager.h"
 #include "macro.h"
 #include "log.h"
+#include "config.h"
+#include "util.h"
+#include "hook.h"
+#include "fd_manager.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -14,6 +20,59 @@ namespace HPS
 
     static HPS::Logger::ptr g_logger = LOG_NAME("system");
 
+    static ConfigVar<std::string>::ptr g_iomanager_backend =
+        Config::Lookup<std::string>("iomanager.backend", "epoll", "iomanager io backend: epoll or io_uring");
+
+    static ConfigVar<uint32_t>::ptr g_iomanager_uring_entries =
+        Config::Lookup<uint32_t>("iomanager.uring_entries", 4096, "iomanager io_uring submission queue size");
+
+    static ConfigVar<bool>::ptr g_iomanager_persistent_epoll =
+        Config::Lookup<bool>("iomanager.persistent_epoll", false, "iomanager register sockets once with EPOLLET and latch readiness");
+
+    static ConfigVar<uint32_t>::ptr g_iomanager_busy_poll_us =
+        Config::Lookup<uint32_t>("iomanager.busy_poll_us", 0, "iomanager max busy-poll microseconds before blocking in epoll_wait, 0 disables");
+
+    static ConfigVar<bool>::ptr g_iomanager_hires_wait =
+        Config::Lookup<bool>("iomanager.hires_wait", true, "iomanager wait with epoll_pwait2 so sub-millisecond timers are not rounded up");
+
+    //! 内核不支持epoll_pwait2时置为false, 之后只用epoll_wait
+    static std::atomic<bool> s_pwait2_supported = {true};
+
+    /**
+     * @brief 以微秒为单位等待epoll事件
+     * @details 等待时间有不足1毫秒的部分时用epoll_pwait2精确等待;
+     *          不可用时退回epoll_wait并向上取整到毫秒, 定时器晚于而不是早于到期时间唤醒, 避免空转
+     */
+    static int EpollWaitUs(int epfd, epoll_event *events, int max_events, uint64_t timeout_us, bool hires)
+    {
+#ifdef SYS_epoll_pwait2
+        if (hires && timeout_us % 1000 && s_pwait2_supported.load(std::memory_order_relaxed))
+        {
+            struct timespec ts;
+            ts.tv_sec = timeout_us / (1000 * 1000);
+            ts.tv_nsec = timeout_us % (1000 * 1000) * 1000;
+            int rt = syscall(SYS_epoll_pwait2, epfd, events, max_events, &ts, nullptr, 0);
+            if (rt >= 0 || errno != ENOSYS)
+            {
+                return rt;
+            }
+            s_pwait2_supported = false;
+        }
+#endif
+        return epoll_wait_f(epfd, events, max_events, (int)((timeout_us + 999) / 1000));
+    }
+
+    /**
+     * @brief 等待io_uring操作完成的协程, 位于协程栈上, 地址作为user_data
+     */
+    struct UringWait
+    {
+        /// 等待的协程
+        Fiber::ptr fiber;
+        /// 操作结果
+        int res = 0;
+    };
+
     enum EpollCtlOp
     {
     };
@@ -87,6 +146,7 @@ namespace HPS
         ctx.scheduler = nullptr;
         ctx.fiber.reset();
         ctx.cb = nullptr;
+        ctx.priority = PRIORITY_NORMAL;
     }
 
     void IOManager::contextResize(size_t size)
@@ -120,22 +180,30 @@ namespace HPS
         }
 
         Event new_events = (Event)(fd_ctx->events & ~event);
-        int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = EPOLLET | new_events;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        //! 持久注册模式下句柄一直留在epoll中
+        if (!m_persistent)
         {
-            LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-                                << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-                                << rt << " (" << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = EPOLLET | new_events;
+            epevent.data.ptr = fd_ctx;
+
+            int epfd = reactorOf(fd_ctx).epfd;
+            ++m_epollCtlCount;
+            int rt = epoll_ctl(epfd, op, fd, &epevent);
+            if (rt)
+            {
+                LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                                    << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+                                    << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
 
         --m_pendingEventCount;
         fd_ctx->events = new_events;
+        //! 共享注册的等待者失去了注册, 唤醒后由其自行重新登记
+        fd_ctx->triggerWatchers(event);
         FdContext::EventContext &event_ctx = fd_ctx->getContext(event);
         fd_ctx->resetContext(event_ctx);
         return true;
@@ -158,25 +226,45 @@ namespace HPS
         }
 
         Event new_events = (Event)(fd_ctx->events & ~event);
-        int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = EPOLLET | new_events;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        //! 持久注册模式下句柄一直留在epoll中
+        if (!m_persistent)
         {
-            LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-                                << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-                                << rt << " (" << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = EPOLLET | new_events;
+            epevent.data.ptr = fd_ctx;
+
+            int epfd = reactorOf(fd_ctx).epfd;
+            ++m_epollCtlCount;
+            int rt = epoll_ctl(epfd, op, fd, &epevent);
+            if (rt)
+            {
+                LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                                    << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+                                    << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
 
-        fd_ctx->triggerEvent(event);
+        fd_ctx->triggerEvent(event, nullptr, isMultiReactor());
         --m_pendingEventCount;
         return true;
     }
 
+    bool IOManager::hasEvent(int fd, Event event)
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((int)m_fdContexts.size() <= fd)
+        {
+            return false;
+        }
+        FdContext *fd_ctx = m_fdContexts[fd];
+        lock.unlock();
+
+        FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        return fd_ctx->events & event;
+    }
+
     bool IOManager::cancelAll(int fd)
     {
         RWMutexType::ReadLock lock(m_mutex);
@@ -193,28 +281,33 @@ namespace HPS
             return false;
         }
 
-        int op = EPOLL_CTL_DEL;
-        epoll_event epevent;
-        epevent.events = 0;
-        epevent.data.ptr = fd_ctx;
-
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
-        if (rt)
+        if (!m_persistent)
         {
-            LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
-                                << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
-                                << rt << " (" << errno << ") (" << strerror(errno) << ")";
-            return false;
+            int op = EPOLL_CTL_DEL;
+            epoll_event epevent;
+            epevent.events = 0;
+            epevent.data.ptr = fd_ctx;
+
+            int epfd = reactorOf(fd_ctx).epfd;
+            ++m_epollCtlCount;
+            int rt = epoll_ctl(epfd, op, fd, &epevent);
+            if (rt)
+            {
+                LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
+                                    << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
+                                    << rt << " (" << errno << ") (" << strerror(errno) << ")";
+                return false;
+            }
         }
 
         if (fd_ctx->events & READ)
         {
-            fd_ctx->triggerEvent(READ);
+            fd_ctx->triggerEvent(READ, nullptr, isMultiReactor());
             --m_pendingEventCount;
         }
         if (fd_ctx->events & WRITE)
         {
-            fd_ctx->triggerEvent(WRITE);
+            fd_ctx->triggerEvent(WRITE, nullptr, isMultiReactor());
             --m_pendingEventCount;
         }
 
@@ -222,24 +315,123 @@ namespace HPS
         return true;
     }
 
+    void IOManager::delFd(int fd)
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((int)m_fdContexts.size() <= fd)
+        {
+            return;
+        }
+        FdContext *fd_ctx = m_fdContexts[fd];
+        lock.unlock();
+
+        FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        fd_ctx->registered = false;
+        fd_ctx->ready = NONE;
+        fd_ctx->reactor = -1;
+    }
+
+    IOManager::Reactor &IOManager::reactorOf(FdContext *fd_ctx)
+    {
+        if (fd_ctx->reactor < 0)
+        {
+            //! 线程池外的线程使用第一个reactor
+            int slot = isMultiReactor() ? slotOf(HPS::GetThreadId()) : 0;
+            fd_ctx->reactor = slot < 0 ? 0 : slot;
+        }
+        return *m_reactors[fd_ctx->reactor];
+    }
+
+    void IOManager::triggerReady(FdContext *fd_ctx, int real_events, TaskBatch &batch)
+    {
+        bool pin = isMultiReactor();
+        int thread = HPS::GetThreadId();
+        if (real_events & READ)
+        {
+            ++m_fdWakeups;
+            if (fd_ctx->read.thread != thread)
+            {
+                ++m_crossThreadWakeups;
+            }
+            fd_ctx->triggerEvent(READ, &batch, pin);
+            --m_pendingEventCount;
+        }
+        if (real_events & WRITE)
+        {
+            ++m_fdWakeups;
+            if (fd_ctx->write.thread != thread)
+            {
+                ++m_crossThreadWakeups;
+            }
+            fd_ctx->triggerEvent(WRITE, &batch, pin);
+            --m_pendingEventCount;
+        }
+    }
+
     IOManager *IOManager::GetThis()
     {
         return dynamic_cast<IOManager *>(Scheduler::GetThis());
     }
 
+    void IOManager::wakeReactor(Reactor &reactor, bool force)
+    {
+        if (TickleEventFd(reactor.tickleFd, reactor.tickled, force))
+        {
+            ++m_tickleCount;
+        }
+    }
+
     void IOManager::tickle()
     {
         if (!hasIdleThreads())
         {
             return;
         }
-        int rt = write(m_tickleFds[1], "T", 1);
-        ASSERT(rt == 1);
+        if (!isMultiReactor())
+        {
+            wakeReactor(*m_reactors[0]);
+            return;
+        }
+        //! 多reactor: 只唤醒一个阻塞在epoll_wait中的线程, 认领后其他通知不再选中它
+        size_t n = m_reactors.size();
+        size_t start = m_tickleIndex++;
+        for (size_t i = 0; i < n; ++i)
+        {
+            Reactor &reactor = *m_reactors[(start + i) % n];
+            if (reactor.idle.exchange(false))
+            {
+                wakeReactor(reactor);
+                return;
+            }
+        }
+    }
+
+    void IOManager::tickleThread(int thread)
+    {
+        if (!isMultiReactor())
+        {
+            tickle();
+            return;
+        }
+        //! 本线程返回调度循环后自然会取到任务
+        if (thread == HPS::GetThreadId())
+        {
+            return;
+        }
+        int slot = slotOf(thread);
+        if (slot < 0)
+        {
+            tickle();
+            return;
+        }
+        //! 目标线程可能正要进入epoll_wait, 不能依据idle标志跳过
+        m_reactors[slot]->idle = false;
+        wakeReactor(*m_reactors[slot]);
     }
 
     bool IOManager::stopping(uint64_t &timeout)
     {
-        timeout = getNextTimer();
+        timeout = getNextTimerUs();
         return timeout == ~0ull && m_pendingEventCount == 0 && Scheduler::stopping();
     }
 
@@ -254,31 +446,198 @@ namespace HPS
         tickle();
     }
 
+    bool IOManager::uringSubmit(const io_uring_sqe &sqe, uint64_t timeout_ms, int &res)
+    {
+        if (!m_uring)
+        {
+            return false;
+        }
+        UringWait wait;
+        wait.fiber = Fiber::GetThis();
+        io_uring_sqe sqes[2];
+        sqes[0] = sqe;
+        sqes[0].user_data = (uint64_t)&wait;
+        unsigned count = 1;
+        //! 内核在提交时复制超时时间, 超时操作自身的完成事件user_data为0, 收割时忽略
+        __kernel_timespec ts;
+        if (timeout_ms != ~0ull)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000;
+            sqes[0].flags |= IOSQE_IO_LINK;
+            memset(&sqes[1], 0, sizeof(sqes[1]));
+            sqes[1].opcode = IORING_OP_LINK_TIMEOUT;
+            sqes[1].fd = -1;
+            sqes[1].addr = (uint64_t)&ts;
+            sqes[1].len = 1;
+            count = 2;
+        }
+        //! 本线程进入idle时才统一提交, 一次io_uring_enter提交同一轮调度中的所有操作
+        ++m_pendingEventCount;
+        if (!m_uring->submit(sqes, count))
+        {
+            --m_pendingEventCount;
+            return false;
+        }
+        Fiber::YieldToHold();
+        res = wait.res;
+        return true;
+    }
+
+    void IOManager::uringCancel(int fd)
+    {
+        if (!m_uring)
+        {
+            return;
+        }
+        io_uring_sqe sqe;
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = fd;
+        sqe.cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        m_uring->submit(&sqe, 1, true);
+    }
+
+    void IOManager::reapUring(TaskBatch &batch)
+    {
+        io_uring_cqe cqes[64];
+        unsigned n = 0;
+        while ((n = m_uring->reap(cqes, 64)) > 0)
+        {
+            for (unsigned i = 0; i < n; ++i)
+            {
+                UringWait *wait = (UringWait *)cqes[i].user_data;
+                if (!wait)
+                {
+                    continue;
+                }
+                //! 加入batch后协程可能立即恢复, 之后不能再访问wait
+                wait->res = cqes[i].res;
+                --m_pendingEventCount;
+                //! io_uring操作只来自hook, 与epoll路径一致沿用协程的优先级
+                batch.add(wait->fiber, (Priority)wait->fiber->getPriority());
+            }
+        }
+    }
+
+    IOManager::WakeupStats IOManager::getWakeupStats() const
+    {
+        WakeupStats stats;
+        stats.fd_wakeups = m_fdWakeups;
+        stats.cross_thread_wakeups = m_crossThreadWakeups;
+        return stats;
+    }
+
+    IOManager::IdleStats IOManager::getIdleStats() const
+    {
+        IdleStats stats;
+        stats.spin_us = m_spinUs;
+        stats.blocked_us = m_blockedUs;
+        stats.spin_hits = m_spinHits;
+        stats.spin_misses = m_spinMisses;
+        return stats;
+    }
+
+    int IOManager::busyPoll(Reactor &reactor, epoll_event *events, int max_events, uint64_t spin_us, bool &found)
+    {
+        uint64_t begin = GetCurrentUS();
+        int rt = 0;
+        while (true)
+        {
+            if (m_uring)
+            {
+                m_uring->flush();
+            }
+            ++m_epollWaitCount;
+            rt = epoll_wait_f(reactor.epfd, events, max_events, 0);
+            if (rt > 0)
+            {
+                ++m_spinHits;
+                break;
+            }
+            if (hasReadyTasks())
+            {
+                found = true;
+                ++m_spinHits;
+                break;
+            }
+            if (GetCurrentUS() - begin >= spin_us)
+            {
+                ++m_spinMisses;
+                break;
+            }
+        }
+        m_spinUs += GetCurrentUS() - begin;
+        return rt > 0 ? rt : 0;
+    }
+
+    IOManager::SyscallStats IOManager::getSyscallStats() const
+    {
+        SyscallStats stats;
+        stats.epoll_wait = m_epollWaitCount;
+        stats.epoll_ctl = m_epollCtlCount;
+        stats.uring_enter = m_uring ? m_uring->getEnterCount() : 0;
+        stats.tickle = m_tickleCount;
+        return stats;
+    }
+
 }
 
 namespace HPS
 {
     //# 1) 创建协程调度器
-    IOManager::IOManager(size_t threads, bool use_mainThread, const std::string &name)
-        : Scheduler(threads, use_mainThread, name)
-    {
-        //! 创建epoll实例
-        m_epfd = epoll_create(5000);
-        ASSERT(m_epfd > 0);
-        //! 创建读写管道，作用???
-        int rt = pipe(m_tickleFds);
-        ASSERT(!rt);
-        //! 向读管道添加epoll读事件，边缘触发
-        epoll_event event;
-        memset(&event, 0, sizeof(epoll_event));
-        event.events = EPOLLIN | EPOLLET;
-        event.data.fd = m_tickleFds[0];
-        //! 设置(F_SETFL)读管道为非阻塞(O_NONBLOCK)
-        rt = fcntl(m_tickleFds[0], F_SETFL, O_NONBLOCK);
-        ASSERT(!rt);
-        //! 向epoll实例添加epoll事件
-        rt = epoll_ctl(m_epfd, EPOLL_CTL_ADD, m_tickleFds[0], &event);
-        ASSERT(!rt);
+    IOManager::IOManager(size_t threads, bool use_mainThread, const std::string &name, bool multi_reactor,
+                         const std::string &cpus)
+        : Scheduler(threads, use_mainThread, name, cpus)
+    {
+        //! threads为0时由CPU放置决定线程数量
+        threads = m_threadIds.size() + m_threadCount;
+        m_persistent = g_iomanager_persistent_epoll->getValue();
+        m_busyPollUs = g_iomanager_busy_poll_us->getValue();
+        m_hiresWait = g_iomanager_hires_wait->getValue();
+        //! 多reactor模式下每个线程(含主线程)一个epoll实例, 下标与线程池下标一致
+        size_t count = multi_reactor ? threads : 1;
+        m_reactors.resize(count);
+        for (auto &reactor : m_reactors)
+        {
+            reactor.reset(new Reactor);
+            //! 创建epoll实例
+            reactor->epfd = epoll_create(5000);
+            ASSERT(reactor->epfd > 0);
+            //! 创建非阻塞的eventfd，用于唤醒阻塞在epoll_wait中的线程
+            reactor->tickleFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            ASSERT(reactor->tickleFd >= 0);
+            //! 向epoll实例添加eventfd读事件，边缘触发
+            epoll_event event;
+            memset(&event, 0, sizeof(epoll_event));
+            event.events = EPOLLIN | EPOLLET;
+            event.data.fd = reactor->tickleFd;
+            int rt = epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, reactor->tickleFd, &event);
+            ASSERT(!rt);
+        }
+        //! io_uring后端: 完成队列有事件时io_uring句柄可读, 由空闲线程收割
+        if (g_iomanager_backend->getValue() == "io_uring")
+        {
+            m_uring.reset(new IoUring);
+            if (m_uring->init(g_iomanager_uring_entries->getValue()))
+            {
+                //! 多reactor时每个epoll实例都关注io_uring句柄, 每次只唤醒其中一个
+                epoll_event event;
+                memset(&event, 0, sizeof(epoll_event));
+                event.events = EPOLLIN | EPOLLET | (count > 1 ? EPOLLEXCLUSIVE : 0);
+                event.data.fd = m_uring->getFd();
+                for (auto &reactor : m_reactors)
+                {
+                    int rt = epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, m_uring->getFd(), &event);
+                    ASSERT(!rt);
+                }
+            }
+            else
+            {
+                LOG_WARN(g_logger) << "io_uring unavailable, iomanager " << name << " falls back to epoll";
+                m_uring.reset();
+            }
+        }
         //! 设定socket事件集合容量
         contextResize(32);
         //! 启动协程调度器
@@ -294,6 +653,11 @@ namespace HPS
         epoll_event *events = new epoll_event[MAX_EVNETS]();
         std::shared_ptr<epoll_event> shared_events(events, [](epoll_event *ptr)
                                                    { delete[] ptr; });
+        //! 当前线程的reactor
+        int slot = isMultiReactor() ? slotOf(HPS::GetThreadId()) : 0;
+        Reactor &reactor = *m_reactors[slot < 0 ? 0 : slot];
+        //! 进入idle到等到事件或任务的平均间隔(微秒), 初始时按最长时间轮询
+        uint64_t gap_avg = m_busyPollUs;
 
         while (true)
         {
@@ -303,44 +667,90 @@ namespace HPS
             {
                 LOG_INFO(g_logger) << "name =" << getName()
                                    << " idle stopping exit";
+                //! 共享epoll时停止的多次通知被合并, 依次唤醒下一个线程退出
+                if (!isMultiReactor())
+                {
+                    wakeReactor(reactor, true);
+                }
                 break;
             }
 
             int rt = 0;
-            do
+            bool found = false;
+            uint64_t idle_begin = GetCurrentUS();
+            //! 平均间隔短于最长轮询时间时才轮询, 轮询时长取平均间隔的两倍
+            if (m_busyPollUs && gap_avg <= m_busyPollUs && next_timeout != 0)
             {
-                //! epoll_wait最长等待时间，超过此事件epoll_wait不再等待，继续执行后继代码
-                static const int MAX_TIMEOUT = 3000;
+                uint64_t spin = std::min<uint64_t>(m_busyPollUs, gap_avg * 2 + 1);
                 if (next_timeout != ~0ull)
                 {
-                    next_timeout = (int)next_timeout > MAX_TIMEOUT
-                                       ? MAX_TIMEOUT
-                                       : next_timeout;
+                    spin = std::min<uint64_t>(spin, next_timeout);
                 }
-                else
+                rt = busyPoll(reactor, events, MAX_EVNETS, spin, found);
+            }
+            while (rt == 0 && !found)
+            {
+                //! epoll_wait最长等待时间(微秒)，超过此事件epoll_wait不再等待，继续执行后继代码
+                static const uint64_t MAX_TIMEOUT = 3000 * 1000;
+                if (next_timeout > MAX_TIMEOUT)
                 {
                     next_timeout = MAX_TIMEOUT;
                 }
-                rt = epoll_wait(m_epfd, events, MAX_EVNETS, (int)next_timeout);
+                if (m_uring)
+                {
+                    m_uring->flush();
+                }
+                reactor.idle = true;
+                //! 多reactor时tickle()只通知idle为true的reactor: 调度循环检查队列之后,
+                //! 设置idle之前入队的任务不会通知本线程, 设置后必须再检查一次
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (isMultiReactor() && hasReadyTasks())
+                {
+                    reactor.idle = false;
+                    found = true;
+                    break;
+                }
+                ++m_epollWaitCount;
+                uint64_t block_begin = GetCurrentUS();
+                //! 调用原始的epoll_wait/epoll_pwait2, hook的版本会挂起空闲协程
+                rt = EpollWaitUs(reactor.epfd, events, MAX_EVNETS, next_timeout, m_hiresWait);
+                reactor.idle = false;
+                m_blockedUs += GetCurrentUS() - block_begin;
                 if (rt < 0 && errno == EINTR)
                 {
+                    rt = 0;
                 }
                 else
                 {
                     break;
                 }
-            } while (true);
+            }
+            if (m_busyPollUs)
+            {
+                gap_avg = (gap_avg * 7 + GetCurrentUS() - idle_begin) / 8;
+            }
 
+            //! 本轮就绪的协程和到期的定时器回调汇总后一次发布
+            TaskBatch batch(this);
             //! 获取需要执行的定时器的回调函数列表
             std::vector<std::function<void()>> cbs;
-            listExpiredCb(cbs);
+            std::vector<std::function<void()>> nonblocking_cbs;
+            listExpiredCb(cbs, &nonblocking_cbs);
             //! 执行定时器管理器
             if (!cbs.empty())
             {
                 // LOG_DEBUG(g_logger) << "on timer cbs.size=" << cbs.size();
-                schedule(cbs.begin(), cbs.end());
+                for (auto &cb : cbs)
+                {
+                    batch.add(cb);
+                }
                 cbs.clear();
             }
+            //! 非阻塞的定时器回调在调度协程上直接执行, 不创建任务协程
+            for (auto &cb : nonblocking_cbs)
+            {
+                batch.addNonBlocking(cb);
+            }
 
             // if(UNLIKELY(rt == MAX_EVNETS)) {
             //     LOG_INFO(g_logger) << "epoll wait events=" << rt;
@@ -349,11 +759,14 @@ namespace HPS
             for (int i = 0; i < rt; ++i)
             {
                 epoll_event &event = events[i];
-                if (event.data.fd == m_tickleFds[0])
+                if (event.data.fd == reactor.tickleFd)
                 {
-                    uint8_t dummy[256];
-                    while (read(m_tickleFds[0], dummy, sizeof(dummy)) > 0)
-                        ;
+                    ClearEventFd(reactor.tickleFd, reactor.tickled);
+                    continue;
+                }
+                if (m_uring && event.data.fd == m_uring->getFd())
+                {
+                    reapUring(batch);
                     continue;
                 }
                 //! 提取epoll事件以及socket文件句柄上的读写事件
@@ -361,7 +774,8 @@ namespace HPS
                 FdContext::MutexType::Lock lock(fd_ctx->mutex);
                 if (event.events & (EPOLLERR | EPOLLHUP))
                 {
-                    event.events |= (EPOLLIN | EPOLLOUT) & fd_ctx->events;
+                    //! 持久注册模式下同时记录为读写就绪
+                    event.events |= (EPOLLIN | EPOLLOUT) & (m_persistent ? ~0u : (uint32_t)fd_ctx->events);
                 }
                 int real_events = NONE;
                 if (event.events & EPOLLIN)
@@ -373,6 +787,14 @@ namespace HPS
                     real_events |= WRITE;
                 }
 
+                //! 持久注册模式: 无人等待的就绪事件记录下来, 不修改epoll注册
+                if (m_persistent)
+                {
+                    fd_ctx->ready = (Event)(fd_ctx->ready | (real_events & ~fd_ctx->events));
+                    triggerReady(fd_ctx, real_events & fd_ctx->events, batch);
+                    continue;
+                }
+
                 if ((fd_ctx->events & real_events) == NONE)
                 {
                     continue;
@@ -382,10 +804,11 @@ namespace HPS
                 int op = left_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
                 event.events = EPOLLET | left_events;
 
-                int rt2 = epoll_ctl(m_epfd, op, fd_ctx->fd, &event);
+                ++m_epollCtlCount;
+                int rt2 = epoll_ctl(reactor.epfd, op, fd_ctx->fd, &event);
                 if (rt2)
                 {
-                    LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+                    LOG_ERROR(g_logger) << "epoll_ctl(" << reactor.epfd << ", "
                                         << (EpollCtlOp)op << ", " << fd_ctx->fd << ", " << (EPOLL_EVENTS)event.events << "):"
                                         << rt2 << " (" << errno << ") (" << strerror(errno) << ")";
                     continue;
@@ -393,17 +816,9 @@ namespace HPS
                 //! 触发socket句柄上的读写事件
                 // LOG_INFO(g_logger) << " fd=" << fd_ctx->fd << " events=" << fd_ctx->events
                 //                          << " real_events=" << real_events;
-                if (real_events & READ)
-                {
-                    fd_ctx->triggerEvent(READ);
-                    --m_pendingEventCount;
-                }
-                if (real_events & WRITE)
-                {
-                    fd_ctx->triggerEvent(WRITE);
-                    --m_pendingEventCount;
-                }
+                triggerReady(fd_ctx, real_events, batch);
             }
+            submit(batch);
 
             Fiber::ptr cur = Fiber::GetThis();
             auto raw_ptr = cur.get();
@@ -413,7 +828,7 @@ namespace HPS
         }
     }
     //! 触发事件
-    void IOManager::FdContext::triggerEvent(IOManager::Event event)
+    void IOManager::FdContext::triggerEvent(IOManager::Event event, TaskBatch *batch, bool pin)
     {
         // LOG_INFO(g_logger) << "fd=" << fd
         //     << " triggerEvent event=" << event
@@ -424,22 +839,73 @@ namespace HPS
         // }
         events = (Event)(events & ~event);
         EventContext &ctx = getContext(event);
-        if (ctx.cb)
+        int thread = ctx.thread;
+        ctx.thread = -1;
+        Priority priority = ctx.priority;
+        ctx.priority = PRIORITY_NORMAL;
+        //! 多reactor模式: 回到等待事件的线程, 与句柄所属的reactor保持一致
+        if (pin && thread != -1)
         {
-            ctx.scheduler->schedule(&ctx.cb);
+            if (ctx.cb)
+            {
+                ctx.scheduler->schedule(&ctx.cb, thread, priority);
+            }
+            else
+            {
+                ctx.scheduler->schedule(&ctx.fiber, thread, priority);
+            }
+        }
+        else if (batch && batch->getScheduler() == ctx.scheduler)
+        {
+            if (ctx.cb)
+            {
+                batch->add(ctx.cb, priority);
+            }
+            else
+            {
+                batch->add(ctx.fiber, priority);
+            }
+        }
+        else if (ctx.cb)
+        {
+            ctx.scheduler->schedule(&ctx.cb, -1, priority);
         }
         else
         {
-            ctx.scheduler->schedule(&ctx.fiber);
+            //! 单个协程唤醒同样走无锁唤醒队列
+            TaskBatch wake(ctx.scheduler);
+            wake.add(ctx.fiber, priority);
         }
         ctx.scheduler = nullptr;
-        return;
+        triggerWatchers(event, batch);
+    }
+
+    void IOManager::FdContext::triggerWatchers(IOManager::Event event, TaskBatch *batch)
+    {
+        EventContext &ctx = getContext(event);
+        if (ctx.watchers.empty())
+        {
+            return;
+        }
+        std::vector<Watcher> watchers;
+        watchers.swap(ctx.watchers);
+        for (auto &w : watchers)
+        {
+            if (batch && batch->getScheduler() == w.scheduler)
+            {
+                batch->add(w.cb);
+            }
+            else
+            {
+                w.scheduler->schedule(&w.cb);
+            }
+        }
     }
 
     //# 3) 添加IO任务，建立TCP连接，创建socket事件上下文
 
     //# 4) 向socket上下文添加IO事件上下文
-    int IOManager::addEvent(int fd, Event event, std::function<void()> cb)
+    IOManager::FdContext *IOManager::getFdContext(int fd)
     {
         //! 扩充socket事件句柄集合容量
         FdContext *fd_ctx = nullptr;
@@ -456,7 +922,62 @@ namespace HPS
             contextResize(fd * 1.5);
             fd_ctx = m_fdContexts[fd];
         }
+        return fd_ctx;
+    }
+
+    int IOManager::addEvent(int fd, Event event, std::function<void()> cb, bool inherit_priority)
+    {
+        FdContext *fd_ctx = getFdContext(fd);
+        Priority priority = inherit_priority ? (Priority)Fiber::GetThis()->getPriority() : PRIORITY_NORMAL;
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        return addEventLocked(fd_ctx, event, cb, priority);
+    }
+
+    int IOManager::watchEvent(int fd, Event event, std::function<void()> cb, uint64_t &watcher)
+    {
+        FdContext *fd_ctx = getFdContext(fd);
+        FdContext::MutexType::Lock lock(fd_ctx->mutex);
+        //! 已有等待者时共享其注册, 随事件一起唤醒
+        if (fd_ctx->events & event)
+        {
+            FdContext::Watcher w;
+            w.id = ++m_watcherId;
+            w.scheduler = Scheduler::GetThis();
+            w.cb.swap(cb);
+            watcher = w.id;
+            fd_ctx->getContext(event).watchers.push_back(std::move(w));
+            return 0;
+        }
+        watcher = 0;
+        return addEventLocked(fd_ctx, event, cb, PRIORITY_NORMAL);
+    }
+
+    bool IOManager::delWatcher(int fd, Event event, uint64_t watcher)
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        if ((int)m_fdContexts.size() <= fd)
+        {
+            return false;
+        }
+        FdContext *fd_ctx = m_fdContexts[fd];
+        lock.unlock();
+
         FdContext::MutexType::Lock lock2(fd_ctx->mutex);
+        auto &watchers = fd_ctx->getContext(event).watchers;
+        for (auto it = watchers.begin(); it != watchers.end(); ++it)
+        {
+            if (it->id == watcher)
+            {
+                watchers.erase(it);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int IOManager::addEventLocked(FdContext *fd_ctx, Event event, std::function<void()> &cb, Priority priority)
+    {
+        int fd = fd_ctx->fd;
         if (UNLIKELY(fd_ctx->events & event))
         {
             LOG_ERROR(g_logger) << "addEvent assert fd=" << fd
@@ -464,16 +985,62 @@ namespace HPS
                                 << " fd_ctx.event=" << (EPOLL_EVENTS)fd_ctx->events;
             ASSERT(!(fd_ctx->events & event));
         }
-        //! 向epoll实例添加epoll读写事件
-        int op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+        //! 持久注册模式: 事件已就绪则直接消费, 否则仅首次等待时注册一次
+        int op = EPOLL_CTL_ADD;
         epoll_event epevent;
-        epevent.events = EPOLLET | fd_ctx->events | event;
+        if (m_persistent)
+        {
+            if (fd_ctx->ready & event)
+            {
+                fd_ctx->ready = (Event)(fd_ctx->ready & ~event);
+                if (!cb)
+                {
+                    return 1;
+                }
+                Scheduler::GetThis()->schedule(&cb, -1, priority);
+                return 0;
+            }
+            epevent.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        }
+        else
+        {
+            //! 向epoll实例添加epoll读写事件
+            op = fd_ctx->events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            epevent.events = EPOLLET | fd_ctx->events | event;
+        }
         epevent.data.ptr = fd_ctx;
 
-        int rt = epoll_ctl(m_epfd, op, fd, &epevent);
+        int rt = 0;
+        int epfd = reactorOf(fd_ctx).epfd;
+        if (!m_persistent || !fd_ctx->registered)
+        {
+            ++m_epollCtlCount;
+            rt = epoll_ctl(epfd, op, fd, &epevent);
+            //! delFd清除了标记但句柄没有真正关闭(同一个打开的文件)时, 原注册仍在epoll中
+            if (rt && m_persistent && errno == EEXIST)
+            {
+                rt = 0;
+            }
+            fd_ctx->registered = m_persistent && !rt;
+        }
+        else if (!FdMgr::GetInstance()->get(fd))
+        {
+            //! hook创建的句柄登记时会清除旧标记; 未经hook登记的句柄可能在hook之外关闭后
+            //! 被同号的新句柄复用, 旧注册已随关闭失效, 以MOD校验, 不存在时重新ADD
+            op = EPOLL_CTL_MOD;
+            ++m_epollCtlCount;
+            rt = epoll_ctl(epfd, op, fd, &epevent);
+            if (rt && errno == ENOENT)
+            {
+                op = EPOLL_CTL_ADD;
+                ++m_epollCtlCount;
+                rt = epoll_ctl(epfd, op, fd, &epevent);
+            }
+            fd_ctx->registered = !rt;
+        }
         if (rt)
         {
-            LOG_ERROR(g_logger) << "epoll_ctl(" << m_epfd << ", "
+            LOG_ERROR(g_logger) << "epoll_ctl(" << epfd << ", "
                                 << (EpollCtlOp)op << ", " << fd << ", " << (EPOLL_EVENTS)epevent.events << "):"
                                 << rt << " (" << errno << ") (" << strerror(errno) << ") fd_ctx->events="
                                 << (EPOLL_EVENTS)fd_ctx->events;
@@ -487,6 +1054,8 @@ namespace HPS
         ASSERT(!event_ctx.scheduler && !event_ctx.fiber && !event_ctx.cb);
 
         event_ctx.scheduler = Scheduler::GetThis();
+        event_ctx.thread = HPS::GetThreadId();
+        event_ctx.priority = priority;
         if (cb)
         {
             event_ctx.cb.swap(cb);
@@ -503,9 +1072,12 @@ namespace HPS
     IOManager::~IOManager()
     {
         stop();
-        close(m_epfd);
-        close(m_tickleFds[0]);
-        close(m_tickleFds[1]);
+        m_uring.reset();
+        for (auto &reactor : m_reactors)
+        {
+            close(reactor->epfd);
+            close(reactor->tickleFd);
+        }
 
         for (size_t i = 0; i < m_fdContexts.size(); ++i)
         {
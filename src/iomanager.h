@@ -3,12 +3,23 @@
 
 #include "scheduler.h"
 #include "timer.h"
+#include "uring.h"
+
+#include <sys/epoll.h>
 
 namespace HPS
 {
 
     /**
      * @brief 基于Epoll的IO协程调度器
+     * @details 配置iomanager.backend为io_uring时, 构造时额外创建io_uring实例:
+     *          hook的socket读写直接提交操作本身, 完成时唤醒协程;
+     *          内核不支持时退回epoll. io_uring的完成通知仍通过epoll等待;
+     *          配置iomanager.persistent_epoll时, socket首次等待时以EPOLLIN|EPOLLOUT|EPOLLET
+     *          注册一次, 之后的就绪状态记录在句柄上下文中, 稳态下不再调用epoll_ctl;
+     *          多reactor模式下每个线程拥有独立的epoll实例和通知管道, 句柄注册到首次等待它的线程,
+     *          等待的协程被唤醒时回到该线程执行;
+     *          配置iomanager.busy_poll_us后, 阻塞前先忙轮询一段时间, 轮询时长随任务到达间隔自适应
      */
     class IOManager : public Scheduler, public TimerManager
     {
@@ -36,6 +47,19 @@ namespace HPS
         struct FdContext
         {
             typedef Mutex MutexType;
+            /**
+             * @brief 共享同一事件注册的等待者
+             */
+            struct Watcher
+            {
+                /// 等待者id
+                uint64_t id = 0;
+                /// 回调执行的调度器
+                Scheduler *scheduler = nullptr;
+                /// 事件触发或删除时调度的回调函数
+                std::function<void()> cb;
+            };
+
             /**
              * @brief 事件上下文类
              */
@@ -47,6 +71,12 @@ namespace HPS
                 Fiber::ptr fiber;
                 /// 事件的回调函数
                 std::function<void()> cb;
+                /// 等待事件的线程id
+                int thread = -1;
+                /// 事件唤醒的优先级
+                Priority priority = PRIORITY_NORMAL;
+                /// 共享该事件注册的其他等待者(如hook的poll)
+                std::vector<Watcher> watchers;
             };
 
             /**
@@ -65,8 +95,17 @@ namespace HPS
             /**
              * @brief 触发事件
              * @param[in] event 事件类型
+             * @param[in] batch 批量唤醒任务,为空或调度器不同时直接调度
+             * @param[in] pin 是否回到等待事件的线程执行
+             */
+            void triggerEvent(Event event, TaskBatch *batch = nullptr, bool pin = false);
+
+            /**
+             * @brief 调度并清空事件的共享等待者
+             * @param[in] event 事件类型
+             * @param[in] batch 批量唤醒任务,为空或调度器不同时直接调度
              */
-            void triggerEvent(Event event);
+            void triggerWatchers(Event event, TaskBatch *batch = nullptr);
 
             /// 读事件上下文
             EventContext read;
@@ -76,18 +115,83 @@ namespace HPS
             int fd = 0;
             /// 当前的事件
             Event events = NONE;
+            /// 持久注册模式: 已就绪但无人等待的事件
+            Event ready = NONE;
+            /// 持久注册模式: 是否已注册到epoll
+            bool registered = false;
+            /// 句柄所属的reactor下标, -1表示尚未分配
+            int reactor = -1;
             /// 事件的Mutex
             MutexType mutex;
         };
 
+        /**
+         * @brief 每个线程的epoll实例(单reactor模式下所有线程共享一个)
+         */
+        struct Reactor
+        {
+            /// epoll 文件句柄
+            int epfd = -1;
+            /// 通知用的eventfd
+            int tickleFd = -1;
+            /// 是否有未取走的通知
+            std::atomic<bool> tickled = {false};
+            /// 是否阻塞在epoll_wait中
+            std::atomic<bool> idle = {false};
+        };
+
     public:
+        /**
+         * @brief IO事件唤醒统计
+         */
+        struct WakeupStats
+        {
+            /// IO事件唤醒的等待者数量
+            uint64_t fd_wakeups = 0;
+            /// 由其他线程的epoll_wait唤醒的数量
+            uint64_t cross_thread_wakeups = 0;
+        };
+
+        /**
+         * @brief 空闲线程忙轮询统计
+         */
+        struct IdleStats
+        {
+            /// 忙轮询的时间(微秒)
+            uint64_t spin_us = 0;
+            /// 阻塞在epoll_wait中的时间(微秒)
+            uint64_t blocked_us = 0;
+            /// 忙轮询期间等到事件或任务的次数
+            uint64_t spin_hits = 0;
+            /// 忙轮询超时转入阻塞的次数
+            uint64_t spin_misses = 0;
+        };
+
+        /**
+         * @brief 系统调用统计
+         */
+        struct SyscallStats
+        {
+            /// epoll_wait调用次数
+            uint64_t epoll_wait = 0;
+            /// epoll_ctl调用次数
+            uint64_t epoll_ctl = 0;
+            /// io_uring_enter调用次数
+            uint64_t uring_enter = 0;
+            /// 通知空闲线程写eventfd的次数
+            uint64_t tickle = 0;
+        };
+
         /**
          * @brief 构造函数
-         * @param[in] threads 线程数量
+         * @param[in] threads 线程数量, 为0时每个放置CPU一个线程
          * @param[in] use_mainThread 是否将调用线程包含进去
          * @param[in] name 调度器的名称
+         * @param[in] multi_reactor 是否每个线程使用独立的epoll实例
+         * @param[in] cpus 线程池线程的CPU放置, 见Scheduler::Scheduler
          */
-        IOManager(size_t threads = 1, bool use_mainThread = true, const std::string &name = "");
+        IOManager(size_t threads = 1, bool use_mainThread = true, const std::string &name = "",
+                  bool multi_reactor = false, const std::string &cpus = "");
 
         /**
          * @brief 析构函数
@@ -99,9 +203,31 @@ namespace HPS
          * @param[in] fd socket句柄
          * @param[in] event 事件类型
          * @param[in] cb 事件回调函数
-         * @return 添加成功返回0,失败返回-1
+         * @param[in] inherit_priority 事件唤醒是否沿用当前协程的优先级, 否则按普通优先级调度
+         * @return 添加成功返回0,失败返回-1;
+         *         持久注册模式下事件已就绪时: 有回调则直接调度回调并返回0, 否则返回1, 当前协程无需等待
+         */
+        int addEvent(int fd, Event event, std::function<void()> cb = nullptr, bool inherit_priority = false);
+
+        /**
+         * @brief 等待事件, 事件已被其他等待者登记时共享其注册
+         * @details 共享时cb在事件触发, 取消或删除时与登记者一并调度, 不修改epoll注册;
+         *          事件未登记时与addEvent相同
+         * @param[in] fd socket句柄
+         * @param[in] event 事件类型
+         * @param[in] cb 事件回调函数
+         * @param[out] watcher 共享等待者id, 0表示按addEvent登记(用delEvent撤销)
+         * @return 同addEvent
+         */
+        int watchEvent(int fd, Event event, std::function<void()> cb, uint64_t &watcher);
+
+        /**
+         * @brief 撤销共享等待者, 不调度其回调
+         * @param[in] fd socket句柄
+         * @param[in] event 事件类型
+         * @param[in] watcher watchEvent返回的等待者id
          */
-        int addEvent(int fd, Event event, std::function<void()> cb = nullptr);
+        bool delWatcher(int fd, Event event, uint64_t watcher);
 
         /**
          * @brief 删除事件
@@ -119,12 +245,70 @@ namespace HPS
          */
         bool cancelEvent(int fd, Event event);
 
+        /**
+         * @brief 是否已有等待中的事件
+         * @param[in] fd socket句柄
+         * @param[in] event 事件类型
+         */
+        bool hasEvent(int fd, Event event);
+
         /**
          * @brief 取消所有事件
          * @param[in] fd socket句柄
          */
         bool cancelAll(int fd);
 
+        /**
+         * @brief 句柄关闭时清除持久注册状态和所属的reactor
+         * @details 关闭句柄时内核自动将其移出epoll, 这里只重置上下文, 不调用epoll_ctl
+         * @param[in] fd socket句柄
+         */
+        void delFd(int fd);
+
+        /**
+         * @brief 是否使用持久注册的epoll
+         */
+        bool isPersistent() const { return m_persistent; }
+
+        /**
+         * @brief 是否每个线程使用独立的epoll实例
+         */
+        bool isMultiReactor() const { return m_reactors.size() > 1; }
+
+        /**
+         * @brief 是否使用io_uring后端
+         */
+        bool hasUring() const { return (bool)m_uring; }
+
+        /**
+         * @brief 通过io_uring提交一个操作, 挂起当前协程直到操作完成
+         * @param[in] sqe 已填好的操作, user_data由本函数设置
+         * @param[in] timeout_ms 超时时间(毫秒), ~0ull不超时; 超时通过链接的超时操作实现
+         * @param[out] res 操作结果(cqe.res), 超时时为-ECANCELED
+         * @return 未能提交时返回false, 调用者应退回epoll方式
+         */
+        bool uringSubmit(const io_uring_sqe &sqe, uint64_t timeout_ms, int &res);
+
+        /**
+         * @brief 取消句柄上所有进行中的io_uring操作
+         */
+        void uringCancel(int fd);
+
+        /**
+         * @brief 返回系统调用统计
+         */
+        SyscallStats getSyscallStats() const;
+
+        /**
+         * @brief 返回IO事件唤醒统计
+         */
+        WakeupStats getWakeupStats() const;
+
+        /**
+         * @brief 返回空闲线程忙轮询统计
+         */
+        IdleStats getIdleStats() const;
+
         /**
          * @brief 返回当前的IOManager
          */
@@ -132,6 +316,7 @@ namespace HPS
 
     protected:
         void tickle() override;
+        void tickleThread(int thread) override;
         bool stopping() override;
         void idle() override;
         void onTimerInsertedAtFront() override;
@@ -142,24 +327,96 @@ namespace HPS
          */
         void contextResize(size_t size);
 
+        /**
+         * @brief 返回句柄的事件上下文, 容量不足时扩充
+         */
+        FdContext *getFdContext(int fd);
+
+        /**
+         * @brief 添加事件
+         * @pre 持有fd_ctx->mutex
+         * @param[in, out] cb 事件回调函数, 登记后被移走
+         * @return 同addEvent
+         */
+        int addEventLocked(FdContext *fd_ctx, Event event, std::function<void()> &cb, Priority priority);
+
+        /**
+         * @brief 返回句柄所属的reactor, 尚未分配时分配给当前线程
+         * @pre 持有fd_ctx->mutex
+         */
+        Reactor &reactorOf(FdContext *fd_ctx);
+
+        /**
+         * @brief 唤醒句柄上就绪事件的等待者
+         * @pre 持有fd_ctx->mutex
+         */
+        void triggerReady(FdContext *fd_ctx, int real_events, TaskBatch &batch);
+
+        /**
+         * @brief 阻塞前的忙轮询: 反复检查调度队列并以0超时调用epoll_wait
+         * @param[in] spin_us 最长轮询时间(微秒)
+         * @param[out] found 调度队列中是否出现任务
+         * @return 就绪的事件数量
+         */
+        int busyPoll(Reactor &reactor, epoll_event *events, int max_events, uint64_t spin_us, bool &found);
+
+        /**
+         * @brief 唤醒一个reactor, 未取走的通知存在时不再写eventfd
+         * @param[in] force 忽略未取走的通知强制写入
+         */
+        void wakeReactor(Reactor &reactor, bool force = false);
+
+        /**
+         * @brief 收割io_uring的完成事件, 唤醒等待的协程
+         */
+        void reapUring(TaskBatch &batch);
+
         /**
          * @brief 判断是否可以停止
-         * @param[out] timeout 最近要出发的定时器事件间隔
+         * @param[out] timeout 最近要出发的定时器事件间隔(微秒)
          * @return 返回是否可以停止
          */
         bool stopping(uint64_t &timeout);
 
     private:
-        /// epoll 文件句柄
-        int m_epfd = 0;
-        /// pipe 文件句柄
-        int m_tickleFds[2];
+        /// reactor数组, 单reactor模式下只有一个
+        std::vector<std::unique_ptr<Reactor>> m_reactors;
+        /// 下一次通知的reactor
+        std::atomic<size_t> m_tickleIndex = {0};
         /// 当前等待执行的事件数量
         std::atomic<size_t> m_pendingEventCount = {0};
+        /// 共享等待者id生成
+        std::atomic<uint64_t> m_watcherId = {0};
         /// IOManager的Mutex
         RWMutexType m_mutex;
         /// socket事件上下文的容器
         std::vector<FdContext *> m_fdContexts;
+        /// 是否持久注册socket(iomanager.persistent_epoll)
+        bool m_persistent = false;
+        /// 最长忙轮询时间(iomanager.busy_poll_us), 0不轮询
+        uint64_t m_busyPollUs = 0;
+        /// 是否用epoll_pwait2精确等待不足1毫秒的定时器(iomanager.hires_wait)
+        bool m_hiresWait = true;
+        /// io_uring后端, 未启用时为空
+        std::unique_ptr<IoUring> m_uring;
+        /// epoll_wait调用次数
+        std::atomic<uint64_t> m_epollWaitCount = {0};
+        /// epoll_ctl调用次数
+        std::atomic<uint64_t> m_epollCtlCount = {0};
+        /// 写eventfd次数
+        std::atomic<uint64_t> m_tickleCount = {0};
+        /// IO事件唤醒的等待者数量
+        std::atomic<uint64_t> m_fdWakeups = {0};
+        /// 由其他线程唤醒的等待者数量
+        std::atomic<uint64_t> m_crossThreadWakeups = {0};
+        /// 忙轮询时间(微秒)
+        std::atomic<uint64_t> m_spinUs = {0};
+        /// 阻塞时间(微秒)
+        std::atomic<uint64_t> m_blockedUs = {0};
+        /// 忙轮询命中次数
+        std::atomic<uint64_t> m_spinHits = {0};
+        /// 忙轮询超时次数
+        std::atomic<uint64_t> m_spinMisses = {0};
     };
 
 }
@@ -0,0 +1,117 @@
+#ifndef __MPSC_QUEUE_H__
+#define __MPSC_QUEUE_H__
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace HPS
+{
+
+    /**
+     * @brief 无锁队列的侵入式节点
+     * @details 需要入队的对象继承该节点,入队出队不做任何内存分配
+     */
+    struct MpscNode
+    {
+        /// 下一个节点
+        std::atomic<MpscNode *> next = {nullptr};
+        /// 节点类型,同一队列存放不同类型对象时由使用者区分
+        uint32_t tag = 0;
+    };
+
+    /**
+     * @brief 侵入式多生产者单消费者无锁队列(Vyukov)
+     * @details 生产者只做一次原子交换,支持将预先链接好的一串节点一次发布;
+     *          消费者只能有一个,多线程消费时需由使用者保证互斥
+     */
+    class MpscQueue : Noncopyable
+    {
+    public:
+        /**
+         * @brief 构造函数
+         */
+        MpscQueue()
+            : m_head(&m_stub), m_tail(&m_stub)
+        {
+        }
+
+        /**
+         * @brief 入队一个节点(多生产者安全)
+         */
+        void push(MpscNode *node)
+        {
+            pushChain(node, node);
+        }
+
+        /**
+         * @brief 将first到last已链接好的一串节点一次发布(多生产者安全)
+         * @param[in] first 第一个节点
+         * @param[in] last 最后一个节点, 从first沿next可达
+         */
+        void pushChain(MpscNode *first, MpscNode *last)
+        {
+            last->next.store(nullptr, std::memory_order_relaxed);
+            MpscNode *prev = m_head.exchange(last, std::memory_order_acq_rel);
+            prev->next.store(first, std::memory_order_release);
+        }
+
+        /**
+         * @brief 出队一个节点(仅限单消费者)
+         * @return 队列为空或生产者正在发布时返回nullptr
+         */
+        MpscNode *pop()
+        {
+            MpscNode *tail = m_tail;
+            MpscNode *next = tail->next.load(std::memory_order_acquire);
+            if (tail == &m_stub)
+            {
+                if (!next)
+                {
+                    return nullptr;
+                }
+                m_tail = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next)
+            {
+                m_tail = next;
+                return tail;
+            }
+            //! tail不是最后一个节点,说明有生产者尚未完成链接
+            if (tail != m_head.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+            push(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next)
+            {
+                m_tail = next;
+                return tail;
+            }
+            return nullptr;
+        }
+
+        /**
+         * @brief 队列是否为空(仅限消费者调用)
+         */
+        bool empty() const
+        {
+            return m_tail == &m_stub && !m_stub.next.load(std::memory_order_acquire);
+        }
+
+    private:
+        /// 哨兵节点
+        MpscNode m_stub;
+        /// 生产者端(最后入队的节点)
+        std::atomic<MpscNode *> m_head;
+        /// 消费者端
+        MpscNode *m_tail;
+    };
+
+}
+
+#endif
@@ -1,6 +1,6 @@
 #include "mutex.h"
 #include "macro.h"
-// #include "scheduler.h"
+#include "scheduler.h"
 
 namespace HPS
 {
@@ -34,58 +34,250 @@ namespace HPS
         }
     }
 
-    // FiberSemaphore::FiberSemaphore(size_t initial_concurrency)
-    //     : m_concurrency(initial_concurrency)
-    // {
-    // }
-
-    // FiberSemaphore::~FiberSemaphore()
-    // {
-    //     // ASSERT(m_waiters.empty());
-    // }
-
-    // bool FiberSemaphore::tryWait()
-    // {
-    //     ASSERT(Scheduler::GetThis());
-    //     {
-    //         MutexType::Lock lock(m_mutex);
-    //         if (m_concurrency > 0u)
-    //         {
-    //             --m_concurrency;
-    //             return true;
-    //         }
-    //         return false;
-    //     }
-    // }
-
-    // void FiberSemaphore::wait()
-    // {
-    //     ASSERT(Scheduler::GetThis());
-    //     {
-    //         MutexType::Lock lock(m_mutex);
-    //         if (m_concurrency > 0u)
-    //         {
-    //             --m_concurrency;
-    //             return;
-    //         }
-    //         m_waiters.push_back(std::make_pair(Scheduler::GetThis(), Fiber::GetThis()));
-    //     }
-    //     Fiber::YieldToHold();
-    // }
-
-    // void FiberSemaphore::notify()
-    // {
-    //     MutexType::Lock lock(m_mutex);
-    //     if (!m_waiters.empty())
-    //     {
-    //         auto next = m_waiters.front();
-    //         m_waiters.pop_front();
-    //         next.first->schedule(next.second);
-    //     }
-    //     else
-    //     {
-    //         ++m_concurrency;
-    //     }
-    // }
+    FiberWaitQueue::FiberWaitQueue()
+        : m_permits(0)
+    {
+    }
+
+    FiberWaitQueue::~FiberWaitQueue()
+    {
+        ASSERT(m_waiters.empty());
+    }
+
+    void FiberWaitQueue::wait(FiberMutex *mutex)
+    {
+        ASSERT2(Scheduler::GetThis(), "fiber wait outside scheduler");
+        Fiber::ptr self = Fiber::GetThis();
+        ASSERT2(self.get() != Scheduler::GetMainFiber(), "scheduler fiber must not wait");
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_permits > 0)
+            {
+                --m_permits;
+                lock.unlock();
+                if (mutex)
+                {
+                    mutex->unlock();
+                }
+                return;
+            }
+            m_waiters.push_back(std::make_pair(Scheduler::GetThis(), self));
+            Scheduler::GetThis()->addParkedFiber();
+        }
+        if (mutex)
+        {
+            mutex->unlock();
+        }
+        //! 唤醒可能先于挂起被调度, 调度器跳过仍在执行的协程直到它切出
+        self.reset();
+        Fiber::YieldToHold();
+    }
+
+    /**
+     * @brief 将等待者放回其调度器, 沿用协程的优先级
+     */
+    static void WakeWaiter(std::pair<Scheduler *, Fiber::ptr> &waiter)
+    {
+        Scheduler::Priority priority = (Scheduler::Priority)waiter.second->getPriority();
+        waiter.first->schedule(std::move(waiter.second), -1, priority);
+        //! 重新调度之后再注销, 调度器不会在两者之间停止
+        waiter.first->delParkedFiber();
+    }
+
+    bool FiberWaitQueue::notify(bool keep)
+    {
+        std::pair<Scheduler *, Fiber::ptr> waiter;
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_waiters.empty())
+            {
+                if (keep)
+                {
+                    ++m_permits;
+                }
+                return false;
+            }
+            waiter = std::move(m_waiters.front());
+            m_waiters.pop_front();
+        }
+        WakeWaiter(waiter);
+        return true;
+    }
+
+    size_t FiberWaitQueue::notifyAll()
+    {
+        std::list<std::pair<Scheduler *, Fiber::ptr>> waiters;
+        {
+            MutexType::Lock lock(m_mutex);
+            waiters.swap(m_waiters);
+        }
+        for (auto &i : waiters)
+        {
+            WakeWaiter(i);
+        }
+        return waiters.size();
+    }
+
+    FiberMutex::FiberMutex()
+        : m_state(0)
+    {
+    }
+
+    void FiberMutex::lock()
+    {
+        if (m_state.fetch_add(1, std::memory_order_acquire) == 0)
+        {
+            return;
+        }
+        //! 被唤醒时锁已移交给当前协程
+        m_waiters.wait();
+    }
+
+    bool FiberMutex::tryLock()
+    {
+        int32_t expected = 0;
+        return m_state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+    void FiberMutex::unlock()
+    {
+        if (m_state.fetch_sub(1, std::memory_order_release) == 1)
+        {
+            return;
+        }
+        //! 等待者可能尚未挂起, 留下许可让它直接取得锁
+        m_waiters.notify(true);
+    }
+
+    FiberSemaphore::FiberSemaphore(size_t initial_concurrency)
+        : m_count(initial_concurrency)
+    {
+    }
+
+    bool FiberSemaphore::tryWait()
+    {
+        int64_t v = m_count.load(std::memory_order_relaxed);
+        while (v > 0)
+        {
+            if (m_count.compare_exchange_weak(v, v - 1, std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void FiberSemaphore::wait()
+    {
+        if (m_count.fetch_sub(1, std::memory_order_acquire) > 0)
+        {
+            return;
+        }
+        m_waiters.wait();
+    }
+
+    void FiberSemaphore::notify()
+    {
+        if (m_count.fetch_add(1, std::memory_order_release) >= 0)
+        {
+            return;
+        }
+        m_waiters.notify(true);
+    }
+
+    void FiberCondition::wait(FiberMutex &mutex)
+    {
+        m_waiters.wait(&mutex);
+        mutex.lock();
+    }
+
+    void FiberCondition::notify()
+    {
+        m_waiters.notify(false);
+    }
+
+    void FiberCondition::notifyAll()
+    {
+        m_waiters.notifyAll();
+    }
+
+    FiberRWMutex::FiberRWMutex()
+        : m_readers(0), m_writer(false), m_readWaiting(0), m_writeWaiting(0)
+    {
+    }
+
+    void FiberRWMutex::rdlock()
+    {
+        {
+            MutexType::Lock lock(m_mutex);
+            if (!m_writer && m_writeWaiting == 0)
+            {
+                ++m_readers;
+                return;
+            }
+            ++m_readWaiting;
+        }
+        //! 被唤醒时已计入读者
+        m_readWaiters.wait();
+    }
+
+    void FiberRWMutex::wrlock()
+    {
+        {
+            MutexType::Lock lock(m_mutex);
+            if (!m_writer && m_readers == 0)
+            {
+                m_writer = true;
+                return;
+            }
+            ++m_writeWaiting;
+        }
+        //! 被唤醒时已持有写锁
+        m_writeWaiters.wait();
+    }
+
+    void FiberRWMutex::unlock()
+    {
+        uint32_t readers = 0;
+        bool writer = false;
+        {
+            MutexType::Lock lock(m_mutex);
+            bool was_writer = m_writer;
+            if (m_writer)
+            {
+                m_writer = false;
+            }
+            else
+            {
+                ASSERT(m_readers > 0);
+                --m_readers;
+            }
+            if (m_readers > 0)
+            {
+                return;
+            }
+            //! 写锁释放时优先放行等待的读者, 最后一个读者释放时放行一个写者
+            if (m_readWaiting > 0 && (was_writer || m_writeWaiting == 0))
+            {
+                readers = m_readWaiting;
+                m_readers += readers;
+                m_readWaiting = 0;
+            }
+            else if (m_writeWaiting > 0)
+            {
+                writer = true;
+                m_writer = true;
+                --m_writeWaiting;
+            }
+        }
+        for (uint32_t i = 0; i < readers; ++i)
+        {
+            m_readWaiters.notify(true);
+        }
+        if (writer)
+        {
+            m_writeWaiters.notify(true);
+        }
+    }
 
 }
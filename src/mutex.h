@@ -478,27 +478,234 @@ namespace HPS
         volatile std::atomic_flag m_mutex;
     };
 
-    // class Scheduler;
-    // class FiberSemaphore : Noncopyable
-    // {
-    // public:
-    //     typedef Spinlock MutexType;
-
-    //     FiberSemaphore(size_t initial_concurrency = 0);
-    //     ~FiberSemaphore();
-
-    //     bool tryWait();
-    //     void wait();
-    //     void notify();
-
-    //     size_t getConcurrency() const { return m_concurrency; }
-    //     void reset() { m_concurrency = 0; }
-
-    // private:
-    //     MutexType m_mutex;
-    //     // std::list<std::pair<Scheduler *, Fiber::ptr>> m_waiters;
-    //     size_t m_concurrency;
-    // };
+    class Scheduler;
+    class Fiber;
+
+    class FiberMutex;
+
+    /**
+     * @brief 协程等待队列
+     * @details 等待的协程挂起(YieldToHold), 唤醒时放回其所在的调度器, 不阻塞工作线程;
+     *          唤醒先于等待者挂起到达时记为一次许可, 等待者随后直接返回
+     */
+    class FiberWaitQueue : Noncopyable
+    {
+    public:
+        typedef Spinlock MutexType;
+
+        /**
+         * @brief 构造函数
+         */
+        FiberWaitQueue();
+
+        /**
+         * @brief 析构函数
+         */
+        ~FiberWaitQueue();
+
+        /**
+         * @brief 挂起当前协程直到被唤醒, 有许可时消耗许可直接返回
+         * @param[in] mutex 挂起前释放的锁(加入队列之后释放, 不会丢失唤醒), 可为空
+         * @pre 在调度器的协程中调用
+         */
+        void wait(FiberMutex *mutex = nullptr);
+
+        /**
+         * @brief 唤醒一个等待的协程
+         * @param[in] keep 无等待者时是否留下一次许可
+         * @return 是否唤醒了协程
+         */
+        bool notify(bool keep);
+
+        /**
+         * @brief 唤醒所有等待的协程
+         * @return 唤醒的协程数量
+         */
+        size_t notifyAll();
+
+    private:
+        /// 保护等待队列
+        MutexType m_mutex;
+        /// 等待的协程及其调度器
+        std::list<std::pair<Scheduler *, std::shared_ptr<Fiber>>> m_waiters;
+        /// 未消耗的许可
+        size_t m_permits;
+    };
+
+    /**
+     * @brief 协程互斥量
+     * @details 竞争时挂起当前协程而不是阻塞线程, 可跨越hook的IO调用持有;
+     *          无竞争时只有一次原子操作. 解锁时锁直接移交给最早的等待者
+     */
+    class FiberMutex : Noncopyable
+    {
+    public:
+        /// 局部锁
+        typedef ScopedLockImpl<FiberMutex> Lock;
+
+        /**
+         * @brief 构造函数
+         */
+        FiberMutex();
+
+        /**
+         * @brief 加锁, 已被持有时挂起当前协程
+         */
+        void lock();
+
+        /**
+         * @brief 尝试加锁, 不等待
+         * @return 是否加锁成功
+         */
+        bool tryLock();
+
+        /**
+         * @brief 解锁
+         */
+        void unlock();
+
+    private:
+        /// 持有和等待锁的协程数量, 0为未上锁
+        std::atomic<int32_t> m_state;
+        /// 等待锁的协程
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程信号量
+     * @details 无可用信号量时挂起当前协程; 无竞争时只有一次原子操作
+     */
+    class FiberSemaphore : Noncopyable
+    {
+    public:
+        /**
+         * @brief 构造函数
+         * @param[in] initial_concurrency 信号量值的大小
+         */
+        FiberSemaphore(size_t initial_concurrency = 0);
+
+        /**
+         * @brief 尝试获取信号量, 不等待
+         * @return 是否获取成功
+         */
+        bool tryWait();
+
+        /**
+         * @brief 获取信号量, 无可用信号量时挂起当前协程
+         */
+        void wait();
+
+        /**
+         * @brief 释放信号量
+         */
+        void notify();
+
+        /**
+         * @brief 返回当前可用的信号量数量
+         */
+        size_t getConcurrency() const
+        {
+            int64_t v = m_count;
+            return v > 0 ? v : 0;
+        }
+
+    private:
+        /// 可用数量减去等待者数量, 负数表示有协程在等待
+        std::atomic<int64_t> m_count;
+        /// 等待的协程
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程条件变量
+     */
+    class FiberCondition : Noncopyable
+    {
+    public:
+        /**
+         * @brief 释放锁并挂起当前协程, 被唤醒后重新加锁
+         * @param[in] mutex 已持有的协程互斥量
+         * @attention 可能虚假唤醒, 调用者应在循环中检查条件
+         */
+        void wait(FiberMutex &mutex);
+
+        /**
+         * @brief 释放锁并挂起当前协程直到条件成立
+         */
+        template <class Predicate>
+        void wait(FiberMutex &mutex, Predicate pred)
+        {
+            while (!pred())
+            {
+                wait(mutex);
+            }
+        }
+
+        /**
+         * @brief 唤醒一个等待的协程
+         */
+        void notify();
+
+        /**
+         * @brief 唤醒所有等待的协程
+         */
+        void notifyAll();
+
+    private:
+        /// 等待的协程
+        FiberWaitQueue m_waiters;
+    };
+
+    /**
+     * @brief 协程读写锁
+     * @details 竞争时挂起当前协程; 状态由自旋锁保护, 无竞争时不进入内核.
+     *          有写者等待时新的读者排队, 写锁释放时优先唤醒等待的读者, 读写交替避免饿死
+     */
+    class FiberRWMutex : Noncopyable
+    {
+    public:
+        typedef Spinlock MutexType;
+        /// 局部读锁
+        typedef ReadScopedLockImpl<FiberRWMutex> ReadLock;
+        /// 局部写锁
+        typedef WriteScopedLockImpl<FiberRWMutex> WriteLock;
+
+        /**
+         * @brief 构造函数
+         */
+        FiberRWMutex();
+
+        /**
+         * @brief 上读锁
+         */
+        void rdlock();
+
+        /**
+         * @brief 上写锁
+         */
+        void wrlock();
+
+        /**
+         * @brief 解锁
+         */
+        void unlock();
+
+    private:
+        /// 保护锁状态
+        MutexType m_mutex;
+        /// 持有读锁的协程数量
+        uint32_t m_readers;
+        /// 是否持有写锁
+        bool m_writer;
+        /// 等待读锁的协程数量
+        uint32_t m_readWaiting;
+        /// 等待写锁的协程数量
+        uint32_t m_writeWaiting;
+        /// 等待读锁的协程
+        FiberWaitQueue m_readWaiters;
+        /// 等待写锁的协程
+        FiberWaitQueue m_writeWaiters;
+    };
 
 }
 
@@ -0,0 +1,145 @@
+#include "offload.h"
+#include "config.h"
+#include "log.h"
+#include "util.h"
+
+namespace HPS
+{
+
+    static Logger::ptr g_logger = LOG_NAME("system");
+
+    static ConfigVar<uint32_t>::ptr g_offload_threads =
+        Config::Lookup<uint32_t>("offload.threads", 4, "offload pool thread count");
+
+    static ConfigVar<uint32_t>::ptr g_offload_max_queue =
+        Config::Lookup<uint32_t>("offload.max_queue", 1024, "offload pool max queued calls, callers run inline beyond it");
+
+    OffloadPool::OffloadPool()
+        : OffloadPool(g_offload_threads->getValue(), g_offload_max_queue->getValue())
+    {
+    }
+
+    OffloadPool::OffloadPool(size_t threads, size_t max_queue, const std::string &name)
+        : m_maxQueue(max_queue)
+    {
+        if (threads == 0)
+        {
+            threads = 1;
+        }
+        for (size_t i = 0; i < threads; ++i)
+        {
+            m_threads.push_back(Thread::ptr(new Thread(std::bind(&OffloadPool::work, this), name + "_" + std::to_string(i))));
+        }
+    }
+
+    OffloadPool::~OffloadPool()
+    {
+        for (size_t i = 0; i < m_threads.size(); ++i)
+        {
+            m_sem.notify();
+        }
+        for (auto &i : m_threads)
+        {
+            i->join();
+        }
+    }
+
+    void OffloadPool::run(std::function<void()> cb)
+    {
+        //! 不能挂起时交给线程只会多一次切换, 直接执行
+        if (!ChannelWaiter::CanSuspend())
+        {
+            cb();
+            return;
+        }
+        if (Fiber::GetThis()->isSharedStack())
+        {
+            ++m_sharedStack;
+            cb();
+            return;
+        }
+        Job::ptr job(new Job);
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_jobs.size() >= m_maxQueue)
+            {
+                lock.unlock();
+                ++m_overflow;
+                cb();
+                return;
+            }
+            job->cb = std::move(cb);
+            job->waiter.reset(new ChannelWaiter);
+            job->enqueue_us = GetCurrentUS();
+            m_jobs.push_back(job);
+            ++m_submitted;
+            uint64_t queued = m_jobs.size();
+            uint64_t max_queued = m_maxQueued;
+            while (queued > max_queued && !m_maxQueued.compare_exchange_weak(max_queued, queued))
+            {
+            }
+        }
+        m_sem.notify();
+        job->waiter->wait();
+        if (job->exception)
+        {
+            std::rethrow_exception(job->exception);
+        }
+    }
+
+    void OffloadPool::work()
+    {
+        while (true)
+        {
+            m_sem.wait();
+            Job::ptr job;
+            {
+                MutexType::Lock lock(m_mutex);
+                if (!m_jobs.empty())
+                {
+                    job = m_jobs.front();
+                    m_jobs.pop_front();
+                }
+            }
+            //! 每个调用对应一次通知, 队列为空说明是关闭时的通知
+            if (!job)
+            {
+                return;
+            }
+            uint64_t begin = GetCurrentUS();
+            m_waitUs += begin - job->enqueue_us;
+            try
+            {
+                job->cb();
+            }
+            catch (...)
+            {
+                job->exception = std::current_exception();
+            }
+            m_runUs += GetCurrentUS() - begin;
+            ++m_completed;
+            //! job由双方共同持有, 唤醒后协程立即返回也不影响这里
+            job->waiter->claim(0);
+            job->waiter->wake();
+        }
+    }
+
+    OffloadPool::Stats OffloadPool::getStats() const
+    {
+        Stats stats;
+        {
+            MutexType::Lock lock(m_mutex);
+            stats.queued = m_jobs.size();
+        }
+        stats.submitted = m_submitted;
+        stats.completed = m_completed;
+        stats.overflow = m_overflow;
+        stats.shared_stack = m_sharedStack;
+        stats.max_queued = m_maxQueued;
+        stats.wait_us = m_waitUs;
+        stats.run_us = m_runUs;
+        stats.threads = m_threads.size();
+        return stats;
+    }
+
+}
@@ -0,0 +1,141 @@
+#ifndef __OFFLOAD_H__
+#define __OFFLOAD_H__
+
+#include "channel.h"
+#include "singleton.h"
+#include "thread.h"
+
+#include <exception>
+#include <list>
+#include <type_traits>
+#include <vector>
+
+namespace HPS
+{
+
+    /**
+     * @brief 阻塞调用的卸载线程池
+     * @details 协程把阻塞的调用(普通文件读写, yaml解析, 加载密钥等)交给独立的线程执行,
+     *          自身挂起, 调用完成后在原调度器上恢复, IO线程不被阻塞.
+     *          队列有界: 排队的调用达到上限时在调用方直接执行; 不在可挂起的协程中时同样直接执行.
+     *          共享栈上的协程挂起时栈被换出, 调用引用的栈上变量(结果, 读写缓冲区)对线程无效, 也直接执行
+     */
+    class OffloadPool : Noncopyable
+    {
+    public:
+        typedef std::shared_ptr<OffloadPool> ptr;
+        typedef Mutex MutexType;
+
+        /**
+         * @brief 运行统计
+         */
+        struct Stats
+        {
+            /// 交给线程执行的调用数
+            uint64_t submitted = 0;
+            /// 线程执行完成的调用数
+            uint64_t completed = 0;
+            /// 队列已满时在调用方执行的调用数
+            uint64_t overflow = 0;
+            /// 在共享栈的协程中直接执行的调用数
+            uint64_t shared_stack = 0;
+            /// 当前排队的调用数
+            uint64_t queued = 0;
+            /// 排队数的峰值
+            uint64_t max_queued = 0;
+            /// 累计排队时间(微秒)
+            uint64_t wait_us = 0;
+            /// 累计执行时间(微秒)
+            uint64_t run_us = 0;
+            /// 线程数
+            uint32_t threads = 0;
+        };
+
+        /**
+         * @brief 以配置offload.threads, offload.max_queue构造
+         */
+        OffloadPool();
+
+        /**
+         * @brief 构造函数
+         * @param[in] threads 线程数
+         * @param[in] max_queue 排队调用数的上限
+         * @param[in] name 线程名称前缀
+         */
+        OffloadPool(size_t threads, size_t max_queue, const std::string &name = "offload");
+
+        /**
+         * @brief 析构函数, 执行完已排队的调用后回收线程
+         */
+        ~OffloadPool();
+
+        /**
+         * @brief 在线程池中执行调用并等待完成
+         * @details 在协程中只挂起当前协程
+         * @exception 重新抛出调用抛出的异常
+         */
+        void run(std::function<void()> cb);
+
+        /**
+         * @brief 在线程池中执行调用并返回结果
+         * @details 返回值需要可默认构造
+         */
+        template <class F>
+        typename std::result_of<F()>::type call(F f)
+        {
+            typename std::result_of<F()>::type rt;
+            run([&rt, &f]()
+                { rt = f(); });
+            return rt;
+        }
+
+        /**
+         * @brief 返回运行统计
+         */
+        Stats getStats() const;
+
+    private:
+        /**
+         * @brief 排队的调用, 由等待的协程和执行的线程共同持有
+         */
+        struct Job
+        {
+            typedef std::shared_ptr<Job> ptr;
+            std::function<void()> cb;
+            ChannelWaiter::ptr waiter;
+            std::exception_ptr exception;
+            uint64_t enqueue_us = 0;
+        };
+
+        /**
+         * @brief 线程的入口
+         */
+        void work();
+
+    private:
+        /// 保护队列
+        mutable MutexType m_mutex;
+        /// 排队的调用
+        std::list<Job::ptr> m_jobs;
+        /// 排队的调用数, 关闭时额外通知每个线程一次
+        Semaphore m_sem;
+        /// 线程
+        std::vector<Thread::ptr> m_threads;
+        /// 排队调用数的上限
+        size_t m_maxQueue;
+        /// 统计计数
+        std::atomic<uint64_t> m_submitted = {0};
+        std::atomic<uint64_t> m_completed = {0};
+        std::atomic<uint64_t> m_overflow = {0};
+        std::atomic<uint64_t> m_sharedStack = {0};
+        std::atomic<uint64_t> m_maxQueued = {0};
+        std::atomic<uint64_t> m_waitUs = {0};
+        std::atomic<uint64_t> m_runUs = {0};
+    };
+
+    /// 默认的卸载线程池, hook的普通文件读写使用
+    typedef Singleton<OffloadPool> OffloadMgr;
+
+}
+
+#endif
@@ -2,6 +2,15 @@
 #include "log.h"
 #include "macro.h"
 #include "hook.h"
+#include "config.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
 
 //# 实用方法
 namespace HPS
@@ -9,6 +18,27 @@ namespace HPS
     static HPS::Logger::ptr g_logger = LOG_NAME("system");
     static thread_local Scheduler *t_scheduler = nullptr;
     static thread_local Fiber *t_scheduler_fiber = nullptr;
+    //! 当前线程在线程池中的下标(与工作窃取模式的本地队列, 运行统计的下标一致)
+    static thread_local int t_worker_slot = -1;
+    //! 当前线程是否正在执行非阻塞回调
+    static thread_local bool t_nonblocking_task = false;
+
+    static ConfigVar<bool>::ptr g_scheduler_work_stealing =
+        Config::Lookup<bool>("scheduler.work_stealing", false, "scheduler per-thread run queues with work stealing");
+
+    static ConfigVar<bool>::ptr g_scheduler_shared_stack =
+        Config::Lookup<bool>("scheduler.shared_stack", false, "scheduler runs callbacks on shared-stack fibers");
+
+    static ConfigVar<std::vector<int>>::ptr g_scheduler_priority_weights =
+        Config::Lookup<std::vector<int>>("scheduler.priority_weights", std::vector<int>{8, 4, 1},
+                                         "scheduler weighted round-robin picks per round for high, normal, low priority");
+
+    static ConfigVar<std::map<std::string, std::string>>::ptr g_scheduler_cpu_affinity =
+        Config::Lookup<std::map<std::string, std::string>>("scheduler.cpu_affinity", std::map<std::string, std::string>(),
+                                                            "scheduler name to cpu placement, e.g. \"0-3,8\" or \"node:1\"");
+
+    //! 当前线程本轮加权轮转中各优先级剩余的配额
+    static thread_local int t_priority_credits[Scheduler::PRIORITY_COUNT] = {0};
 
     Scheduler *Scheduler::GetThis()
     {
@@ -25,26 +55,170 @@ namespace HPS
         t_scheduler = this;
     }
 
+    bool Scheduler::TickleEventFd(int fd, std::atomic<bool> &pending, bool force)
+    {
+        //! 一个空闲期内只有第一个通知者发起系统调用
+        if (pending.exchange(true) && !force)
+        {
+            return false;
+        }
+        uint64_t one = 1;
+        int rt = write(fd, &one, sizeof(one));
+        ASSERT(rt == sizeof(one));
+        return true;
+    }
+
+    void Scheduler::ClearEventFd(int fd, std::atomic<bool> &pending)
+    {
+        uint64_t value = 0;
+        while (true)
+        {
+            //! 调用原始的read, hook的版本可能挂起空闲协程
+            ssize_t rt = read_f(fd, &value, sizeof(value));
+            if (rt == sizeof(value) || (rt < 0 && errno == EINTR))
+            {
+                continue;
+            }
+            if (rt < 0 && errno == EAGAIN)
+            {
+                break;
+            }
+            LOG_ERROR(g_logger) << "read eventfd fd=" << fd << " rt=" << rt
+                                << " errno=" << errno << " errstr=" << strerror(errno);
+            break;
+        }
+        //! 读空后再清标志: 先清标志时, 清标志与读之间的写入会被一并读走而标志仍为true, 之后的通知都被跳过;
+        //! 读空与清标志之间被跳过的通知不会丢失, 空闲循环阻塞前会重新检查队列
+        pending = false;
+    }
+
     void Scheduler::tickle()
     {
-        LOG_INFO(g_logger) << "tickle";
+        if (!hasIdleThreads())
+        {
+            return;
+        }
+        //! 只唤醒一个阻塞等待的线程, 认领后其他通知不再选中它
+        size_t n = m_idleWakers.size();
+        size_t start = m_idleIndex++;
+        for (size_t i = 0; i < n; ++i)
+        {
+            IdleWaker &waker = *m_idleWakers[(start + i) % n];
+            if (waker.idle.exchange(false))
+            {
+                TickleEventFd(waker.fd, waker.tickled);
+                return;
+            }
+        }
+    }
+
+    void Scheduler::tickleThread(int thread)
+    {
+        //! 本线程返回调度循环后自然会取到任务
+        if (thread == HPS::GetThreadId())
+        {
+            return;
+        }
+        int slot = slotOf(thread);
+        if (slot < 0)
+        {
+            tickle();
+            return;
+        }
+        //! 目标线程可能正要阻塞, 不能依据idle标志跳过
+        IdleWaker &waker = *m_idleWakers[slot];
+        waker.idle = false;
+        TickleEventFd(waker.fd, waker.tickled);
     }
 
     bool Scheduler::stopping()
     {
+        if (m_workStealing)
+        {
+            return m_autoStop && m_stopping && m_wakeCount == 0 && m_queuedTaskCount == 0 && m_activeThreadCount == 0 && m_parkedFiberCount == 0;
+        }
         MutexType::Lock lock(m_mutex);
-        //! 调度器自动（正常）停止且处于正在停止状态且没有任务和活跃线程，调度器才能停止
-        return m_autoStop && m_stopping && m_tasks.empty() && m_activeThreadCount == 0;
+        //! 调度器自动（正常）停止且处于正在停止状态且没有任务, 活跃线程和挂起的协程，调度器才能停止
+        return m_autoStop && m_stopping && m_wakeCount == 0 && tasksEmptyNoLock() && m_activeThreadCount == 0 && m_parkedFiberCount == 0;
     }
     //! 空闲方法，
     void Scheduler::idle()
     {
         LOG_INFO(g_logger) << "idle";
+        IdleWaker &waker = *m_idleWakers[t_worker_slot];
         while (!stopping())
         {
+            //! 空闲计数增加前入队的任务不会通知本线程, 阻塞前先检查
+            if (hasReadyTasks())
+            {
+                HPS::Fiber::YieldToHold();
+                continue;
+            }
+            waker.idle = true;
+            //! tickle()只通知idle为true的线程: 检查之后, 设置idle之前入队的任务或开始的停止不会通知本线程, 设置后必须再检查一次
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (hasReadyTasks() || stopping())
+            {
+                waker.idle = false;
+                continue;
+            }
+            //! 阻塞等待通知, 超时后重新检查是否可以停止; 调用原始的poll, hook的版本会挂起空闲协程
+            pollfd pfd;
+            pfd.fd = waker.fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int rt = poll_f(&pfd, 1, 3000);
+            waker.idle = false;
+            if (rt > 0)
+            {
+                ClearEventFd(waker.fd, waker.tickled);
+            }
             //! 空闲协程和调度协程在此切入切出
             HPS::Fiber::YieldToHold();
         }
+        //! 停止时的通知只唤醒当时阻塞的线程, 依次唤醒下一个线程退出
+        tickle();
+    }
+
+    void Scheduler::scheduleNonBlocking(Fiber::Callback cb, int thread)
+    {
+        Task task(std::move(cb), thread);
+        task.nonblocking = true;
+        if (task.cb)
+        {
+            scheduleTask(task);
+        }
+    }
+
+    bool Scheduler::InNonBlockingTask()
+    {
+        return t_nonblocking_task;
+    }
+
+    void Scheduler::scheduleTask(Task &task)
+    {
+        int thread = task.thread;
+        bool need_tickle = false;
+        if (m_workStealing)
+        {
+            need_tickle = scheduleWorkStealing(task);
+        }
+        else
+        {
+            MutexType::Lock lock(m_mutex);
+            need_tickle = scheduleNoLock(task);
+        }
+        if (need_tickle)
+        {
+            if (thread == -1)
+            {
+                tickle();
+            }
+            else
+            {
+                tickleThread(thread);
+            }
+        }
     }
 
     void Scheduler::switchTo(int thread)
@@ -57,7 +231,9 @@ namespace HPS
                 return;
             }
         }
-        schedule(Fiber::GetThis(), thread);
+        Fiber::ptr cur = Fiber::GetThis();
+        Priority priority = (Priority)cur->m_priority;
+        schedule(std::move(cur), thread, priority);
         Fiber::YieldToHold();
     }
 
@@ -68,8 +244,18 @@ namespace HPS
            << " active_count=" << m_activeThreadCount
            << " idle_count=" << m_idleThreadCount
            << " stopping=" << m_stopping
-           << " ]" << std::endl
+           << " work_stealing=" << m_workStealing
+           << " shared_stack=" << m_sharedStack
+           << " queued=" << m_queuedTaskCount
+           << " cpus=";
+        for (size_t i = 0; i < m_cpus.size(); ++i)
+        {
+            os << (i ? "," : "") << m_cpus[i];
+        }
+        os << " ]" << std::endl
            << "    ";
+        //! 线程id@绑定的CPU
+        MutexType::Lock lock(m_mutex);
         for (size_t i = 0; i < m_threadIds.size(); ++i)
         {
             if (i)
@@ -77,10 +263,650 @@ namespace HPS
                 os << ", ";
             }
             os << m_threadIds[i];
+            if (i < m_threadCpus.size() && m_threadCpus[i] >= 0)
+            {
+                os << "@" << m_threadCpus[i];
+            }
+        }
+        return os;
+    }
+
+    bool Scheduler::hasReadyTasks()
+    {
+        if (m_wakeCount > 0 || m_anyThreadTaskCount > 0)
+        {
+            return true;
+        }
+        //! 绑定到其他线程的任务本线程取不到, 不算就绪
+        int slot = t_scheduler == this ? t_worker_slot : -1;
+        return slot >= 0 && m_pinnedTaskCounts[slot]->count > 0;
+    }
+
+    //! 正在把已计数的任务放回调度队列(唤醒队列转入, 取出后放回), 不重复计入scheduled
+    static thread_local bool t_requeue = false;
+
+    void Scheduler::onTaskQueued(const Task &task)
+    {
+        if (!t_requeue)
+        {
+            m_scheduledCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (task.thread == -1)
+        {
+            ++m_anyThreadTaskCount;
+        }
+        else
+        {
+            int slot = slotOf(task.thread);
+            if (slot >= 0)
+            {
+                ++m_pinnedTaskCounts[slot]->count;
+            }
+        }
+        ++m_queuedTaskCount;
+    }
+
+    void Scheduler::onTaskTaken(const Task &task)
+    {
+        --m_queuedTaskCount;
+        if (task.thread == -1)
+        {
+            --m_anyThreadTaskCount;
+        }
+        else
+        {
+            int slot = slotOf(task.thread);
+            if (slot >= 0)
+            {
+                --m_pinnedTaskCounts[slot]->count;
+            }
+        }
+    }
+
+    bool Scheduler::tasksEmptyNoLock() const
+    {
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (!m_tasks[i].empty())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Scheduler::pickOrder(int *order) const
+    {
+        int n = 0;
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (t_priority_credits[i] > 0)
+            {
+                order[n++] = i;
+            }
+        }
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (t_priority_credits[i] <= 0)
+            {
+                order[n++] = i;
+            }
+        }
+    }
+
+    Scheduler::ThreadMetrics::ThreadMetrics()
+    {
+        executed = 0;
+        run_us = 0;
+        idle_us = 0;
+        switches = 0;
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            delay_count[i] = 0;
+            delay_total_us[i] = 0;
+            delay_max_us[i] = 0;
+        }
+        for (int i = 0; i < DELAY_BUCKETS; ++i)
+        {
+            delay_hist[i] = 0;
+        }
+    }
+
+    void Scheduler::onTaskPicked(const Task &task, ThreadMetrics &metrics, uint64_t now)
+    {
+        //! 取到的任务没有配额, 说明有配额的优先级都没有任务, 开始新一轮
+        if (t_priority_credits[task.priority] <= 0)
+        {
+            for (int i = 0; i < PRIORITY_COUNT; ++i)
+            {
+                t_priority_credits[i] = m_weights[i];
+            }
+        }
+        --t_priority_credits[task.priority];
+
+        uint64_t delay = now > task.enqueued ? now - task.enqueued : 0;
+        ThreadMetrics::Add(metrics.delay_count[task.priority], 1);
+        ThreadMetrics::Add(metrics.delay_total_us[task.priority], delay);
+        if (delay > metrics.delay_max_us[task.priority].load(std::memory_order_relaxed))
+        {
+            metrics.delay_max_us[task.priority].store(delay, std::memory_order_relaxed);
+        }
+        int bucket = 0;
+        while (delay && bucket < DELAY_BUCKETS - 1)
+        {
+            delay >>= 1;
+            ++bucket;
+        }
+        ThreadMetrics::Add(metrics.delay_hist[bucket], 1);
+    }
+
+    Scheduler::QueueDelayStats Scheduler::getQueueDelayStats(Priority priority) const
+    {
+        QueueDelayStats stats;
+        for (auto &i : m_threadMetrics)
+        {
+            stats.count += i->delay_count[priority].load(std::memory_order_relaxed);
+            stats.total_us += i->delay_total_us[priority].load(std::memory_order_relaxed);
+            stats.max_us = std::max<uint64_t>(stats.max_us, i->delay_max_us[priority].load(std::memory_order_relaxed));
+        }
+        return stats;
+    }
+
+    Scheduler::Metrics Scheduler::getMetrics() const
+    {
+        Metrics metrics;
+        for (int i = 0; i < DELAY_BUCKETS; ++i)
+        {
+            metrics.delay_hist[i] = 0;
+        }
+        //! start()在锁内填充线程id, 取快照后再读
+        std::vector<int> thread_ids;
+        std::vector<int> thread_cpus;
+        {
+            MutexType::Lock lock(m_mutex);
+            thread_ids = m_threadIds;
+            thread_cpus = m_threadCpus;
+        }
+        metrics.threads.resize(m_threadMetrics.size());
+        for (size_t i = 0; i < m_threadMetrics.size(); ++i)
+        {
+            const ThreadMetrics &tm = *m_threadMetrics[i];
+            ThreadStats &ts = metrics.threads[i];
+            //! 线程池线程在start()之后才有线程id
+            if (i < thread_ids.size())
+            {
+                ts.id = thread_ids[i];
+                ts.cpu = i < thread_cpus.size() ? thread_cpus[i] : -1;
+            }
+            ts.executed = tm.executed.load(std::memory_order_relaxed);
+            ts.run_us = tm.run_us.load(std::memory_order_relaxed);
+            ts.idle_us = tm.idle_us.load(std::memory_order_relaxed);
+            ts.switches = tm.switches.load(std::memory_order_relaxed);
+            metrics.executed += ts.executed;
+            metrics.run_us += ts.run_us;
+            metrics.idle_us += ts.idle_us;
+            metrics.switches += ts.switches;
+            for (int j = 0; j < DELAY_BUCKETS; ++j)
+            {
+                metrics.delay_hist[j] += tm.delay_hist[j].load(std::memory_order_relaxed);
+            }
+        }
+        metrics.queued = m_queuedTaskCount + m_wakeCount;
+        metrics.parked = m_parkedFiberCount;
+        metrics.scheduled = m_scheduledCount.load(std::memory_order_relaxed);
+        return metrics;
+    }
+
+    std::ostream &Scheduler::dumpMetrics(std::ostream &os) const
+    {
+        Metrics metrics = getMetrics();
+        os << "scheduler=" << m_name << std::endl
+           << "scheduled=" << metrics.scheduled << std::endl
+           << "executed=" << metrics.executed << std::endl
+           << "queued=" << metrics.queued << std::endl
+           << "parked=" << metrics.parked << std::endl
+           << "run_us=" << metrics.run_us << std::endl
+           << "idle_us=" << metrics.idle_us << std::endl
+           << "switches=" << metrics.switches << std::endl;
+        for (int i = 0; i < DELAY_BUCKETS; ++i)
+        {
+            //! 桶的上界(微秒), 最后一个桶无上界
+            os << "delay_us_le_";
+            if (i == DELAY_BUCKETS - 1)
+            {
+                os << "inf";
+            }
+            else
+            {
+                os << ((1ull << i) - 1);
+            }
+            os << "=" << metrics.delay_hist[i] << std::endl;
+        }
+        for (auto &i : metrics.threads)
+        {
+            os << "thread=" << i.id << " cpu=" << i.cpu
+               << " executed=" << i.executed
+               << " run_us=" << i.run_us
+               << " idle_us=" << i.idle_us
+               << " switches=" << i.switches << std::endl;
         }
         return os;
     }
 
+    int Scheduler::slotOf(int thread) const
+    {
+        //! 不读m_threadIds: start()向其追加时其他线程可能正在调度绑定任务
+        for (size_t i = 0; i < m_slotCount; ++i)
+        {
+            if (m_slotThreads[i].load(std::memory_order_acquire) == thread)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool Scheduler::scheduleNoLock(Task &task)
+    {
+        //! 绑定线程的任务总是通知目标线程
+        bool need_tickle = tasksEmptyNoLock() || task.thread != -1;
+        if (m_workStealing)
+        {
+            ++m_globalTasks[task.priority];
+        }
+        onTaskQueued(task);
+        m_tasks[task.priority].push_back(std::move(task));
+        return need_tickle;
+    }
+
+    bool Scheduler::scheduleGlobal(Task &task)
+    {
+        MutexType::Lock lock(m_mutex);
+        return scheduleNoLock(task);
+    }
+
+    bool Scheduler::scheduleWorkStealing(Task &task)
+    {
+        int slot = -1;
+        if (task.thread != -1)
+        {
+            slot = slotOf(task.thread);
+        }
+        else if (t_scheduler == this)
+        {
+            slot = t_worker_slot;
+        }
+        //! 线程池外部调度的任务和非普通优先级的任务放入全局注入队列
+        if (slot < 0 || (task.thread == -1 && task.priority != PRIORITY_NORMAL))
+        {
+            return scheduleGlobal(task);
+        }
+
+        WorkQueue &wq = *m_workQueues[slot];
+        WorkQueue::MutexType::Lock lock(wq.mutex);
+        onTaskQueued(task);
+        if (task.thread != -1)
+        {
+            wq.pinned.push_back(std::move(task));
+        }
+        else
+        {
+            wq.tasks.push_back(std::move(task));
+        }
+        //! 放入其他线程的队列,或本线程队列中已有积压时,唤醒空闲线程来窃取
+        bool own = (t_scheduler == this && slot == t_worker_slot);
+        return wq.size++ > 0 || !own;
+    }
+
+    void Scheduler::TaskBatch::link(MpscNode *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        if (m_last)
+        {
+            m_last->next.store(node, std::memory_order_relaxed);
+        }
+        else
+        {
+            m_first = node;
+        }
+        m_last = node;
+    }
+
+    void Scheduler::TaskBatch::add(Fiber::ptr &fiber, Priority priority)
+    {
+        if (!fiber)
+        {
+            return;
+        }
+        ++m_count;
+        //! 协程已在唤醒队列中(不应发生),退化为普通任务
+        if (fiber->m_wakeRef)
+        {
+            if (!m_callbacks)
+            {
+                m_callbacks = new CallbackNode;
+                m_callbacks->tag = WAKE_CALLBACKS;
+            }
+            m_callbacks->tasks.push_back(Task(&fiber, -1));
+            m_callbacks->tasks.back().priority = priority;
+            return;
+        }
+        Fiber *raw = fiber.get();
+        raw->m_priority = priority;
+        raw->m_wakeRef.swap(fiber);
+        raw->tag = WAKE_FIBER;
+        link(raw);
+    }
+
+    void Scheduler::TaskBatch::add(std::function<void()> &cb, Priority priority)
+    {
+        if (!cb)
+        {
+            return;
+        }
+        if (!m_callbacks)
+        {
+            m_callbacks = new CallbackNode;
+            m_callbacks->tag = WAKE_CALLBACKS;
+        }
+        m_callbacks->tasks.push_back(Task(&cb, -1));
+        m_callbacks->tasks.back().priority = priority;
+        ++m_count;
+    }
+
+    void Scheduler::TaskBatch::addNonBlocking(std::function<void()> &cb)
+    {
+        if (!cb)
+        {
+            return;
+        }
+        add(cb);
+        m_callbacks->tasks.back().nonblocking = true;
+    }
+
+    void Scheduler::submit(TaskBatch &batch)
+    {
+        if (batch.m_callbacks)
+        {
+            batch.link(batch.m_callbacks);
+            batch.m_callbacks = nullptr;
+        }
+        if (!batch.m_first)
+        {
+            return;
+        }
+        //! 先计数再发布, 保证stopping()看到未消费的任务
+        m_scheduledCount.fetch_add(batch.m_count, std::memory_order_relaxed);
+        m_wakeCount += batch.m_count;
+        m_wakeQueue.pushChain(batch.m_first, batch.m_last);
+        batch.m_first = batch.m_last = nullptr;
+        batch.m_count = 0;
+        tickle();
+    }
+
+    void Scheduler::drainWakeQueue()
+    {
+        if (m_wakeCount == 0 || m_wakeConsumer.test_and_set(std::memory_order_acquire))
+        {
+            return;
+        }
+        //! 单消费者: 先取出全部节点,再只加一次调度队列的锁
+        static thread_local std::vector<Task> t_drained;
+        MpscNode *node = nullptr;
+        while ((node = m_wakeQueue.pop()))
+        {
+            if (node->tag == WAKE_FIBER)
+            {
+                Fiber *fiber = static_cast<Fiber *>(node);
+                t_drained.push_back(Task(&fiber->m_wakeRef, -1));
+                t_drained.back().priority = fiber->m_priority;
+            }
+            else
+            {
+                CallbackNode *cbs = static_cast<CallbackNode *>(node);
+                for (auto &i : cbs->tasks)
+                {
+                    t_drained.push_back(std::move(i));
+                }
+                delete cbs;
+            }
+        }
+        m_wakeConsumer.clear(std::memory_order_release);
+
+        size_t count = t_drained.size();
+        if (count == 0)
+        {
+            return;
+        }
+        //! 唤醒队列中的任务已在submit()时计数
+        t_requeue = true;
+        if (m_workStealing && t_worker_slot >= 0)
+        {
+            //! 绑定在其他线程上的协程(共享栈协程)转交对应线程
+            size_t local = 0;
+            {
+                WorkQueue &wq = *m_workQueues[t_worker_slot];
+                WorkQueue::MutexType::Lock lock(wq.mutex);
+                for (auto &i : t_drained)
+                {
+                    if (i.thread == -1 && i.priority == PRIORITY_NORMAL)
+                    {
+                        onTaskQueued(i);
+                        wq.tasks.push_back(std::move(i));
+                        ++local;
+                    }
+                    else if (slotOf(i.thread) == t_worker_slot)
+                    {
+                        onTaskQueued(i);
+                        wq.pinned.push_back(std::move(i));
+                        ++local;
+                    }
+                }
+                wq.size += local;
+            }
+            for (auto &i : t_drained)
+            {
+                //! 已放入本地队列的任务被移走
+                if (!i.fiber && !i.cb)
+                {
+                    continue;
+                }
+                int thread = i.thread;
+                if (scheduleWorkStealing(i))
+                {
+                    if (thread == -1)
+                    {
+                        tickle();
+                    }
+                    else
+                    {
+                        tickleThread(thread);
+                    }
+                }
+            }
+        }
+        else
+        {
+            MutexType::Lock lock(m_mutex);
+            for (auto &i : t_drained)
+            {
+                scheduleNoLock(i);
+            }
+        }
+        t_requeue = false;
+        t_drained.clear();
+        m_wakeCount -= count;
+    }
+
+    void Scheduler::scheduleReady(Fiber::ptr fiber)
+    {
+        //! 主动让出的协程放入全局队列,避免本地LIFO队列中被反复取出而饿死其他任务
+        Priority priority = (Priority)fiber->m_priority;
+        if (m_workStealing)
+        {
+            Task task(std::move(fiber), -1);
+            task.priority = priority;
+            if (scheduleGlobal(task))
+            {
+                tickle();
+            }
+            return;
+        }
+        schedule(std::move(fiber), -1, priority);
+    }
+
+    bool Scheduler::popGlobal(Task &task, bool &tickle_me, int priority)
+    {
+        if (priority < 0)
+        {
+            int order[PRIORITY_COUNT];
+            pickOrder(order);
+            for (int i = 0; i < PRIORITY_COUNT; ++i)
+            {
+                if (popGlobal(task, tickle_me, order[i]))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (m_globalTasks[priority] == 0)
+        {
+            return false;
+        }
+        MutexType::Lock lock(m_mutex);
+        TaskQueue &queue = m_tasks[priority];
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+        {
+            //! 绑定到线程池外线程的任务,与原逻辑一致只由对应线程执行
+            if (it->thread != -1 && it->thread != HPS::GetThreadId())
+            {
+                tickle_me = true;
+                continue;
+            }
+            queue.take(it, task);
+            --m_globalTasks[priority];
+            onTaskTaken(task);
+            tickle_me |= !tasksEmptyNoLock();
+            return true;
+        }
+        return false;
+    }
+
+    bool Scheduler::nextTaskWorkStealing(Task &task, bool &tickle_me)
+    {
+        //! 本地队列优先,全局队列每隔若干次被优先检查一次,避免饿死
+        static thread_local uint32_t t_tick = 0;
+        //! 先计入活跃线程再出队,保证stopping()不会在任务出队到执行之间误判
+        ++m_activeThreadCount;
+        int slot = t_worker_slot;
+        if (++t_tick % 61 == 0 && popGlobal(task, tickle_me))
+        {
+            return true;
+        }
+        //! 1.本线程绑定队列(FIFO)
+        WorkQueue *wq = slot >= 0 ? m_workQueues[slot].get() : nullptr;
+        if (wq && wq->size > 0)
+        {
+            WorkQueue::MutexType::Lock lock(wq->mutex);
+            if (!wq->pinned.empty())
+            {
+                wq->pinned.pop_front(task);
+                --wq->size;
+                onTaskTaken(task);
+                return true;
+            }
+        }
+        //! 2.按加权轮转的顺序查找各优先级; 普通优先级依次查找
+        //!   本地队列(尾部LIFO,保证缓存亲和),全局注入队列,最后从其他线程窃取
+        int order[PRIORITY_COUNT];
+        pickOrder(order);
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            if (order[i] != PRIORITY_NORMAL)
+            {
+                if (popGlobal(task, tickle_me, order[i]))
+                {
+                    return true;
+                }
+                continue;
+            }
+            if (wq && wq->size > 0)
+            {
+                WorkQueue::MutexType::Lock lock(wq->mutex);
+                if (!wq->tasks.empty())
+                {
+                    wq->tasks.pop_back(task);
+                    --wq->size;
+                    onTaskTaken(task);
+                    return true;
+                }
+            }
+            if (popGlobal(task, tickle_me, PRIORITY_NORMAL) || stealTask(slot, task, tickle_me))
+            {
+                return true;
+            }
+        }
+        --m_activeThreadCount;
+        return false;
+    }
+
+    bool Scheduler::stealTask(int slot, Task &task, bool &tickle_me)
+    {
+        //! 从其他线程本地队列头部窃取一半任务
+        size_t n = m_workQueues.size();
+        size_t start = slot >= 0 ? slot + 1 : 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t victim = (start + i) % n;
+            if ((int)victim == slot)
+            {
+                continue;
+            }
+            WorkQueue &vq = *m_workQueues[victim];
+            if (vq.size == 0)
+            {
+                continue;
+            }
+            static thread_local std::vector<Task> stolen;
+            stolen.clear();
+            {
+                WorkQueue::MutexType::Lock lock(vq.mutex);
+                //! 绑定任务不可窃取,需要唤醒目标线程
+                if (!vq.pinned.empty())
+                {
+                    tickle_me = true;
+                }
+                size_t steal = slot >= 0 ? (vq.tasks.size() + 1) / 2 : std::min<size_t>(vq.tasks.size(), 1);
+                stolen.resize(steal);
+                for (size_t j = 0; j < steal; ++j)
+                {
+                    vq.tasks.pop_front(stolen[j]);
+                }
+                vq.size -= steal;
+            }
+            if (stolen.empty())
+            {
+                continue;
+            }
+            task = std::move(stolen.front());
+            onTaskTaken(task);
+            if (stolen.size() > 1)
+            {
+                WorkQueue &wq = *m_workQueues[slot];
+                WorkQueue::MutexType::Lock lock(wq.mutex);
+                for (size_t j = 1; j < stolen.size(); ++j)
+                {
+                    wq.tasks.push_back(std::move(stolen[j]));
+                }
+                wq.size += stolen.size() - 1;
+            }
+            stolen.clear();
+            return true;
+        }
+        return false;
+    }
+
     // SchedulerSwitcher::SchedulerSwitcher(Scheduler *target)
     // {
     //     m_caller = Scheduler::GetThis();
@@ -103,10 +929,41 @@ namespace HPS
 namespace HPS
 {
     //# 1)主线程创建协程调度器
-    Scheduler::Scheduler(size_t threads, bool use_mainThread, const std::string &name)
+    Scheduler::Scheduler(size_t threads, bool use_mainThread, const std::string &name, const std::string &cpus)
         : m_name(name)
     {
-        ASSERT(threads > 0);
+        std::string placement = cpus;
+        if (placement.empty())
+        {
+            auto affinity = g_scheduler_cpu_affinity->getValue();
+            auto it = affinity.find(name);
+            if (it != affinity.end())
+            {
+                placement = it->second;
+            }
+        }
+        m_cpus = Thread::ParseCpus(placement);
+        if (threads == 0)
+        {
+            threads = m_cpus.size() + (use_mainThread ? 1 : 0);
+            //! 未配置放置或放置解析不出CPU时不绑核, 按CPU数量创建线程
+            if (m_cpus.empty())
+            {
+                threads = std::max(std::thread::hardware_concurrency(), 1u);
+                LOG_ERROR(g_logger) << "Scheduler " << name << " threads=0 but placement \"" << placement
+                                    << "\" has no cpus, fallback threads=" << threads << " without pinning";
+            }
+        }
+        m_workStealing = g_scheduler_work_stealing->getValue();
+        m_sharedStack = g_scheduler_shared_stack->getValue();
+        std::vector<int> weights = g_scheduler_priority_weights->getValue();
+        for (int i = 0; i < PRIORITY_COUNT; ++i)
+        {
+            m_globalTasks[i] = 0;
+            //! 缺省或非法的权重按1处理
+            m_weights[i] = i < (int)weights.size() && weights[i] > 0 ? weights[i] : 1;
+        }
+        m_threadIds.reserve(threads);
         //! 若需要主线程（创建该调度器的线程，非线程池的线程）执行任务
         if (use_mainThread)
         {
@@ -124,12 +981,45 @@ namespace HPS
             t_scheduler_fiber = m_rootFiber.get();
             m_rootThread = HPS::GetThreadId();
             m_threadIds.push_back(m_rootThread);
+            m_threadCpus.push_back(-1);
         }
         else
         {
             m_rootThread = -1;
         }
         m_threadCount = threads;
+        m_slotCount = m_threadIds.size() + m_threadCount;
+        m_slotThreads.reset(new std::atomic<int>[m_slotCount]);
+        for (size_t i = 0; i < m_slotCount; ++i)
+        {
+            m_slotThreads[i] = i < m_threadIds.size() ? m_threadIds[i] : -1;
+        }
+        m_threadMetrics.resize(m_threadIds.size() + m_threadCount);
+        for (auto &i : m_threadMetrics)
+        {
+            i.reset(new ThreadMetrics);
+        }
+        m_idleWakers.resize(m_threadIds.size() + m_threadCount);
+        for (auto &i : m_idleWakers)
+        {
+            i.reset(new IdleWaker);
+            i->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            ASSERT(i->fd >= 0);
+        }
+        m_pinnedTaskCounts.resize(m_threadIds.size() + m_threadCount);
+        for (auto &i : m_pinnedTaskCounts)
+        {
+            i.reset(new PinnedCount);
+        }
+        //! 工作窃取模式下为每个线程(含主线程)创建本地队列
+        if (m_workStealing)
+        {
+            m_workQueues.resize(m_threadIds.size() + m_threadCount);
+            for (auto &i : m_workQueues)
+            {
+                i.reset(new WorkQueue);
+            }
+        }
     }
 
     //# 2) 调度器启动
@@ -147,8 +1037,17 @@ namespace HPS
         m_threads.resize(m_threadCount);
         for (size_t i = 0; i < m_threadCount; ++i)
         {
-            m_threads[i].reset(new Thread(std::bind(&Scheduler::run, this), m_name + "_" + std::to_string(i)));
+            std::vector<int> cpus;
+            if (!m_cpus.empty())
+            {
+                cpus.push_back(m_cpus[i % m_cpus.size()]);
+            }
+            m_threads[i].reset(new Thread(std::bind(&Scheduler::run, this), m_name + "_" + std::to_string(i), cpus));
+            //! 线程池线程的下标排在主线程之后
+            m_slotThreads[m_slotCount - m_threadCount + i].store(m_threads[i]->getId(), std::memory_order_release);
             m_threadIds.push_back(m_threads[i]->getId());
+            const std::vector<int> &bound = m_threads[i]->getCpus();
+            m_threadCpus.push_back(bound.empty() ? -1 : bound[0]);
         }
         lock.unlock();
     }
@@ -166,6 +1065,13 @@ namespace HPS
             //! 在该线程上创建调度协程
             t_scheduler_fiber = Fiber::GetThis().get();
         }
+        {
+            //! start()持有锁直到线程id全部记录
+            MutexType::Lock lock(m_mutex);
+            t_worker_slot = slotOf(HPS::GetThreadId());
+        }
+        ASSERT(t_worker_slot >= 0);
+        ThreadMetrics &metrics = *m_threadMetrics[t_worker_slot];
         //! 运行空闲方法的协程
         Fiber::ptr idle_fiber(new Fiber(std::bind(&Scheduler::idle, this), 0, true));
         //! 执行任务的协程
@@ -178,35 +1084,62 @@ namespace HPS
             //! 作用（???）
             bool tickle_me = false;
             bool is_active = false;
+            drainWakeQueue();
+            if (m_workStealing)
+            {
+                is_active = nextTaskWorkStealing(task, tickle_me);
+                //! 协程仍在其他线程上执行(如switchTo), 放回全局队列稍后再取
+                if (is_active && task.fiber && task.fiber->getState() == Fiber::EXEC)
+                {
+                    t_requeue = true;
+                    scheduleGlobal(task);
+                    t_requeue = false;
+                    task.reset();
+                    tickle_me = true;
+                }
+            }
+            else
             {
                 MutexType::Lock lock(m_mutex);
-                auto it = m_tasks.begin();
-                //! 遍历任务队列，
-                while (it != m_tasks.end())
+                int order[PRIORITY_COUNT];
+                pickOrder(order);
+                for (int i = 0; i < PRIORITY_COUNT && !is_active; ++i)
                 {
-                    //! 若该任务不能被任意线程执行，或者不是能执行该任务相应的线程
-                    if (it->thread != -1 && it->thread != HPS::GetThreadId())
+                    TaskQueue &queue = m_tasks[order[i]];
+                    auto it = queue.begin();
+                    //! 遍历任务队列，
+                    while (it != queue.end())
                     {
-                        ++it;
-                        tickle_me = true;
-                        continue;
-                    }
+                        //! 若该任务不能被任意线程执行，或者不是能执行该任务相应的线程
+                        if (it->thread != -1 && it->thread != HPS::GetThreadId())
+                        {
+                            ++it;
+                            tickle_me = true;
+                            continue;
+                        }
 
-                    ASSERT(it->fiber || it->cb);
-                    //! 若该任务已经在执行状态
-                    if (it->fiber && it->fiber->getState() == Fiber::EXEC)
-                    {
-                        ++it;
-                        continue;
+                        ASSERT(it->fiber || it->cb);
+                        //! 若该任务已经在执行状态
+                        if (it->fiber && it->fiber->getState() == Fiber::EXEC)
+                        {
+                            ++it;
+                            continue;
+                        }
+                        //! 线程取得任务, 节点留给后续入队复用
+                        queue.take(it, task);
+                        onTaskTaken(task);
+                        ++m_activeThreadCount;
+                        is_active = true;
+                        break;
                     }
-                    //! 线程取得任务
-                    task = *it;
-                    m_tasks.erase(it++);
-                    ++m_activeThreadCount;
-                    is_active = true;
-                    break;
                 }
-                tickle_me |= it != m_tasks.end();
+                tickle_me |= is_active && !tasksEmptyNoLock();
+            }
+            uint64_t start = 0;
+            if (task.fiber || task.cb)
+            {
+                start = GetCurrentUS();
+                onTaskPicked(task, metrics, start);
             }
             //! ???
             if (tickle_me)
@@ -217,12 +1150,16 @@ namespace HPS
             if (task.fiber && (task.fiber->getState() != Fiber::TERM && task.fiber->getState() != Fiber::EXCEPT))
             {
                 task.fiber->setUseCaller(true);
+                task.fiber->m_priority = task.priority;
                 task.fiber->call();
                 --m_activeThreadCount;
+                ThreadMetrics::Add(metrics.executed, 1);
+                ThreadMetrics::Add(metrics.switches, 1);
+                ThreadMetrics::Add(metrics.run_us, GetCurrentUS() - start);
 
                 if (task.fiber->getState() == Fiber::READY)
                 {
-                    schedule(task.fiber);
+                    scheduleReady(task.fiber);
                 }
                 else if (task.fiber->getState() != Fiber::TERM && task.fiber->getState() != Fiber::EXCEPT)
                 {
@@ -230,22 +1167,52 @@ namespace HPS
                 }
                 task.reset();
             }
+            else if (task.cb && task.nonblocking)
+            {
+                //! 非阻塞回调直接在调度协程上执行
+                t_nonblocking_task = true;
+                try
+                {
+                    task.cb();
+                }
+                catch (std::exception &ex)
+                {
+                    LOG_ERROR(g_logger) << "Nonblocking Task Except: " << ex.what()
+                                        << std::endl
+                                        << HPS::BacktraceToString();
+                }
+                catch (...)
+                {
+                    LOG_ERROR(g_logger) << "Nonblocking Task Except"
+                                        << std::endl
+                                        << HPS::BacktraceToString();
+                }
+                t_nonblocking_task = false;
+                --m_activeThreadCount;
+                ThreadMetrics::Add(metrics.executed, 1);
+                ThreadMetrics::Add(metrics.run_us, GetCurrentUS() - start);
+                task.reset();
+            }
             else if (task.cb)
             {
                 if (task_fiber)
                 {
-                    task_fiber->reset(task.cb, true);
+                    task_fiber->reset(std::move(task.cb), true);
                 }
                 else
                 {
-                    task_fiber.reset(new Fiber(task.cb, 0, true));
+                    task_fiber.reset(new Fiber(std::move(task.cb), 0, true, m_sharedStack));
                 }
+                task_fiber->m_priority = task.priority;
                 task.reset();
                 task_fiber->call();
                 --m_activeThreadCount;
+                ThreadMetrics::Add(metrics.executed, 1);
+                ThreadMetrics::Add(metrics.switches, 1);
+                ThreadMetrics::Add(metrics.run_us, GetCurrentUS() - start);
                 if (task_fiber->getState() == Fiber::READY)
                 {
-                    schedule(task_fiber);
+                    scheduleReady(task_fiber);
                     task_fiber.reset();
                 }
                 else if (task_fiber->getState() == Fiber::EXCEPT || task_fiber->getState() == Fiber::TERM)
@@ -273,7 +1240,10 @@ namespace HPS
                 }
 
                 ++m_idleThreadCount;
+                uint64_t idle_start = GetCurrentUS();
                 idle_fiber->call();
+                ThreadMetrics::Add(metrics.switches, 1);
+                ThreadMetrics::Add(metrics.idle_us, GetCurrentUS() - idle_start);
                 --m_idleThreadCount;
                 if (idle_fiber->getState() != Fiber::TERM && idle_fiber->getState() != Fiber::EXCEPT)
                 {
@@ -281,6 +1251,7 @@ namespace HPS
                 }
             }
         }
+        t_worker_slot = -1;
     }
     //# 4) 主线程将调度器停止
     void Scheduler::stop()
@@ -358,6 +1329,10 @@ namespace HPS
     Scheduler::~Scheduler()
     {
         ASSERT(m_stopping);
+        for (auto &i : m_idleWakers)
+        {
+            close(i->fd);
+        }
         if (GetThis() == this)
         {
             t_scheduler = nullptr;
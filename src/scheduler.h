@@ -3,10 +3,13 @@
 
 #include "fiber.h"
 #include "thread.h"
+#include "mpsc_queue.h"
+#include "util.h"
 
 #include <memory>
 #include <vector>
 #include <list>
+#include <type_traits>
 #include <iostream>
 
 namespace HPS
@@ -16,6 +19,11 @@ namespace HPS
      * @brief 协程调度器
      * @details 封装的是N-M的协程调度器
      *          内部有一个线程池,支持协程在线程池里面切换
+     *          空闲线程阻塞在eventfd上, 一个空闲期内的多次通知只写一次eventfd
+     *          开启scheduler.work_stealing后,每个线程拥有本地任务队列,
+     *          全局队列只接收线程池外部调度的任务,空闲线程从其他线程窃取任务
+     *          任务按优先级分别排队, 取任务时按scheduler.priority_weights加权轮转,
+     *          高优先级优先且低优先级不会饿死
      */
     class Scheduler
     {
@@ -23,13 +31,93 @@ namespace HPS
         typedef std::shared_ptr<Scheduler> ptr;
         typedef Mutex MutexType;
 
+        /**
+         * @brief 任务优先级(延迟等级)
+         */
+        enum Priority
+        {
+            /// 延迟敏感的任务, 如请求处理协程
+            PRIORITY_HIGH = 0,
+            /// 默认优先级
+            PRIORITY_NORMAL = 1,
+            /// 后台任务, 如缓存刷新, 日志落盘
+            PRIORITY_LOW = 2,
+            /// 优先级数量
+            PRIORITY_COUNT = 3
+        };
+
+        /**
+         * @brief 某一优先级任务在调度队列中的等待时间统计
+         */
+        struct QueueDelayStats
+        {
+            /// 出队执行的任务数量
+            uint64_t count = 0;
+            /// 等待时间总和(微秒)
+            uint64_t total_us = 0;
+            /// 最大等待时间(微秒)
+            uint64_t max_us = 0;
+        };
+
+        /// 排队等待时间直方图的桶数, 第0个桶为不足1微秒,
+        /// 第i个桶为[2^(i-1), 2^i)微秒, 最后一个桶包含更长的等待
+        static const int DELAY_BUCKETS = 20;
+
+        /**
+         * @brief 单个线程的运行统计
+         */
+        struct ThreadStats
+        {
+            /// 线程id
+            int id = -1;
+            /// 绑定的CPU, -1为未绑定
+            int cpu = -1;
+            /// 执行的任务数量
+            uint64_t executed = 0;
+            /// 执行任务的时间(微秒)
+            uint64_t run_us = 0;
+            /// 在idle()中的时间(微秒)
+            uint64_t idle_us = 0;
+            /// 调度协程切入任务协程或空闲协程的次数
+            uint64_t switches = 0;
+        };
+
+        /**
+         * @brief 调度器运行统计的快照
+         */
+        struct Metrics
+        {
+            /// 入队的任务数量, 与已执行和排队中之和的差为结束后才被取出而丢弃的协程
+            uint64_t scheduled = 0;
+            /// 执行的任务数量
+            uint64_t executed = 0;
+            /// 当前排队的任务数量(含唤醒队列)
+            uint64_t queued = 0;
+            /// 挂起在协程同步原语或通道上的协程数量
+            uint64_t parked = 0;
+            /// 执行任务的时间(微秒)
+            uint64_t run_us = 0;
+            /// 在idle()中的时间(微秒)
+            uint64_t idle_us = 0;
+            /// 协程切换次数
+            uint64_t switches = 0;
+            /// 入队到开始执行的等待时间直方图
+            uint64_t delay_hist[DELAY_BUCKETS];
+            /// 每个线程的统计, 顺序与线程id数组一致
+            std::vector<ThreadStats> threads;
+        };
+
         /**
          * @brief 构造函数
-         * @param[in] threads 线程数量
+         * @param[in] threads 线程数量, 为0时每个放置CPU一个线程
          * @param[in] use_mainThread 是否使用当前调用线程
          * @param[in] name 协程调度器名称
+         * @param[in] cpus 线程池线程的CPU放置(格式见Thread::ParseCpus), 线程依次绑定到其中一个CPU;
+         *                 为空时使用配置scheduler.cpu_affinity中该名称的放置, 都没有则不绑定
+         * @attention 调用线程(use_mainThread)不会被绑定
          */
-        Scheduler(size_t threads = 1, bool use_mainThread = true, const std::string &name = "");
+        Scheduler(size_t threads = 1, bool use_mainThread = true, const std::string &name = "",
+                  const std::string &cpus = "");
 
         /**
          * @brief 析构函数
@@ -65,22 +153,54 @@ namespace HPS
          * @brief 调度协程
          * @param[in] fc 协程或函数
          * @param[in] thread 协程执行的线程id,-1标识任意线程
+         * @param[in] priority 优先级
          */
         template <class FiberOrCb>
-        void schedule(FiberOrCb fc, int thread = -1)
+        void schedule(FiberOrCb fc, int thread = -1, Priority priority = PRIORITY_NORMAL)
         {
+            //! 在锁外构造任务, 回调移入任务的内联存储
+            Task ft(std::move(fc), thread);
+            if (!ft.fiber && !ft.cb)
+            {
+                return;
+            }
+            ft.priority = priority;
+            thread = ft.thread;
             bool need_tickle = false;
+            if (m_workStealing)
+            {
+                need_tickle = scheduleWorkStealing(ft);
+            }
+            else
             {
                 MutexType::Lock lock(m_mutex);
-                need_tickle = scheduleNoLock(fc, thread);
+                need_tickle = scheduleNoLock(ft);
             }
 
             if (need_tickle)
             {
-                tickle();
+                if (thread == -1)
+                {
+                    tickle();
+                }
+                else
+                {
+                    tickleThread(thread);
+                }
             }
         }
 
+        /**
+         * @brief 以指定优先级调度协程, 可在任意线程执行
+         * @param[in] fc 协程或函数
+         * @param[in] priority 优先级
+         */
+        template <class FiberOrCb>
+        void schedule(FiberOrCb fc, Priority priority)
+        {
+            schedule(std::move(fc), -1, priority);
+        }
+
         /**
          * @brief 批量调度协程
          * @param[in] begin 协程数组的开始
@@ -90,11 +210,28 @@ namespace HPS
         void schedule(InputIterator begin, InputIterator end)
         {
             bool need_tickle = false;
+            if (m_workStealing)
+            {
+                while (begin != end)
+                {
+                    Task ft(&*begin, -1);
+                    if (ft.fiber || ft.cb)
+                    {
+                        need_tickle = scheduleWorkStealing(ft) || need_tickle;
+                    }
+                    ++begin;
+                }
+            }
+            else
             {
                 MutexType::Lock lock(m_mutex);
                 while (begin != end)
                 {
-                    need_tickle = scheduleNoLock(&*begin, -1) || need_tickle;
+                    Task ft(&*begin, -1);
+                    if (ft.fiber || ft.cb)
+                    {
+                        need_tickle = scheduleNoLock(ft) || need_tickle;
+                    }
                     ++begin;
                 }
             }
@@ -104,15 +241,84 @@ namespace HPS
             }
         }
 
+        /**
+         * @brief 调度非阻塞回调
+         * @details 回调直接在调度协程上执行, 不分配任务协程也不切换上下文;
+         *          回调不得让出(Debug版本中让出会触发断言), 也不得调用会挂起的hook函数
+         * @param[in] cb 回调函数
+         * @param[in] thread 执行的线程id,-1标识任意线程
+         */
+        void scheduleNonBlocking(Fiber::Callback cb, int thread = -1);
+
+        /**
+         * @brief 当前线程是否正在执行非阻塞回调
+         */
+        static bool InNonBlockingTask();
+
         void switchTo(int thread = -1);
         std::ostream &dump(std::ostream &os);
 
+        /**
+         * @brief 是否开启工作窃取调度模式
+         */
+        bool isWorkStealing() const { return m_workStealing; }
+
+        /**
+         * @brief 回调任务是否在共享栈协程上执行
+         */
+        bool isSharedStack() const { return m_sharedStack; }
+
+        /**
+         * @brief 设置回调任务是否在共享栈协程上执行
+         * @details 共享栈协程挂起后只保存实际使用的栈,适合大量空闲连接的场景
+         */
+        void setSharedStack(bool v) { m_sharedStack = v; }
+
+        /**
+         * @brief 返回线程池线程的CPU放置, 未绑定时为空
+         */
+        const std::vector<int> &getCpus() const { return m_cpus; }
+
+        /**
+         * @brief 返回某一优先级任务的排队等待时间统计
+         */
+        QueueDelayStats getQueueDelayStats(Priority priority) const;
+
+        /**
+         * @brief 返回运行统计的快照
+         * @details 无锁读取各线程的计数器, 可被状态接口频繁调用而不影响调度
+         */
+        Metrics getMetrics() const;
+
+        /**
+         * @brief 以key=value的文本输出运行统计
+         */
+        std::ostream &dumpMetrics(std::ostream &os) const;
+
+        /**
+         * @brief 登记一个挂起等待的协程(协程同步原语, 通道), 调度器停止前等待其被唤醒
+         */
+        void addParkedFiber() { ++m_parkedFiberCount; }
+
+        /**
+         * @brief 挂起的协程被唤醒(已重新调度)后注销
+         */
+        void delParkedFiber() { --m_parkedFiberCount; }
+
     protected:
         /**
          * @brief 通知协程调度器有任务了
          */
 
         virtual void tickle();
+
+        /**
+         * @brief 通知指定线程有绑定到它的任务
+         * @details 每个线程独立等待通知, 需要唤醒目标线程
+         * @param[in] thread 线程id
+         */
+        virtual void tickleThread(int thread);
+
         /**
          * @brief 协程调度函数
          */
@@ -138,21 +344,126 @@ namespace HPS
          */
         bool hasIdleThreads() { return m_idleThreadCount > 0; }
 
+        /**
+         * @brief 调度队列或唤醒队列中是否有当前线程可以执行的任务
+         * @details 只读取原子计数, 不加锁, 可在忙轮询中频繁调用; 绑定到其他线程的任务不计入
+         */
+        bool hasReadyTasks();
+
+        /**
+         * @brief 通知一次空闲线程
+         * @details 上一次通知未被空闲线程取走前, 后续通知不再写eventfd
+         * @param[in] fd eventfd
+         * @param[in, out] pending 是否已有未取走的通知
+         * @param[in] force 忽略pending强制写入
+         * @return 是否写了eventfd
+         */
+        static bool TickleEventFd(int fd, std::atomic<bool> &pending, bool force = false);
+
+        /**
+         * @brief 取走eventfd上的通知
+         * @param[in] fd eventfd
+         * @param[in, out] pending 是否已有未取走的通知
+         */
+        static void ClearEventFd(int fd, std::atomic<bool> &pending);
+
+        /**
+         * @brief 返回线程id在线程池中的下标(与工作窃取模式的本地队列下标一致),不在线程池内返回-1
+         * @details 查找构造时分配的定长下标表, 不加锁, 可与start()并发调用
+         */
+        int slotOf(int thread) const;
+
     private:
+        struct Task;
+
         /**
          * @brief 协程调度启动(无锁)
+         * @param[in, out] task 待调度任务, 调用后被移走
+         * @return 是否需要通知调度器
          */
-        template <class FiberOrCb>
-        bool scheduleNoLock(FiberOrCb fc, int thread)
-        {
-            bool need_tickle = m_tasks.empty();
-            Task ft(fc, thread);
-            if (ft.fiber || ft.cb)
-            {
-                m_tasks.push_back(ft);
-            }
-            return need_tickle;
-        }
+        bool scheduleNoLock(Task &task);
+
+        /**
+         * @brief 任务放入调度队列后更新排队计数
+         */
+        void onTaskQueued(const Task &task);
+
+        /**
+         * @brief 任务从调度队列取出后更新排队计数
+         */
+        void onTaskTaken(const Task &task);
+
+        /**
+         * @brief 调度队列是否全部为空(调用者持有m_mutex)
+         */
+        bool tasksEmptyNoLock() const;
+
+        /**
+         * @brief 按加权轮转给出本次取任务时各优先级的检查顺序
+         * @details 本轮还有配额的优先级在前, 同组内高优先级在前
+         * @param[out] order 优先级顺序
+         */
+        void pickOrder(int *order) const;
+
+        struct ThreadMetrics;
+
+        /**
+         * @brief 取到任务后扣除其优先级的配额, 记录排队等待时间
+         * @param[in] task 取到的任务
+         * @param[in, out] metrics 当前线程的统计
+         * @param[in] now 当前时间(微秒)
+         */
+        void onTaskPicked(const Task &task, ThreadMetrics &metrics, uint64_t now);
+
+        /**
+         * @brief 工作窃取模式下的协程调度
+         * @details 指定线程的任务放入目标线程的绑定队列,
+         *          线程池内调度的任务放入本线程的本地队列,其余放入全局注入队列
+         * @param[in, out] task 待调度任务, 调用后被移走
+         * @return 是否需要通知调度器
+         */
+        bool scheduleWorkStealing(Task &task);
+
+        /**
+         * @brief 调度已构造的任务
+         */
+        void scheduleTask(Task &task);
+
+        /**
+         * @brief 放入全局注入队列
+         * @return 是否需要通知调度器
+         */
+        bool scheduleGlobal(Task &task);
+
+        /**
+         * @brief 重新调度主动让出(READY)的协程
+         */
+        void scheduleReady(Fiber::ptr fiber);
+
+        /**
+         * @brief 从全局注入队列取任务
+         * @param[out] task 取到的任务
+         * @param[out] tickle_me 是否还有任务需要唤醒其他线程
+         * @param[in] priority 只取该优先级的任务, -1按加权轮转的顺序查找
+         */
+        bool popGlobal(Task &task, bool &tickle_me, int priority = -1);
+
+        /**
+         * @brief 从其他线程本地队列头部窃取任务
+         * @param[in] slot 本线程本地队列下标, 线程池外为-1
+         * @param[out] task 取到的任务
+         * @param[out] tickle_me 是否有其他线程的绑定任务需要唤醒
+         */
+        bool stealTask(int slot, Task &task, bool &tickle_me);
+
+        /**
+         * @brief 工作窃取模式下取任务
+         * @details 依次查找本线程绑定队列,本地队列,全局注入队列,最后从其他线程窃取
+         * @param[out] task 取到的任务
+         * @param[out] tickle_me 是否有其他线程的任务需要唤醒
+         * @return 是否取到任务,取到时m_activeThreadCount已增加
+         */
+        bool nextTaskWorkStealing(Task &task, bool &tickle_me);
 
     private:
         /**
@@ -163,9 +474,15 @@ namespace HPS
             /// 协程
             Fiber::ptr fiber;
             /// 协程执行函数
-            std::function<void()> cb;
+            Fiber::Callback cb;
             /// 线程id
             int thread;
+            /// 回调是否非阻塞, 非阻塞回调直接在调度协程上执行
+            bool nonblocking = false;
+            /// 优先级
+            int priority = PRIORITY_NORMAL;
+            /// 入队时间(微秒), 用于统计排队等待时间
+            uint64_t enqueued = 0;
 
             /**
              * @brief 构造函数
@@ -173,8 +490,9 @@ namespace HPS
              * @param[in] thr 线程id
              */
             Task(Fiber::ptr f, int thr)
-                : fiber(f), thread(thr)
+                : fiber(std::move(f)), thread(thr), enqueued(GetCurrentUS())
             {
+                pinSharedStack();
             }
 
             /**
@@ -184,31 +502,37 @@ namespace HPS
              * @post *f = nullptr
              */
             Task(Fiber::ptr *f, int thr)
-                : thread(thr)
+                : thread(thr), enqueued(GetCurrentUS())
             {
                 fiber.swap(*f);
+                pinSharedStack();
             }
 
             /**
              * @brief 构造函数
-             * @param[in] f 协程执行函数
+             * @param[in] f 协程执行函数指针
              * @param[in] thr 线程id
+             * @post *f = nullptr
              */
-            Task(std::function<void()> f, int thr)
-                : cb(f), thread(thr)
+            Task(std::function<void()> *f, int thr)
+                : cb(std::move(*f)), thread(thr), enqueued(GetCurrentUS())
             {
+                *f = nullptr;
             }
 
             /**
              * @brief 构造函数
-             * @param[in] f 协程执行函数指针
+             * @param[in] f 可调用对象, 捕获较小时内联存放
              * @param[in] thr 线程id
-             * @post *f = nullptr
              */
-            Task(std::function<void()> *f, int thr)
-                : thread(thr)
+            template <class F, class = typename std::enable_if<
+                                   !std::is_same<typename std::decay<F>::type, Task>::value &&
+                                   !std::is_same<typename std::decay<F>::type, Fiber::ptr>::value &&
+                                   !std::is_same<typename std::decay<F>::type, Fiber::ptr *>::value &&
+                                   !std::is_same<typename std::decay<F>::type, std::function<void()> *>::value>::type>
+            Task(F &&f, int thr)
+                : cb(std::forward<F>(f)), thread(thr), enqueued(GetCurrentUS())
             {
-                cb.swap(*f);
             }
 
             /**
@@ -219,6 +543,17 @@ namespace HPS
             {
             }
 
+            /**
+             * @brief 已在共享栈上运行过的协程只能回到绑定的线程上执行
+             */
+            void pinSharedStack()
+            {
+                if (thread == -1 && fiber && fiber->isSharedStack())
+                {
+                    thread = fiber->getBoundThread();
+                }
+            }
+
             /**
              * @brief 重置数据
              */
@@ -227,16 +562,297 @@ namespace HPS
                 fiber = nullptr;
                 cb = nullptr;
                 thread = -1;
+                nonblocking = false;
+                priority = PRIORITY_NORMAL;
+                enqueued = 0;
+            }
+        };
+
+        /**
+         * @brief 任务队列
+         * @details 出队的链表节点放入空闲链表, 入队时通过splice复用,
+         *          稳定状态下入队出队不分配内存
+         */
+        class TaskQueue
+        {
+        public:
+            typedef std::list<Task>::iterator iterator;
+
+            iterator begin() { return m_tasks.begin(); }
+            iterator end() { return m_tasks.end(); }
+            bool empty() const { return m_tasks.empty(); }
+            size_t size() const { return m_tasks.size(); }
+            Task &front() { return m_tasks.front(); }
+            Task &back() { return m_tasks.back(); }
+
+            /**
+             * @brief 任务放入队尾
+             * @param[in, out] task 任务, 调用后被移走
+             */
+            void push_back(Task &&task)
+            {
+                if (m_free.empty())
+                {
+                    m_tasks.push_back(std::move(task));
+                    return;
+                }
+                m_tasks.splice(m_tasks.end(), m_free, m_free.begin());
+                m_tasks.back() = std::move(task);
+            }
+
+            /**
+             * @brief 取出任务, 节点回收到空闲链表
+             * @param[in] it 任务位置
+             * @param[out] task 取出的任务
+             */
+            void take(iterator it, Task &task)
+            {
+                task = std::move(*it);
+                if (m_free.size() < MAX_FREE_NODES)
+                {
+                    m_free.splice(m_free.begin(), m_tasks, it);
+                }
+                else
+                {
+                    m_tasks.erase(it);
+                }
             }
+
+            void pop_front(Task &task) { take(m_tasks.begin(), task); }
+            void pop_back(Task &task) { take(std::prev(m_tasks.end()), task); }
+
+        private:
+            /// 空闲链表保留的最大节点数量
+            static const size_t MAX_FREE_NODES = 4096;
+            /// 任务
+            std::list<Task> m_tasks;
+            /// 已出队的空闲节点, 其中的任务均为空
+            std::list<Task> m_free;
+        };
+
+        /**
+         * @brief 唤醒队列中节点的类型
+         */
+        enum WakeTag
+        {
+            /// 节点为Fiber本身
+            WAKE_FIBER = 1,
+            /// 节点为CallbackNode
+            WAKE_CALLBACKS = 2,
+        };
+
+        /**
+         * @brief 唤醒队列中承载回调函数的节点
+         */
+        struct CallbackNode : public MpscNode
+        {
+            std::vector<Task> tasks;
+        };
+
+    public:
+        /**
+         * @brief 批量唤醒任务
+         * @details 协程以侵入式节点直接链接,回调函数合并到一个节点,
+         *          submit()时通过无锁唤醒队列一次发布
+         */
+        class TaskBatch : Noncopyable
+        {
+            friend class Scheduler;
+
+        public:
+            /**
+             * @brief 构造函数
+             * @param[in] scheduler 任务提交到的调度器
+             */
+            TaskBatch(Scheduler *scheduler)
+                : m_scheduler(scheduler)
+            {
+            }
+
+            /**
+             * @brief 析构函数,未提交的任务自动提交
+             */
+            ~TaskBatch()
+            {
+                m_scheduler->submit(*this);
+            }
+
+            /**
+             * @brief 返回任务提交到的调度器
+             */
+            Scheduler *getScheduler() const { return m_scheduler; }
+
+            /**
+             * @brief 添加待唤醒协程
+             * @param[in, out] fiber 协程, 调用后置空
+             * @param[in] priority 优先级
+             */
+            void add(Fiber::ptr &fiber, Priority priority = PRIORITY_NORMAL);
+
+            /**
+             * @brief 添加回调函数
+             * @param[in, out] cb 回调函数, 调用后置空
+             * @param[in] priority 优先级
+             */
+            void add(std::function<void()> &cb, Priority priority = PRIORITY_NORMAL);
+
+            /**
+             * @brief 添加非阻塞回调函数, 在调度协程上直接执行
+             * @param[in, out] cb 回调函数, 调用后置空
+             */
+            void addNonBlocking(std::function<void()> &cb);
+
+            /**
+             * @brief 任务数量
+             */
+            size_t size() const { return m_count; }
+
+            /**
+             * @brief 是否为空
+             */
+            bool empty() const { return m_count == 0; }
+
+        private:
+            /**
+             * @brief 链接一个节点
+             */
+            void link(MpscNode *node);
+
+        private:
+            /// 提交的调度器
+            Scheduler *m_scheduler;
+            /// 链表头
+            MpscNode *m_first = nullptr;
+            /// 链表尾
+            MpscNode *m_last = nullptr;
+            /// 回调函数节点
+            CallbackNode *m_callbacks = nullptr;
+            /// 任务数量
+            size_t m_count = 0;
+        };
+
+        /**
+         * @brief 通过无锁唤醒队列一次发布批量任务
+         * @post batch.empty() == true
+         */
+        void submit(TaskBatch &batch);
+
+    private:
+        /**
+         * @brief 取出唤醒队列中的任务放入调度队列
+         */
+        void drainWakeQueue();
+
+        /**
+         * @brief 工作窃取模式下每个线程的任务队列
+         */
+        struct WorkQueue
+        {
+            typedef Spinlock MutexType;
+            /// 队列锁, 本线程在尾部存取, 窃取者从头部取
+            MutexType mutex;
+            /// 可被窃取的任务
+            TaskQueue tasks;
+            /// 绑定到本线程的任务,不可被窃取
+            TaskQueue pinned;
+            /// 队列中任务数量(无锁读取)
+            std::atomic<size_t> size = {0};
         };
 
     private:
         /// Mutex
-        MutexType m_mutex;
+        mutable MutexType m_mutex;
         /// 线程池
         std::vector<Thread::ptr> m_threads;
-        /// 待执行的协程队列
-        std::list<Task> m_tasks;
+        /// 每个优先级的待执行协程队列(工作窃取模式下为全局注入队列)
+        TaskQueue m_tasks[PRIORITY_COUNT];
+        /// 工作窃取模式下全局注入队列中各优先级的任务数量(无锁读取)
+        std::atomic<size_t> m_globalTasks[PRIORITY_COUNT];
+        /// 各优先级的加权轮转权重
+        int m_weights[PRIORITY_COUNT];
+
+        /**
+         * @brief 每个线程的运行计数器
+         * @details 只由所属线程写入(无锁前缀的读改写), 其他线程可随时无锁读取
+         */
+        struct ThreadMetrics
+        {
+            ThreadMetrics();
+
+            /**
+             * @brief 单写者累加
+             */
+            static void Add(std::atomic<uint64_t> &counter, uint64_t v)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+            }
+
+            std::atomic<uint64_t> executed;
+            std::atomic<uint64_t> run_us;
+            std::atomic<uint64_t> idle_us;
+            std::atomic<uint64_t> switches;
+            /// 各优先级的排队等待时间
+            std::atomic<uint64_t> delay_count[PRIORITY_COUNT];
+            std::atomic<uint64_t> delay_total_us[PRIORITY_COUNT];
+            std::atomic<uint64_t> delay_max_us[PRIORITY_COUNT];
+            /// 排队等待时间直方图
+            std::atomic<uint64_t> delay_hist[DELAY_BUCKETS];
+            /// 避免与相邻线程的计数器伪共享
+            char padding[64];
+        };
+        /// 每个线程的计数器, 下标与m_threadIds一致
+        std::vector<std::unique_ptr<ThreadMetrics>> m_threadMetrics;
+        /// 工作窃取模式下每个线程的本地队列,下标与m_threadIds一致
+        std::vector<std::unique_ptr<WorkQueue>> m_workQueues;
+        /// 所有调度队列中的任务数量
+        std::atomic<size_t> m_queuedTaskCount = {0};
+        /// 入队(调度队列或唤醒队列)的任务数量, 唤醒队列转入和放回队列不重复计数
+        std::atomic<uint64_t> m_scheduledCount = {0};
+        /// 调度队列中可由任意线程执行的任务数量
+        std::atomic<size_t> m_anyThreadTaskCount = {0};
+
+        /**
+         * @brief 绑定到一个线程的排队任务数量, 独占缓存行
+         */
+        struct PinnedCount
+        {
+            std::atomic<size_t> count = {0};
+            char padding[64];
+        };
+        /// 绑定到各线程的排队任务数量, 下标与m_threadIds一致
+        std::vector<std::unique_ptr<PinnedCount>> m_pinnedTaskCounts;
+        /// 无锁唤醒队列
+        MpscQueue m_wakeQueue;
+        /// 唤醒队列中的任务数量
+        std::atomic<size_t> m_wakeCount = {0};
+        /// 唤醒队列消费者锁
+        std::atomic_flag m_wakeConsumer = ATOMIC_FLAG_INIT;
+
+        /**
+         * @brief 空闲线程等待的通知, 独占缓存行
+         */
+        struct IdleWaker
+        {
+            /// 通知用的eventfd
+            int fd = -1;
+            /// 是否有未取走的通知
+            std::atomic<bool> tickled = {false};
+            /// 是否阻塞等待通知
+            std::atomic<bool> idle = {false};
+            char padding[64];
+        };
+        /// 线程下标表, 构造时按线程数分配且不再改变, 未启动的下标为-1
+        std::unique_ptr<std::atomic<int>[]> m_slotThreads;
+        /// 线程下标表的长度
+        size_t m_slotCount = 0;
+        /// 每个线程的空闲通知, 下标与m_threadIds一致
+        std::vector<std::unique_ptr<IdleWaker>> m_idleWakers;
+        /// 下一次通知从哪个线程开始查找
+        std::atomic<size_t> m_idleIndex = {0};
+        /// 是否开启工作窃取模式
+        bool m_workStealing = false;
+        /// 回调任务是否使用共享栈协程
+        bool m_sharedStack = false;
         /// use_mainThread为true时有效,调度协程
         Fiber::ptr m_rootFiber;
         /// 协程调度器名称
@@ -245,12 +861,18 @@ namespace HPS
     protected:
         /// 协程下的线程id数组
         std::vector<int> m_threadIds;
+        /// 与m_threadIds对应的线程绑定的CPU, -1为未绑定
+        std::vector<int> m_threadCpus;
+        /// 线程池线程的CPU放置
+        std::vector<int> m_cpus;
         /// 线程数量
         size_t m_threadCount = 0;
         /// 工作线程数量
         std::atomic<size_t> m_activeThreadCount = {0};
         /// 空闲线程数量
         std::atomic<size_t> m_idleThreadCount = {0};
+        /// 挂起等待唤醒的协程数量
+        std::atomic<size_t> m_parkedFiberCount = {0};
         /// 是否正在停止
         bool m_stopping = true;
         /// 是否自动停止
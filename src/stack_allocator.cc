@@ -0,0 +1,254 @@
+#include "stack_allocator.h"
+#include "config.h"
+#include "log.h"
+#include "macro.h"
+#include "mutex.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <unordered_map>
+
+namespace HPS
+{
+
+    static Logger::ptr g_logger = LOG_NAME("system");
+
+    static ConfigVar<uint64_t>::ptr g_fiber_stack_cache_bytes =
+        Config::Lookup<uint64_t>("fiber.stack_cache_bytes", 4 * 1024 * 1024, "fiber stack cache bytes per thread");
+
+    static ConfigVar<bool>::ptr g_fiber_stack_registry =
+        Config::Lookup<bool>("fiber.stack_registry", false, "track mapped fiber stacks for resident memory diagnostics");
+
+    static std::atomic<uint64_t> s_mapped_count{0};
+    static std::atomic<uint64_t> s_mapped_bytes{0};
+    static std::atomic<uint64_t> s_inuse_count{0};
+    static std::atomic<uint64_t> s_cached_count{0};
+    static std::atomic<uint64_t> s_cached_bytes{0};
+    static std::atomic<uint64_t> s_reuse_count{0};
+
+    static size_t PageSize()
+    {
+        static size_t s_page_size = sysconf(_SC_PAGESIZE);
+        return s_page_size;
+    }
+
+    static size_t RoundToPage(size_t size)
+    {
+        size_t page = PageSize();
+        return (size + page - 1) & ~(page - 1);
+    }
+
+    /**
+     * @brief 已映射栈的登记表,只用于诊断
+     * @details 开启fiber.stack_registry后才在mmap时登记,
+     *          关闭时映射和释放栈都不经过全局锁
+     */
+    class StackRegistry
+    {
+    public:
+        typedef Mutex MutexType;
+
+        void add(void *vp, size_t size)
+        {
+            MutexType::Lock lock(m_mutex);
+            if (m_stacks.emplace(vp, size).second)
+            {
+                ++m_size;
+            }
+        }
+
+        void del(void *vp)
+        {
+            //! 从未登记过时不加锁
+            if (m_size == 0)
+            {
+                return;
+            }
+            MutexType::Lock lock(m_mutex);
+            m_size -= m_stacks.erase(vp);
+        }
+
+        uint64_t resident()
+        {
+            MutexType::Lock lock(m_mutex);
+            uint64_t total = 0;
+            for (auto &i : m_stacks)
+            {
+                total += StackAllocator::GetResidentBytes(i.first, i.second);
+            }
+            return total;
+        }
+
+    private:
+        MutexType m_mutex;
+        std::unordered_map<void *, size_t> m_stacks;
+        /// 登记的栈数量
+        std::atomic<size_t> m_size{0};
+    };
+
+    static StackRegistry &GetRegistry()
+    {
+        static StackRegistry *s_registry = new StackRegistry;
+        return *s_registry;
+    }
+
+    static void *MapStack(size_t size)
+    {
+        size_t page = PageSize();
+        void *base = mmap(nullptr, size + page, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            LOG_ERROR(g_logger) << "mmap fiber stack size=" << size
+                                << " errno=" << errno << " errstr=" << strerror(errno);
+            throw std::bad_alloc();
+        }
+        //! 栈向低地址增长,最低的一页作为保护页
+        if (mprotect(base, page, PROT_NONE))
+        {
+            LOG_ERROR(g_logger) << "mprotect fiber stack guard errno=" << errno
+                                << " errstr=" << strerror(errno);
+        }
+        void *vp = (char *)base + page;
+        ++s_mapped_count;
+        s_mapped_bytes += size;
+        if (g_fiber_stack_registry->getValue())
+        {
+            GetRegistry().add(vp, size);
+        }
+        return vp;
+    }
+
+    static void UnmapStack(void *vp, size_t size)
+    {
+        size_t page = PageSize();
+        GetRegistry().del(vp);
+        --s_mapped_count;
+        s_mapped_bytes -= size;
+        if (munmap((char *)vp - page, size + page))
+        {
+            LOG_ERROR(g_logger) << "munmap fiber stack errno=" << errno
+                                << " errstr=" << strerror(errno);
+        }
+    }
+
+    /**
+     * @brief 线程本地的空闲栈链表,线程退出时归还系统
+     */
+    //! 线程退出时缓存已析构,之后(其他thread_local析构中)释放的栈直接归还系统
+    static thread_local bool t_stack_cache_closed = false;
+
+    struct StackCache
+    {
+        std::vector<std::pair<void *, size_t>> stacks;
+        uint64_t bytes = 0;
+
+        ~StackCache()
+        {
+            clear();
+            t_stack_cache_closed = true;
+        }
+
+        void clear()
+        {
+            for (auto &i : stacks)
+            {
+                UnmapStack(i.first, i.second);
+            }
+            s_cached_count -= stacks.size();
+            s_cached_bytes -= bytes;
+            stacks.clear();
+            bytes = 0;
+        }
+    };
+
+    static thread_local StackCache t_stack_cache;
+
+    void *StackAllocator::Alloc(size_t size)
+    {
+        size = RoundToPage(size);
+        auto &stacks = t_stack_cache.stacks;
+        //! 从尾部查找,最近释放的栈更可能在缓存中
+        for (size_t i = stacks.size(); i > 0; --i)
+        {
+            if (stacks[i - 1].second == size)
+            {
+                void *vp = stacks[i - 1].first;
+                stacks.erase(stacks.begin() + (i - 1));
+                t_stack_cache.bytes -= size;
+                --s_cached_count;
+                s_cached_bytes -= size;
+                ++s_reuse_count;
+                ++s_inuse_count;
+                return vp;
+            }
+        }
+        //! 映射失败时抛出异常, 成功后才计入使用中
+        void *vp = MapStack(size);
+        ++s_inuse_count;
+        return vp;
+    }
+
+    void StackAllocator::Dealloc(void *vp, size_t size)
+    {
+        if (!vp)
+        {
+            return;
+        }
+        size = RoundToPage(size);
+        --s_inuse_count;
+        if (!t_stack_cache_closed && t_stack_cache.bytes + size <= g_fiber_stack_cache_bytes->getValue())
+        {
+            t_stack_cache.stacks.push_back(std::make_pair(vp, size));
+            t_stack_cache.bytes += size;
+            ++s_cached_count;
+            s_cached_bytes += size;
+            return;
+        }
+        UnmapStack(vp, size);
+    }
+
+    StackAllocator::Stats StackAllocator::GetStats()
+    {
+        Stats stats;
+        stats.mapped_count = s_mapped_count;
+        stats.mapped_bytes = s_mapped_bytes;
+        stats.inuse_count = s_inuse_count;
+        stats.cached_count = s_cached_count;
+        stats.cached_bytes = s_cached_bytes;
+        stats.reuse_count = s_reuse_count;
+        return stats;
+    }
+
+    size_t StackAllocator::GetResidentBytes(void *vp, size_t size)
+    {
+        size_t page = PageSize();
+        size = RoundToPage(size);
+        std::vector<unsigned char> vec(size / page);
+        if (mincore(vp, size, &vec[0]))
+        {
+            return 0;
+        }
+        size_t resident = 0;
+        for (auto i : vec)
+        {
+            if (i & 1)
+            {
+                resident += page;
+            }
+        }
+        return resident;
+    }
+
+    uint64_t StackAllocator::GetTotalResidentBytes()
+    {
+        return GetRegistry().resident();
+    }
+
+    void StackAllocator::Trim()
+    {
+        t_stack_cache.clear();
+    }
+
+}
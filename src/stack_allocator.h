@@ -0,0 +1,79 @@
+#ifndef __STACK_ALLOCATOR_H__
+#define __STACK_ALLOCATOR_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace HPS
+{
+
+    /**
+     * @brief 协程栈分配器
+     * @details 协程栈通过mmap分配,栈底有一个PROT_NONE保护页,栈溢出时直接SIGSEGV
+     *          而不是破坏堆内存;释放的栈放入线程本地空闲链表以便复用,
+     *          每个线程缓存的字节数由fiber.stack_cache_bytes限制
+     */
+    class StackAllocator
+    {
+    public:
+        /**
+         * @brief 栈内存统计
+         */
+        struct Stats
+        {
+            /// 已映射的栈数量(使用中+缓存)
+            uint64_t mapped_count = 0;
+            /// 已映射的栈字节数(不含保护页)
+            uint64_t mapped_bytes = 0;
+            /// 使用中的栈数量
+            uint64_t inuse_count = 0;
+            /// 所有线程缓存中的栈数量
+            uint64_t cached_count = 0;
+            /// 所有线程缓存中的栈字节数
+            uint64_t cached_bytes = 0;
+            /// 复用缓存的分配次数
+            uint64_t reuse_count = 0;
+        };
+
+        /**
+         * @brief 分配协程栈
+         * @param[in] size 栈大小,向上取整到页大小
+         * @return 可用栈空间的起始地址(保护页之上)
+         */
+        static void *Alloc(size_t size);
+
+        /**
+         * @brief 释放协程栈,放入线程本地缓存或归还系统
+         * @param[in] vp Alloc返回的地址
+         * @param[in] size 分配时的栈大小
+         */
+        static void Dealloc(void *vp, size_t size);
+
+        /**
+         * @brief 返回统计信息
+         */
+        static Stats GetStats();
+
+        /**
+         * @brief 返回一个栈实际驻留内存的字节数(mincore)
+         * @param[in] vp Alloc返回的地址
+         * @param[in] size 分配时的栈大小
+         */
+        static size_t GetResidentBytes(void *vp, size_t size);
+
+        /**
+         * @brief 返回所有已映射栈实际驻留内存的字节数
+         * @attention 对每个栈做一次mincore系统调用,只用于诊断;
+         *            只统计开启fiber.stack_registry之后映射的栈
+         */
+        static uint64_t GetTotalResidentBytes();
+
+        /**
+         * @brief 释放当前线程缓存的全部栈
+         */
+        static void Trim();
+    };
+
+}
+
+#endif
@@ -2,6 +2,10 @@
 #include "log.h"
 #include "util.h"
 
+#include <fstream>
+#include <sched.h>
+#include <stdlib.h>
+
 namespace HPS
 {
     //! 当前线程指针
@@ -33,9 +37,106 @@ namespace HPS
         }
         t_thread_name = name;
     }
+    //! 解析"0-3,8"形式的CPU列表
+    static std::vector<int> ParseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        size_t pos = 0;
+        while (pos < list.size())
+        {
+            size_t end = list.find(',', pos);
+            if (end == std::string::npos)
+            {
+                end = list.size();
+            }
+            std::string item = list.substr(pos, end - pos);
+            pos = end + 1;
+            if (item.empty())
+            {
+                continue;
+            }
+            char *next = nullptr;
+            long first = strtol(item.c_str(), &next, 10);
+            long last = first;
+            if (*next == '-')
+            {
+                last = strtol(next + 1, &next, 10);
+            }
+            if (first < 0 || last < first || (*next && *next != '\n'))
+            {
+                LOG_ERROR(g_logger) << "invalid cpu list: " << list;
+                return std::vector<int>();
+            }
+            for (long i = first; i <= last; ++i)
+            {
+                cpus.push_back(i);
+            }
+        }
+        return cpus;
+    }
+
+    //! 读取sysfs中的CPU列表文件
+    static std::vector<int> ReadCpuList(const std::string &path)
+    {
+        std::ifstream ifs(path);
+        std::string list;
+        if (!ifs || !std::getline(ifs, list))
+        {
+            return std::vector<int>();
+        }
+        return ParseCpuList(list);
+    }
+
+    std::vector<int> Thread::ParseCpus(const std::string &spec)
+    {
+        if (spec.compare(0, 5, "node:") != 0)
+        {
+            return ParseCpuList(spec);
+        }
+        int node = atoi(spec.c_str() + 5);
+        std::vector<int> node_cpus = ReadCpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (node_cpus.empty())
+        {
+            LOG_ERROR(g_logger) << "numa node " << node << " has no cpus, spec=" << spec;
+            return node_cpus;
+        }
+        //! 同一物理核的超线程只保留编号最小的一个
+        std::vector<int> cpus;
+        for (int cpu : node_cpus)
+        {
+            std::vector<int> siblings = ReadCpuList("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list");
+            if (siblings.empty() || siblings[0] == cpu)
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    bool Thread::SetAffinity(const std::vector<int> &cpus)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int rt = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rt)
+        {
+            LOG_ERROR(g_logger) << "pthread_setaffinity_np fail, rt=" << rt
+                                << " name=" << t_thread_name;
+            return false;
+        }
+        return true;
+    }
+
     //# 1) 创建线程
-    Thread::Thread(std::function<void()> cb, const std::string &name)
-        : m_cb(cb), m_name(name)
+    Thread::Thread(std::function<void()> cb, const std::string &name, const std::vector<int> &cpus)
+        : m_cb(cb), m_name(name), m_cpus(cpus)
     {
         if (name.empty())
         {
@@ -59,6 +160,11 @@ namespace HPS
         t_thread_name = thread->m_name;
         thread->m_id = HPS::GetThreadId();
         pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
+        //! 在线程函数执行前绑核, 之后分配的内存优先落在对应的NUMA节点上
+        if (!thread->m_cpus.empty() && !SetAffinity(thread->m_cpus))
+        {
+            thread->m_cpus.clear();
+        }
 
         std::function<void()> cb;
         cb.swap(thread->m_cb);
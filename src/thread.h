@@ -3,6 +3,9 @@
 
 #include "mutex.h"
 
+#include <string>
+#include <vector>
+
 namespace HPS
 {
 
@@ -19,8 +22,9 @@ namespace HPS
          * @brief 构造函数
          * @param[in] cb 线程执行函数
          * @param[in] name 线程名称
+         * @param[in] cpus 线程可运行的CPU, 为空不限制
          */
-        Thread(std::function<void()> cb, const std::string &name);
+        Thread(std::function<void()> cb, const std::string &name, const std::vector<int> &cpus = std::vector<int>());
 
         /**
          * @brief 析构函数
@@ -37,6 +41,11 @@ namespace HPS
          */
         const std::string &getName() const { return m_name; }
 
+        /**
+         * @brief 线程绑定的CPU, 未绑定或绑定失败为空
+         */
+        const std::vector<int> &getCpus() const { return m_cpus; }
+
         /**
          * @brief 等待线程执行完成
          */
@@ -58,6 +67,22 @@ namespace HPS
          */
         static void SetName(const std::string &name);
 
+        /**
+         * @brief 设置当前线程可运行的CPU
+         * @param[in] cpus CPU编号
+         * @return 是否成功
+         */
+        static bool SetAffinity(const std::vector<int> &cpus);
+
+        /**
+         * @brief 解析CPU放置配置
+         * @details "0-3,8": CPU列表;
+         *          "node:N": NUMA节点N上的CPU, 每个物理核只取一个逻辑CPU;
+         *          空串或无法解析时返回空
+         * @param[in] spec 配置字符串
+         */
+        static std::vector<int> ParseCpus(const std::string &spec);
+
     private:
         /**
          * @brief 线程执行函数
@@ -73,6 +98,8 @@ namespace HPS
         std::function<void()> m_cb;
         /// 线程名称
         std::string m_name;
+        /// 线程绑定的CPU
+        std::vector<int> m_cpus;
         /// 信号量
         Semaphore m_semaphore;
     };
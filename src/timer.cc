@@ -1,9 +1,44 @@
 #include "timer.h"
 #include "util.h"
+#include "config.h"
+
+#include <algorithm>
 
 //# 实用方法
 namespace HPS
 {
+    static ConfigVar<std::string>::ptr g_timer_engine =
+        Config::Lookup<std::string>("timer.engine", "set", "timer manager engine: set or wheel");
+
+    /// 时间轮最底层: 256个1毫秒的槽位
+    static const int WHEEL_ROOT_BITS = 8;
+    static const uint64_t WHEEL_ROOT_SIZE = 1ull << WHEEL_ROOT_BITS;
+    static const uint64_t WHEEL_ROOT_MASK = WHEEL_ROOT_SIZE - 1;
+    /// 时间轮高层: 每层64个槽位, 共4层, 覆盖2^32毫秒
+    static const int WHEEL_LEVEL_BITS = 6;
+    static const uint64_t WHEEL_LEVEL_SIZE = 1ull << WHEEL_LEVEL_BITS;
+    static const uint64_t WHEEL_LEVEL_MASK = WHEEL_LEVEL_SIZE - 1;
+    static const int WHEEL_LEVELS = 4;
+    static const uint64_t WHEEL_MAX_DELTA = (1ull << (WHEEL_ROOT_BITS + WHEEL_LEVELS * WHEEL_LEVEL_BITS)) - 1;
+
+    //! 执行时间(微秒)对应的时间轮刻度(毫秒), 向上取整保证定时器不会提前执行
+    static inline uint64_t WheelTick(uint64_t us)
+    {
+        return (us + 999) / 1000;
+    }
+
+    //! 第level层(从1开始)在时间轮数组中的起始下标
+    static inline size_t WheelLevelBase(int level)
+    {
+        return WHEEL_ROOT_SIZE + (level - 1) * WHEEL_LEVEL_SIZE;
+    }
+
+    //! 第level层(从1开始)的槽位下标
+    static inline size_t WheelLevelIndex(uint64_t ms, int level)
+    {
+        return (ms >> (WHEEL_ROOT_BITS + (level - 1) * WHEEL_LEVEL_BITS)) & WHEEL_LEVEL_MASK;
+    }
+
     //! 按定时器执行时间排序
     bool Timer::Comparator::operator()(const Timer::ptr &lhs, const Timer::ptr &rhs) const
     {
@@ -32,12 +67,12 @@ namespace HPS
 
     bool Timer::cancel()
     {
+        Timer::ptr self = shared_from_this();
         TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
         if (m_cb)
         {
             m_cb = nullptr;
-            auto it = m_manager->m_timers.find(shared_from_this());
-            m_manager->m_timers.erase(it);
+            m_manager->eraseTimer(self);
             return true;
         }
         return false;
@@ -45,51 +80,50 @@ namespace HPS
 
     bool Timer::refresh()
     {
+        Timer::ptr self = shared_from_this();
         TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
         if (!m_cb)
         {
             return false;
         }
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it == m_manager->m_timers.end())
+        if (!m_manager->eraseTimer(self))
         {
             return false;
         }
-        m_manager->m_timers.erase(it);
-        m_next = HPS::GetCurrentMS() + m_ms;
-        m_manager->m_timers.insert(shared_from_this());
+        m_next = HPS::GetMonotonicUS() + m_us;
+        m_manager->insertTimer(self);
         return true;
     }
 
     bool Timer::reset(uint64_t ms, bool from_now)
     {
-        if (ms == m_ms && !from_now)
+        uint64_t us = ms * 1000;
+        if (us == m_us && !from_now)
         {
             return true;
         }
+        Timer::ptr self = shared_from_this();
         TimerManager::RWMutexType::WriteLock lock(m_manager->m_mutex);
         if (!m_cb)
         {
             return false;
         }
-        auto it = m_manager->m_timers.find(shared_from_this());
-        if (it == m_manager->m_timers.end())
+        if (!m_manager->eraseTimer(self))
         {
             return false;
         }
-        m_manager->m_timers.erase(it);
         uint64_t start = 0;
         if (from_now)
         {
-            start = HPS::GetCurrentMS();
+            start = HPS::GetMonotonicUS();
         }
         else
         {
-            start = m_next - m_ms;
+            start = m_next - m_us;
         }
-        m_ms = ms;
-        m_next = start + m_ms;
-        m_manager->addTimer(shared_from_this(), lock);
+        m_us = us;
+        m_next = start + m_us;
+        m_manager->addTimer(self, lock);
         return true;
     }
     
@@ -104,36 +138,375 @@ namespace HPS
         }
     }
 
-    Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond, bool recurring)
+    Timer::ptr TimerManager::addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond,
+                                               bool recurring, bool nonblocking)
     {
-        return addTimer(ms, std::bind(&OnTimer, weak_cond, cb), recurring);
+        return addTimer(ms, std::bind(&OnTimer, weak_cond, cb), recurring, nonblocking);
     }
 
     uint64_t TimerManager::getNextTimer()
     {
+        uint64_t next_us = getNextTimerUs();
+        return next_us == ~0ull ? ~0ull : (next_us + 999) / 1000;
+    }
+
+    uint64_t TimerManager::getNextTimerUs()
+    {
+        if (m_useWheel)
+        {
+            //! 记录调度器下次检查的时间, 供插入时判断是否需要通知
+            RWMutexType::WriteLock lock(m_mutex);
+            m_tickled = false;
+            if (m_wheelCount == 0)
+            {
+                m_wheelDeadline = ~0ull;
+                return ~0ull;
+            }
+            m_wheelDeadline = wheelNextExpire();
+            uint64_t now_us = HPS::GetMonotonicUS();
+            return now_us >= m_wheelDeadline * 1000 ? 0 : m_wheelDeadline * 1000 - now_us;
+        }
         RWMutexType::ReadLock lock(m_mutex);
         m_tickled = false;
-        if (m_timers.empty())
+        uint64_t next = setNextExpire();
+        if (next == ~0ull)
         {
             return ~0ull;
         }
 
-        const Timer::ptr &next = *m_timers.begin();
-        uint64_t now_ms = HPS::GetCurrentMS();
-        if (now_ms >= next->m_next)
+        uint64_t now_us = HPS::GetMonotonicUS();
+        if (now_us >= next)
         {
             return 0;
         }
         else
         {
-            return next->m_next - now_ms;
+            return next - now_us;
         }
     }
 
     bool TimerManager::hasTimer()
     {
         RWMutexType::ReadLock lock(m_mutex);
-        return !m_timers.empty();
+        return m_useWheel ? m_wheelCount > 0 : setNextExpire() != ~0ull;
+    }
+
+    void TimerManager::armTimer(TimerNode *node, uint64_t ms, TimerNode::Callback cb)
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        if (node->m_armed)
+        {
+            eraseNode(node);
+        }
+        node->m_nodeCb = cb;
+        node->m_next = HPS::GetMonotonicUS() + ms * 1000;
+        bool at_front = insertNode(node) && !m_tickled;
+        if (at_front)
+        {
+            m_tickled = true;
+        }
+        lock.unlock();
+
+        if (at_front)
+        {
+            onTimerInsertedAtFront();
+        }
+    }
+
+    bool TimerManager::disarmTimer(TimerNode *node)
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        if (!node->m_armed)
+        {
+            return false;
+        }
+        eraseNode(node);
+        return true;
+    }
+
+    uint64_t TimerManager::setNextExpire() const
+    {
+        uint64_t next = ~0ull;
+        if (!m_timers.empty())
+        {
+            next = (*m_timers.begin())->m_next;
+        }
+        if (!m_nodeHeap.empty() && m_nodeHeap[0]->m_next < next)
+        {
+            next = m_nodeHeap[0]->m_next;
+        }
+        return next;
+    }
+
+    bool TimerManager::insertTimer(const Timer::ptr &timer)
+    {
+        if (m_useWheel)
+        {
+            timer->m_wheelRef = timer;
+            return insertNode(timer.get());
+        }
+        bool at_front = m_timers.insert(timer).first == m_timers.begin();
+        return at_front && (m_nodeHeap.empty() || timer->m_next < m_nodeHeap[0]->m_next);
+    }
+
+    bool TimerManager::eraseTimer(const Timer::ptr &timer)
+    {
+        if (m_useWheel)
+        {
+            if (!timer->m_armed)
+            {
+                return false;
+            }
+            eraseNode(timer.get());
+            //! 调用者持有timer, 这里释放自身引用是安全的
+            timer->m_wheelRef.reset();
+            return true;
+        }
+        auto it = m_timers.find(timer);
+        if (it == m_timers.end())
+        {
+            return false;
+        }
+        m_timers.erase(it);
+        return true;
+    }
+
+    bool TimerManager::insertNode(TimerNode *node)
+    {
+        node->m_armed = true;
+        if (m_useWheel)
+        {
+            //! 时间轮为空时不会推进, 插入前直接跳到当前时间, 避免下次到期检查逐毫秒追赶
+            if (m_wheelCount == 0)
+            {
+                m_wheelCurrent = std::max(m_wheelCurrent, HPS::GetMonotonicUS() / 1000);
+            }
+            wheelAdd(node);
+            ++m_wheelCount;
+            return WheelTick(node->m_next) < m_wheelDeadline;
+        }
+        node->m_heapIndex = m_nodeHeap.size();
+        m_nodeHeap.push_back(node);
+        heapUp(node->m_heapIndex);
+        return node->m_heapIndex == 0 && (m_timers.empty() || node->m_next < (*m_timers.begin())->m_next);
+    }
+
+    void TimerManager::eraseNode(TimerNode *node)
+    {
+        node->m_armed = false;
+        if (m_useWheel)
+        {
+            wheelUnlink(node);
+            --m_wheelCount;
+            return;
+        }
+        size_t index = node->m_heapIndex;
+        TimerNode *last = m_nodeHeap.back();
+        m_nodeHeap.pop_back();
+        if (last != node)
+        {
+            m_nodeHeap[index] = last;
+            last->m_heapIndex = index;
+            heapUp(index);
+            heapDown(last->m_heapIndex);
+        }
+    }
+
+    void TimerManager::expireNode(TimerNode *node, std::vector<Timer::ptr> &expired)
+    {
+        node->m_armed = false;
+        if (node->m_nodeCb)
+        {
+            node->m_nodeCb(node);
+        }
+        else
+        {
+            expired.push_back(std::move(static_cast<Timer *>(node)->m_wheelRef));
+        }
+    }
+
+    void TimerManager::heapUp(size_t index)
+    {
+        TimerNode *node = m_nodeHeap[index];
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (m_nodeHeap[parent]->m_next <= node->m_next)
+            {
+                break;
+            }
+            m_nodeHeap[index] = m_nodeHeap[parent];
+            m_nodeHeap[index]->m_heapIndex = index;
+            index = parent;
+        }
+        m_nodeHeap[index] = node;
+        node->m_heapIndex = index;
+    }
+
+    void TimerManager::heapDown(size_t index)
+    {
+        TimerNode *node = m_nodeHeap[index];
+        size_t size = m_nodeHeap.size();
+        while (true)
+        {
+            size_t child = index * 2 + 1;
+            if (child >= size)
+            {
+                break;
+            }
+            if (child + 1 < size && m_nodeHeap[child + 1]->m_next < m_nodeHeap[child]->m_next)
+            {
+                ++child;
+            }
+            if (node->m_next <= m_nodeHeap[child]->m_next)
+            {
+                break;
+            }
+            m_nodeHeap[index] = m_nodeHeap[child];
+            m_nodeHeap[index]->m_heapIndex = index;
+            index = child;
+        }
+        m_nodeHeap[index] = node;
+        node->m_heapIndex = index;
+    }
+
+    void TimerManager::wheelAdd(TimerNode *timer)
+    {
+        uint64_t expires = WheelTick(timer->m_next);
+        size_t slot = 0;
+        if (expires < m_wheelCurrent)
+        {
+            //! 已过期的定时器放入下一个要处理的槽位
+            slot = m_wheelCurrent & WHEEL_ROOT_MASK;
+        }
+        else if (expires - m_wheelCurrent < WHEEL_ROOT_SIZE)
+        {
+            slot = expires & WHEEL_ROOT_MASK;
+        }
+        else
+        {
+            uint64_t delta = expires - m_wheelCurrent;
+            if (delta > WHEEL_MAX_DELTA)
+            {
+                //! 超出时间轮范围的放在最高层最远的槽位, 分配时再重新计算
+                expires = m_wheelCurrent + WHEEL_MAX_DELTA;
+                delta = WHEEL_MAX_DELTA;
+            }
+            int level = 1;
+            while (level < WHEEL_LEVELS && delta >= (1ull << (WHEEL_ROOT_BITS + level * WHEEL_LEVEL_BITS)))
+            {
+                ++level;
+            }
+            slot = WheelLevelBase(level) + WheelLevelIndex(expires, level);
+        }
+        TimerNode **head = &m_wheel[slot];
+        timer->m_wheelSlot = head;
+        timer->m_wheelPrev = nullptr;
+        timer->m_wheelNext = *head;
+        if (*head)
+        {
+            (*head)->m_wheelPrev = timer;
+        }
+        *head = timer;
+    }
+
+    void TimerManager::wheelUnlink(TimerNode *timer)
+    {
+        if (timer->m_wheelPrev)
+        {
+            timer->m_wheelPrev->m_wheelNext = timer->m_wheelNext;
+        }
+        else
+        {
+            *timer->m_wheelSlot = timer->m_wheelNext;
+        }
+        if (timer->m_wheelNext)
+        {
+            timer->m_wheelNext->m_wheelPrev = timer->m_wheelPrev;
+        }
+        timer->m_wheelPrev = timer->m_wheelNext = nullptr;
+        timer->m_wheelSlot = nullptr;
+    }
+
+    bool TimerManager::wheelCascade(int level, int index)
+    {
+        TimerNode *timer = m_wheel[WheelLevelBase(level) + index];
+        m_wheel[WheelLevelBase(level) + index] = nullptr;
+        while (timer)
+        {
+            TimerNode *next = timer->m_wheelNext;
+            wheelAdd(timer);
+            timer = next;
+        }
+        return index == 0;
+    }
+
+    void TimerManager::wheelExpire(uint64_t now_ms, bool rollover, std::vector<Timer::ptr> &expired)
+    {
+        if (rollover)
+        {
+            //! 时间被调后时全部定时器过期, 与set引擎一致
+            for (auto &head : m_wheel)
+            {
+                while (head)
+                {
+                    TimerNode *timer = head;
+                    wheelUnlink(timer);
+                    expireNode(timer, expired);
+                }
+            }
+            m_wheelCount = 0;
+            m_wheelCurrent = now_ms;
+            return;
+        }
+        while (m_wheelCurrent <= now_ms && m_wheelCount > 0)
+        {
+            size_t index = m_wheelCurrent & WHEEL_ROOT_MASK;
+            //! 最底层转完一圈, 把上一层对应槽位的定时器分配下来
+            if (index == 0)
+            {
+                int level = 1;
+                while (level <= WHEEL_LEVELS && wheelCascade(level, WheelLevelIndex(m_wheelCurrent, level)))
+                {
+                    ++level;
+                }
+            }
+            TimerNode *timer = m_wheel[index];
+            m_wheel[index] = nullptr;
+            ++m_wheelCurrent;
+            while (timer)
+            {
+                TimerNode *next = timer->m_wheelNext;
+                timer->m_wheelPrev = timer->m_wheelNext = nullptr;
+                timer->m_wheelSlot = nullptr;
+                --m_wheelCount;
+                expireNode(timer, expired);
+                timer = next;
+            }
+        }
+        //! 时间轮为空时直接跳到当前时间
+        if (m_wheelCurrent <= now_ms)
+        {
+            m_wheelCurrent = now_ms + 1;
+        }
+    }
+
+    uint64_t TimerManager::wheelNextExpire()
+    {
+        //! 最底层转完一圈时才分配高层的定时器, 因此只查找到下一圈开始
+        if ((m_wheelCurrent & WHEEL_ROOT_MASK) == 0)
+        {
+            return m_wheelCurrent;
+        }
+        uint64_t boundary = (m_wheelCurrent | WHEEL_ROOT_MASK) + 1;
+        for (uint64_t ms = m_wheelCurrent; ms < boundary; ++ms)
+        {
+            if (m_wheel[ms & WHEEL_ROOT_MASK])
+            {
+                return ms;
+            }
+        }
+        return boundary;
     }
 
 }
@@ -142,36 +515,45 @@ namespace HPS
 namespace HPS
 {
     //# 1)创建定时器
-    Timer::Timer(uint64_t ms, std::function<void()> cb,
-                 bool recurring, TimerManager *manager)
-        : m_recurring(recurring), m_ms(ms), m_cb(cb), m_manager(manager)
+    Timer::Timer(uint64_t us, std::function<void()> cb,
+                 bool recurring, TimerManager *manager, bool nonblocking)
+        : m_recurring(recurring), m_nonblocking(nonblocking), m_us(us), m_cb(cb), m_manager(manager)
     {
-        m_next = HPS::GetCurrentMS() + m_ms;
+        m_next = HPS::GetMonotonicUS() + m_us;
     }
     Timer::Timer(uint64_t next)
-        : m_next(next)
     {
+        m_next = next;
     }
 
     //# 2) 创建定时器管理器
     TimerManager::TimerManager()
     {
-        m_previouseTime = HPS::GetCurrentMS();
+        m_previouseTime = HPS::GetMonotonicUS();
+        m_useWheel = g_timer_engine->getValue() == "wheel";
+        if (m_useWheel)
+        {
+            m_wheel.resize(WHEEL_ROOT_SIZE + WHEEL_LEVELS * WHEEL_LEVEL_SIZE, nullptr);
+            m_wheelCurrent = m_previouseTime / 1000;
+        }
     }
 
     //# 3) 添加定时器
-    Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring)
+    Timer::ptr TimerManager::addTimer(uint64_t ms, std::function<void()> cb, bool recurring, bool nonblocking)
     {
-        Timer::ptr timer(new Timer(ms, cb, recurring, this));
+        return addTimerUs(ms * 1000, cb, recurring, nonblocking);
+    }
+    Timer::ptr TimerManager::addTimerUs(uint64_t us, std::function<void()> cb, bool recurring, bool nonblocking)
+    {
+        Timer::ptr timer(new Timer(us, cb, recurring, this, nonblocking));
         RWMutexType::WriteLock lock(m_mutex);
         addTimer(timer, lock);
         return timer;
     }
     void TimerManager::addTimer(Timer::ptr val, RWMutexType::WriteLock &lock)
     {
-        auto it = m_timers.insert(val).first;
-        //! 若插入的定时器为集合头部（即为最早执行的定时器），且没有触发onTimerInsertedAtFront
-        bool at_front = (it == m_timers.begin()) && !m_tickled;
+        //! 若插入的定时器为最早执行的定时器，且没有触发onTimerInsertedAtFront
+        bool at_front = insertTimer(val) && !m_tickled;
         if (at_front)
         {
             m_tickled = true;
@@ -185,52 +567,78 @@ namespace HPS
     }
 
     //# 4) 获取需要执行的定时器的回调函数列表
-    void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs)
+    void TimerManager::listExpiredCb(std::vector<std::function<void()>> &cbs,
+                                     std::vector<std::function<void()>> *nonblocking_cbs)
     {
-        uint64_t now_ms = HPS::GetCurrentMS();
+        uint64_t now_us = HPS::GetMonotonicUS();
         //! 在定时器集合中提取已经失效的定时器（过期的）
         std::vector<Timer::ptr> expired;
         {
             RWMutexType::ReadLock lock(m_mutex);
-            if (m_timers.empty())
+            if (m_useWheel ? m_wheelCount == 0 : setNextExpire() == ~0ull)
             {
                 return;
             }
         }
         RWMutexType::WriteLock lock(m_mutex);
-        if (m_timers.empty())
+        if (m_useWheel ? m_wheelCount == 0 : setNextExpire() == ~0ull)
         {
             return;
         }
         //! 检测管理器执行时间是否被调后了,并重置管理器执行时间
-        bool rollover = detectClockRollover(now_ms);
-        //! 若管理器执行时间没有被调后且最近要执行的定时器时间晚于当前时间
-        if (!rollover && ((*m_timers.begin())->m_next > now_ms))
+        bool rollover = detectClockRollover(now_us);
+        if (m_useWheel)
         {
-            //! 不存在过期的定时器
-            return;
+            wheelExpire(now_us / 1000, rollover, expired);
+            if (expired.empty())
+            {
+                return;
+            }
         }
-
-        Timer::ptr now_timer(new Timer(now_ms));
-        //! 若管理器执行时间已调后，则所有定时器全部过期（需要执行）
-        //! 否则将所有精确执行时间为当前时间的定时器放入过期定时器数组
-        auto it = rollover ? m_timers.end() : m_timers.lower_bound(now_timer);
-        while (it != m_timers.end() && (*it)->m_next == now_ms)
+        else
         {
-            ++it;
+            //! 到期的侵入式定时器节点直接执行
+            while (!m_nodeHeap.empty() && (rollover || m_nodeHeap[0]->m_next <= now_us))
+            {
+                TimerNode *node = m_nodeHeap[0];
+                eraseNode(node);
+                expireNode(node, expired);
+            }
+            //! 若管理器执行时间没有被调后且最近要执行的定时器时间晚于当前时间
+            if (m_timers.empty() || (!rollover && ((*m_timers.begin())->m_next > now_us)))
+            {
+                //! 不存在过期的定时器
+                return;
+            }
+
+            Timer::ptr now_timer(new Timer(now_us));
+            //! 若管理器执行时间已调后，则所有定时器全部过期（需要执行）
+            //! 否则将所有精确执行时间为当前时间的定时器放入过期定时器数组
+            auto it = rollover ? m_timers.end() : m_timers.lower_bound(now_timer);
+            while (it != m_timers.end() && (*it)->m_next == now_us)
+            {
+                ++it;
+            }
+            expired.insert(expired.begin(), m_timers.begin(), it);
+            m_timers.erase(m_timers.begin(), it);
         }
-        expired.insert(expired.begin(), m_timers.begin(), it);
-        m_timers.erase(m_timers.begin(), it);
         cbs.reserve(expired.size());
 
         for (auto &timer : expired)
         {
-            cbs.push_back(timer->m_cb);
+            if (nonblocking_cbs && timer->m_nonblocking)
+            {
+                nonblocking_cbs->push_back(timer->m_cb);
+            }
+            else
+            {
+                cbs.push_back(timer->m_cb);
+            }
             if (timer->m_recurring)
             {
                 //! 若为循环定时器，则将定时器重新加入到定时器集合
-                timer->m_next = now_ms + timer->m_ms;
-                m_timers.insert(timer);
+                timer->m_next = now_us + timer->m_us;
+                insertTimer(timer);
             }
             else
             {
@@ -238,21 +646,40 @@ namespace HPS
             }
         }
     }
-    bool TimerManager::detectClockRollover(uint64_t now_ms)
+    bool TimerManager::detectClockRollover(uint64_t now_us)
     {
         bool rollover = false;
         //! 若当前时间早于上次定时器管理器执行时间前一个小时，
-        if (now_ms < m_previouseTime &&
-            now_ms < (m_previouseTime - 60 * 60 * 1000))
+        //! 单调时钟正常情况下不会回退, 保留检测以防万一
+        if (now_us < m_previouseTime &&
+            now_us < (m_previouseTime - 60 * 60 * 1000 * 1000ull))
         {
             rollover = true;
         }
-        m_previouseTime = now_ms;
+        m_previouseTime = now_us;
         return rollover;
     }
 
     //# 6)销毁定时器管理器
     TimerManager::~TimerManager()
     {
+        //! 释放时间轮中定时器的自身引用
+        for (auto &head : m_wheel)
+        {
+            while (head)
+            {
+                TimerNode *timer = head;
+                wheelUnlink(timer);
+                timer->m_armed = false;
+                if (!timer->m_nodeCb)
+                {
+                    static_cast<Timer *>(timer)->m_wheelRef.reset();
+                }
+            }
+        }
+        for (auto node : m_nodeHeap)
+        {
+            node->m_armed = false;
+        }
     }
 }
\ No newline at end of file
@@ -12,10 +12,50 @@ namespace HPS
 {
 
     class TimerManager;
+
+    /**
+     * @brief 侵入式定时器节点
+     * @details 嵌入在使用者的对象中, 通过TimerManager::armTimer/disarmTimer挂入和摘下,
+     *          不做任何内存分配; 到期回调在listExpiredCb中持有管理器锁同步执行,
+     *          因此disarmTimer返回后回调不会再执行, 回调中不能再操作该管理器
+     */
+    class TimerNode
+    {
+        friend class TimerManager;
+        friend class Timer;
+
+    public:
+        /// 到期回调类型
+        typedef void (*Callback)(TimerNode *node);
+
+        /**
+         * @brief 是否已挂入管理器
+         */
+        bool isArmed() const { return m_armed; }
+
+    protected:
+        /// 精确的执行时间(单调时钟的微秒)
+        uint64_t m_next = 0;
+
+    private:
+        /// 到期回调, Timer为nullptr
+        Callback m_nodeCb = nullptr;
+        /// 是否已挂入管理器
+        bool m_armed = false;
+        /// 时间轮引擎: 所在槽位链表的前一个节点
+        TimerNode *m_wheelPrev = nullptr;
+        /// 时间轮引擎: 所在槽位链表的后一个节点
+        TimerNode *m_wheelNext = nullptr;
+        /// 时间轮引擎: 所在槽位
+        TimerNode **m_wheelSlot = nullptr;
+        /// set引擎: 在最小堆中的下标
+        size_t m_heapIndex = 0;
+    };
+
     /**
      * @brief 定时器
      */
-    class Timer : public std::enable_shared_from_this<Timer>
+    class Timer : public TimerNode, public std::enable_shared_from_this<Timer>
     {
         friend class TimerManager;
 
@@ -43,30 +83,33 @@ namespace HPS
     private:
         /**
          * @brief 构造函数
-         * @param[in] ms 定时器执行间隔时间
+         * @param[in] us 定时器执行间隔时间(微秒)
          * @param[in] cb 回调函数
          * @param[in] recurring 是否循环
          * @param[in] manager 定时器管理器
+         * @param[in] nonblocking 回调是否非阻塞
          */
-        Timer(uint64_t ms, std::function<void()> cb,
-              bool recurring, TimerManager *manager);
+        Timer(uint64_t us, std::function<void()> cb,
+              bool recurring, TimerManager *manager, bool nonblocking = false);
         /**
          * @brief 构造函数
-         * @param[in] next 执行的时间戳(毫秒)
+         * @param[in] next 执行的时间戳(微秒)
          */
         Timer(uint64_t next);
 
     private:
         /// 是否循环定时器
         bool m_recurring = false;
-        /// 执行周期
-        uint64_t m_ms = 0;
-        /// 精确的执行时间
-        uint64_t m_next = 0;
+        /// 回调是否非阻塞(不让出), 可直接在调度协程上执行
+        bool m_nonblocking = false;
+        /// 执行周期(微秒)
+        uint64_t m_us = 0;
         /// 回调函数
         std::function<void()> m_cb;
         /// 定时器管理器
         TimerManager *m_manager = nullptr;
+        /// 时间轮引擎: 在时间轮中时持有自身的引用
+        Timer::ptr m_wheelRef;
 
     private:
         /**
@@ -85,6 +128,9 @@ namespace HPS
 
     /**
      * @brief 定时器管理器
+     * @details 执行时间取单调时钟的微秒. 支持两种引擎,由配置timer.engine在构造时选择:
+     *          set   按执行时间排序的std::set, 插入删除O(log n), 微秒精度
+     *          wheel 分层时间轮(1毫秒精度, 不足1毫秒的部分向后取整), 插入删除O(1)
      */
     class TimerManager
     {
@@ -109,8 +155,18 @@ namespace HPS
          * @param[in] ms 定时器执行间隔时间
          * @param[in] cb 定时器回调函数
          * @param[in] recurring 是否循环定时器
+         * @param[in] nonblocking 回调是否非阻塞(不让出)
+         */
+        Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false, bool nonblocking = false);
+
+        /**
+         * @brief 添加微秒精度的定时器
+         * @param[in] us 定时器执行间隔时间(微秒)
+         * @param[in] cb 定时器回调函数
+         * @param[in] recurring 是否循环定时器
+         * @param[in] nonblocking 回调是否非阻塞(不让出)
          */
-        Timer::ptr addTimer(uint64_t ms, std::function<void()> cb, bool recurring = false);
+        Timer::ptr addTimerUs(uint64_t us, std::function<void()> cb, bool recurring = false, bool nonblocking = false);
 
         /**
          * @brief 添加条件定时器
@@ -118,25 +174,54 @@ namespace HPS
          * @param[in] cb 定时器回调函数
          * @param[in] weak_cond 条件
          * @param[in] recurring 是否循环
+         * @param[in] nonblocking 回调是否非阻塞(不让出)
          */
-        Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond, bool recurring = false);
+        Timer::ptr addConditionTimer(uint64_t ms, std::function<void()> cb, std::weak_ptr<void> weak_cond,
+                                     bool recurring = false, bool nonblocking = false);
 
         /**
-         * @brief 到最近一个定时器执行的时间间隔(毫秒)
+         * @brief 挂入侵入式定时器节点
+         * @param[in] node 定时器节点, 已挂入时重新计时
+         * @param[in] ms 超时时间(毫秒)
+         * @param[in] cb 到期回调
+         */
+        void armTimer(TimerNode *node, uint64_t ms, TimerNode::Callback cb);
+
+        /**
+         * @brief 摘下侵入式定时器节点
+         * @return 节点是否在到期前被摘下
+         */
+        bool disarmTimer(TimerNode *node);
+
+        /**
+         * @brief 到最近一个定时器执行的时间间隔(毫秒, 向上取整), 没有定时器时返回~0ull
          */
         uint64_t getNextTimer();
 
+        /**
+         * @brief 到最近一个定时器执行的时间间隔(微秒), 没有定时器时返回~0ull
+         */
+        uint64_t getNextTimerUs();
+
         /**
          * @brief 获取需要执行的定时器的回调函数列表
+         * @details 到期的侵入式定时器节点在此直接执行回调
          * @param[out] cbs 回调函数数组
+         * @param[out] nonblocking_cbs 非阻塞回调函数数组, 为空时非阻塞回调也放入cbs
          */
-        void listExpiredCb(std::vector<std::function<void()>> &cbs);
+        void listExpiredCb(std::vector<std::function<void()>> &cbs,
+                           std::vector<std::function<void()>> *nonblocking_cbs = nullptr);
 
         /**
          * @brief 是否有定时器
          */
         bool hasTimer();
 
+        /**
+         * @brief 是否使用时间轮引擎
+         */
+        bool isTimerWheel() const { return m_useWheel; }
+
     protected:
         /**
          * @brief 当有新的定时器插入到定时器的首部,执行该函数
@@ -152,16 +237,100 @@ namespace HPS
         /**
          * @brief 检测管理器上次执行时间是否被调后了
          */
-        bool detectClockRollover(uint64_t now_ms);
+        bool detectClockRollover(uint64_t now_us);
+
+        /**
+         * @brief 将定时器放入当前引擎
+         * @return 是否成为最早执行的定时器
+         */
+        bool insertTimer(const Timer::ptr &timer);
+
+        /**
+         * @brief 将定时器从当前引擎中移除
+         * @return 定时器是否在管理器中
+         */
+        bool eraseTimer(const Timer::ptr &timer);
+
+        /**
+         * @brief 将节点放入当前引擎(set引擎放入侵入式最小堆)
+         * @return 是否成为最早执行的定时器
+         */
+        bool insertNode(TimerNode *node);
+
+        /**
+         * @brief 将节点从当前引擎中移除
+         */
+        void eraseNode(TimerNode *node);
+
+        /**
+         * @brief 执行到期节点的回调, Timer放入expired
+         */
+        void expireNode(TimerNode *node, std::vector<Timer::ptr> &expired);
+
+        /**
+         * @brief set引擎中最近执行的时间(微秒), 没有定时器时返回~0ull
+         */
+        uint64_t setNextExpire() const;
+
+        /**
+         * @brief 最小堆中下标为index的节点上浮
+         */
+        void heapUp(size_t index);
+
+        /**
+         * @brief 最小堆中下标为index的节点下沉
+         */
+        void heapDown(size_t index);
+
+        /**
+         * @brief 按执行时间将节点挂到时间轮对应的槽位
+         */
+        void wheelAdd(TimerNode *node);
+
+        /**
+         * @brief 将节点从时间轮槽位上摘下
+         */
+        void wheelUnlink(TimerNode *node);
+
+        /**
+         * @brief 将高层时间轮一个槽位的定时器重新分配到低层
+         * @param[in] level 层数(从1开始)
+         * @param[in] index 槽位下标
+         * @return 下一层是否也需要分配(index为0)
+         */
+        bool wheelCascade(int level, int index);
+
+        /**
+         * @brief 推进时间轮到now_ms, 取出所有过期定时器
+         */
+        void wheelExpire(uint64_t now_ms, bool rollover, std::vector<Timer::ptr> &expired);
+
+        /**
+         * @brief 时间轮中最近执行的时间(毫秒刻度)
+         * @details 最底层为空时返回下一次分配高层时间轮的时间
+         */
+        uint64_t wheelNextExpire();
 
     private:
         /// Mutex
         RWMutexType m_mutex;
         /// 定时器集合
         std::set<Timer::ptr, Timer::Comparator> m_timers;
+        /// set引擎: 侵入式定时器节点的最小堆
+        std::vector<TimerNode *> m_nodeHeap;
+        /// 是否使用时间轮引擎
+        bool m_useWheel = false;
+        /// 时间轮槽位: 最底层256个1毫秒的槽位, 其上4层各64个槽位
+        std::vector<TimerNode *> m_wheel;
+        /// 时间轮下一个要处理的时间(毫秒)
+        uint64_t m_wheelCurrent = 0;
+        /// 时间轮中的定时器和节点数量
+        size_t m_wheelCount = 0;
+        /// 调度器下次检查定时器的时间, 更早的定时器插入时需要通知
+        uint64_t m_wheelDeadline = ~0ull;
         /// 是否触发onTimerInsertedAtFront
         bool m_tickled = false;
-        /// 上次执行时间
+        /// 上次执行时间(微秒)
         uint64_t m_previouseTime = 0;
     };
 
@@ -0,0 +1,186 @@
+#include "uring.h"
+#include "log.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace HPS
+{
+    static HPS::Logger::ptr g_logger = LOG_NAME("system");
+
+    static int SysUringSetup(unsigned entries, io_uring_params *p)
+    {
+        return (int)syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    static int SysUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+    {
+        return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+    }
+
+    IoUring::IoUring()
+    {
+    }
+
+    IoUring::~IoUring()
+    {
+        if (m_sqes)
+        {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing && m_cqRing != m_sqRing)
+        {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing)
+        {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+    }
+
+    bool IoUring::init(unsigned entries)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = SysUringSetup(entries, &p);
+        if (fd < 0)
+        {
+            LOG_INFO(g_logger) << "io_uring_setup(" << entries << ") errno=" << errno
+                               << " errstr=" << strerror(errno);
+            return false;
+        }
+        m_fd = fd;
+
+        m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+        {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED)
+        {
+            m_sqRing = nullptr;
+            LOG_ERROR(g_logger) << "io_uring mmap sq ring errno=" << errno;
+            return false;
+        }
+        if (single)
+        {
+            m_cqRing = m_sqRing;
+        }
+        else
+        {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED)
+            {
+                m_cqRing = nullptr;
+                LOG_ERROR(g_logger) << "io_uring mmap cq ring errno=" << errno;
+                return false;
+            }
+        }
+        m_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+        {
+            LOG_ERROR(g_logger) << "io_uring mmap sqes errno=" << errno;
+            return false;
+        }
+        m_sqes = (io_uring_sqe *)sqes;
+
+        char *sq = (char *)m_sqRing;
+        m_sqHead = (unsigned *)(sq + p.sq_off.head);
+        m_sqTail = (unsigned *)(sq + p.sq_off.tail);
+        m_sqArray = (unsigned *)(sq + p.sq_off.array);
+        m_sqMask = *(unsigned *)(sq + p.sq_off.ring_mask);
+        m_sqEntries = *(unsigned *)(sq + p.sq_off.ring_entries);
+
+        char *cq = (char *)m_cqRing;
+        m_cqHead = (unsigned *)(cq + p.cq_off.head);
+        m_cqTail = (unsigned *)(cq + p.cq_off.tail);
+        m_cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+        m_cqMask = *(unsigned *)(cq + p.cq_off.ring_mask);
+        return true;
+    }
+
+    bool IoUring::submit(const io_uring_sqe *sqes, unsigned count, bool enter)
+    {
+        Mutex::Lock lock(m_sqMutex);
+        unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *m_sqTail;
+        if (tail - head + count > m_sqEntries)
+        {
+            //! 队列满时先提交已有的操作, 内核取走后腾出空间
+            this->enter();
+            head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (tail - head + count > m_sqEntries)
+            {
+                return false;
+            }
+        }
+        for (unsigned i = 0; i < count; ++i)
+        {
+            unsigned index = (tail + i) & m_sqMask;
+            m_sqes[index] = sqes[i];
+            m_sqArray[index] = index;
+        }
+        __atomic_store_n(m_sqTail, tail + count, __ATOMIC_RELEASE);
+        m_sqPending += count;
+        if (enter)
+        {
+            this->enter();
+        }
+        return true;
+    }
+
+    void IoUring::flush()
+    {
+        Mutex::Lock lock(m_sqMutex);
+        enter();
+    }
+
+    void IoUring::enter()
+    {
+        if (m_sqPending == 0)
+        {
+            return;
+        }
+        ++m_enterCount;
+        int rt = SysUringEnter(m_fd, m_sqPending, 0, 0);
+        if (rt < 0)
+        {
+            //! 未被内核取走的操作留在队列中, 下一次提交时重试
+            LOG_ERROR(g_logger) << "io_uring_enter(" << m_fd << ", " << m_sqPending << ") errno=" << errno
+                                << " errstr=" << strerror(errno);
+            return;
+        }
+        m_sqPending -= std::min<unsigned>(rt, m_sqPending);
+    }
+
+    unsigned IoUring::reap(io_uring_cqe *cqes, unsigned max)
+    {
+        Mutex::Lock lock(m_cqMutex);
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        while (head != tail && count < max)
+        {
+            cqes[count++] = m_cqes[head & m_cqMask];
+            ++head;
+        }
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+}
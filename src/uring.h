@@ -0,0 +1,120 @@
+#ifndef __URING_H__
+#define __URING_H__
+
+#include "mutex.h"
+#include "noncopyable.h"
+
+#include <atomic>
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace HPS
+{
+
+    /**
+     * @brief io_uring实例的封装
+     * @details 直接使用io_uring_setup/io_uring_enter系统调用, 不依赖liburing;
+     *          提交和收割分别加锁, 可被多个线程同时使用
+     */
+    class IoUring : Noncopyable
+    {
+    public:
+        /**
+         * @brief 构造函数
+         */
+        IoUring();
+
+        /**
+         * @brief 析构函数
+         */
+        ~IoUring();
+
+        /**
+         * @brief 创建io_uring实例并映射提交/完成队列
+         * @param[in] entries 提交队列大小
+         * @return 内核不支持或被禁用时返回false
+         */
+        bool init(unsigned entries);
+
+        /**
+         * @brief 是否可用
+         */
+        bool isValid() const { return m_fd >= 0; }
+
+        /**
+         * @brief 返回io_uring的文件句柄, 有完成事件时可读
+         */
+        int getFd() const { return m_fd; }
+
+        /**
+         * @brief 放入一组操作(多线程安全)
+         * @details 链接的操作需在同一组内; 默认只放入提交队列,
+         *          由flush()一次io_uring_enter批量提交
+         * @param[in] sqes 操作数组
+         * @param[in] count 操作数量
+         * @param[in] enter 是否立即提交
+         * @return 提交队列空间不足时返回false
+         */
+        bool submit(const io_uring_sqe *sqes, unsigned count, bool enter = false);
+
+        /**
+         * @brief 提交队列中尚未提交的操作(多线程安全)
+         */
+        void flush();
+
+        /**
+         * @brief 取出已完成的操作(多线程安全)
+         * @param[out] cqes 完成事件数组
+         * @param[in] max 数组大小
+         * @return 取出的数量
+         */
+        unsigned reap(io_uring_cqe *cqes, unsigned max);
+
+        /**
+         * @brief 调用io_uring_enter的次数
+         */
+        uint64_t getEnterCount() const { return m_enterCount; }
+
+    private:
+        /**
+         * @brief 提交尚未提交的操作, 调用者持有m_sqMutex
+         */
+        void enter();
+
+    private:
+        /// io_uring文件句柄
+        int m_fd = -1;
+        /// 提交队列锁
+        Mutex m_sqMutex;
+        /// 完成队列锁
+        Mutex m_cqMutex;
+        /// 提交队列环的映射
+        void *m_sqRing = nullptr;
+        size_t m_sqRingSize = 0;
+        /// 完成队列环的映射(内核支持单次映射时与提交队列相同)
+        void *m_cqRing = nullptr;
+        size_t m_cqRingSize = 0;
+        /// 提交队列项数组的映射
+        io_uring_sqe *m_sqes = nullptr;
+        size_t m_sqesSize = 0;
+        /// 提交队列
+        unsigned *m_sqHead = nullptr;
+        unsigned *m_sqTail = nullptr;
+        unsigned *m_sqArray = nullptr;
+        unsigned m_sqMask = 0;
+        unsigned m_sqEntries = 0;
+        /// 已放入提交队列但尚未提交的操作数量
+        unsigned m_sqPending = 0;
+        /// 完成队列
+        unsigned *m_cqHead = nullptr;
+        unsigned *m_cqTail = nullptr;
+        io_uring_cqe *m_cqes = nullptr;
+        unsigned m_cqMask = 0;
+        /// io_uring_enter调用次数
+        std::atomic<uint64_t> m_enterCount = {0};
+    };
+
+}
+
+#endif
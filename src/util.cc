@@ -4,6 +4,7 @@
 
 #include <execinfo.h>
 #include <sys/time.h>
+#include <time.h>
 #include <dirent.h>
 #include <unistd.h>
 #include <string.h>
@@ -106,6 +107,13 @@ namespace HPS
         return tv.tv_sec * 1000 * 1000ul + tv.tv_usec;
     }
 
+    uint64_t GetMonotonicUS()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000 * 1000ul + ts.tv_nsec / 1000;
+    }
+
     static int __lstat(const char *file, struct stat *st = nullptr)
     {
         struct stat lst;
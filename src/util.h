@@ -48,6 +48,11 @@ namespace HPS
      */
     uint64_t GetCurrentUS();
 
+    /*
+     * @brief 获取单调时钟的微秒, 不受系统时间调整影响, 用于定时器
+     */
+    uint64_t GetMonotonicUS();
+
     std::string Time2Str(time_t ts = time(0), const std::string &format = "%Y-%m-%d %H:%M:%S");
     time_t Str2Time(const char *str, const char *format = "%Y-%m-%d %H:%M:%S");
 
@@ -0,0 +1,219 @@
+#include "../include/HPS.h"
+
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const int s_rounds = 100000;
+
+//! 两个协程通过一对通道来回传递计数; 两个调度器时两端分别位于不同的调度器
+void bench_ping_pong(size_t capacity, bool cross_scheduler)
+{
+    HPS::Channel<int> ping(capacity);
+    HPS::Channel<int> pong(capacity);
+    uint64_t begin = HPS::GetCurrentUS();
+    {
+        HPS::IOManager iom(1, false, "ping");
+        std::unique_ptr<HPS::IOManager> other;
+        if (cross_scheduler)
+        {
+            other.reset(new HPS::IOManager(1, false, "pong"));
+        }
+        HPS::Scheduler *pong_sc = cross_scheduler ? (HPS::Scheduler *)other.get() : &iom;
+        pong_sc->schedule([&]()
+                          {
+            int v;
+            while (ping.recv(v))
+            {
+                pong.send(v + 1);
+            }
+            pong.close(); });
+        iom.schedule([&]()
+                     {
+            int v = 0;
+            for (int i = 0; i < s_rounds; ++i)
+            {
+                ping.send(v);
+                pong.recv(v);
+            }
+            ASSERT(v == s_rounds);
+            ping.close(); });
+    }
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    LOG_INFO(g_logger) << "ping_pong capacity=" << capacity
+                       << " cross_scheduler=" << cross_scheduler
+                       << " round_trips=" << s_rounds
+                       << " used=" << used << "us"
+                       << " round_trips/s=" << (uint64_t)(s_rounds * 1000000.0 / used);
+}
+
+//! 单向流式传递, 缓冲通道可以批量交接, 减少协程切换
+void bench_stream(size_t capacity)
+{
+    HPS::Channel<int> ch(capacity);
+    int64_t sum = 0;
+    uint64_t begin = HPS::GetCurrentUS();
+    {
+        HPS::IOManager iom(1, false, "stream");
+        iom.schedule([&]()
+                     {
+            int v;
+            while (ch.recv(v))
+            {
+                sum += v;
+            } });
+        iom.schedule([&]()
+                     {
+            for (int i = 0; i < s_rounds; ++i)
+            {
+                ch.send(i);
+            }
+            ch.close(); });
+    }
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    LOG_INFO(g_logger) << "stream capacity=" << capacity
+                       << " messages=" << s_rounds
+                       << " sum_ok=" << (sum == (int64_t)s_rounds * (s_rounds - 1) / 2)
+                       << " used=" << used << "us"
+                       << " messages/s=" << (uint64_t)(s_rounds * 1000000.0 / used);
+}
+
+//! 非阻塞操作和关闭语义
+void test_try_and_close()
+{
+    HPS::Channel<std::string> ch(2);
+    std::string v;
+    bool s1 = ch.trySend("a");
+    bool s2 = ch.trySend("b");
+    bool s3 = ch.trySend("c");
+    bool r0 = ch.tryRecv(v);
+    ch.close();
+    bool s4 = ch.trySend("d");
+    bool r1 = ch.recv(v);
+    bool r2 = ch.recv(v);
+    LOG_INFO(g_logger) << "try_and_close: trySend=" << s1 << s2 << s3
+                       << " tryRecv=" << r0
+                       << " send_after_close=" << s4
+                       << " drain=" << r1 << " last=" << v
+                       << " recv_after_drain=" << r2;
+}
+
+//! 工作协程同时等待数据通道和退出通道, 另一个调度器上的协程向它发送
+void test_select()
+{
+    HPS::Channel<int> data;
+    HPS::Channel<int> quit;
+    HPS::Channel<std::string> log(16);
+    std::atomic<int> received = {0};
+    {
+        HPS::IOManager worker(1, false, "worker");
+        HPS::IOManager producer(1, false, "producer");
+        worker.schedule([&]()
+                        {
+            while (true)
+            {
+                int v = 0;
+                int q = 0;
+                bool ok = false;
+                HPS::ChannelSelect sel;
+                int data_case = sel.recv(data, v, &ok);
+                sel.recv(quit, q);
+                int index = sel.wait();
+                if (index != data_case || !ok)
+                {
+                    break;
+                }
+                ++received;
+                if (v % 100 == 0)
+                {
+                    //! 日志通道满时丢弃而不等待
+                    HPS::ChannelSelect log_sel;
+                    log_sel.send(log, "got " + std::to_string(v));
+                    log_sel.tryWait();
+                }
+            }
+            log.close(); });
+        producer.schedule([&]()
+                          {
+            for (int i = 0; i < 1000; ++i)
+            {
+                data.send(i);
+            }
+            quit.send(1); });
+    }
+    int lines = 0;
+    std::string line;
+    while (log.recv(line))
+    {
+        ++lines;
+    }
+    LOG_INFO(g_logger) << "select: received=" << received << " log_lines=" << lines
+                       << " last=" << line;
+}
+
+//! 共享栈上的协程等待时栈被换出, 另一线程完成的收发结果在恢复后仍然正确
+void test_shared_stack()
+{
+    HPS::Config::Lookup<bool>("scheduler.shared_stack")->setValue(true);
+    HPS::Config::Lookup<uint32_t>("fiber.shared_stack_count")->setValue(1);
+    HPS::Channel<int> ch;
+    HPS::Channel<int> sel_ch;
+    std::atomic<int> got = {-1};
+    std::atomic<int> selected = {-1};
+    std::atomic<int> broken = {0};
+    {
+        HPS::IOManager iom(1, false, "shared");
+        iom.schedule([&]()
+                     {
+            int v = -1;
+            bool ok = ch.recv(v);
+            got = ok ? v : -1; });
+        iom.schedule([&]()
+                     {
+            int v = -1;
+            bool ok = false;
+            HPS::ChannelSelect sel;
+            sel.recv(sel_ch, v, &ok);
+            sel.wait();
+            selected = ok ? v : -1; });
+        //! 占用共享栈的其他协程
+        for (int i = 0; i < 20; ++i)
+        {
+            iom.schedule([i, &broken]()
+                         {
+                char buf[256];
+                memset(buf, 'a' + i, sizeof(buf));
+                for (int k = 0; k < 10; ++k)
+                {
+                    usleep(100);
+                }
+                if (buf[0] != 'a' + i || buf[sizeof(buf) - 1] != buf[0])
+                {
+                    ++broken;
+                } });
+        }
+        usleep(300);
+        ch.send(42);
+        sel_ch.send(7);
+    }
+    HPS::Config::Lookup<bool>("scheduler.shared_stack")->setValue(false);
+    LOG_INFO(g_logger) << "shared_stack: got=" << got << " selected=" << selected << " broken=" << broken;
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    test_try_and_close();
+    test_select();
+    test_shared_stack();
+    for (size_t capacity : {0, 1, 64})
+    {
+        bench_ping_pong(capacity, false);
+        bench_ping_pong(capacity, true);
+    }
+    for (size_t capacity : {0, 64, 1024})
+    {
+        bench_stream(capacity);
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include "../include/HPS.h"
+#include "fiber_context.h"
+
+#include <ucontext.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const uint64_t s_switches = 1000000;
+static const size_t s_stack_size = 64 * 1024;
+
+static void report(const char *name, uint64_t switches, uint64_t used_us)
+{
+    LOG_INFO(g_logger) << name << ": switches=" << switches
+                       << " used=" << used_us << "us"
+                       << " switches/s=" << (uint64_t)(switches * 1000000.0 / used_us)
+                       << " ns/switch=" << (used_us * 1000.0 / switches);
+}
+
+static ucontext_t s_uc_main;
+static ucontext_t s_uc_co;
+
+static void uc_entry()
+{
+    while (true)
+    {
+        swapcontext(&s_uc_co, &s_uc_main);
+    }
+}
+
+void bench_ucontext()
+{
+    std::vector<char> stack(s_stack_size);
+    getcontext(&s_uc_co);
+    s_uc_co.uc_link = nullptr;
+    s_uc_co.uc_stack.ss_sp = &stack[0];
+    s_uc_co.uc_stack.ss_size = stack.size();
+    makecontext(&s_uc_co, &uc_entry, 0);
+
+    uint64_t begin = HPS::GetCurrentUS();
+    for (uint64_t i = 0; i < s_switches / 2; ++i)
+    {
+        swapcontext(&s_uc_main, &s_uc_co);
+    }
+    report("ucontext", s_switches, HPS::GetCurrentUS() - begin);
+}
+
+#if HPS_HAS_ASM_CONTEXT
+static HPS::AsmContext s_asm_main;
+static HPS::AsmContext s_asm_co;
+
+static void asm_entry()
+{
+    while (true)
+    {
+        HPS::SwapAsmContext(&s_asm_co, &s_asm_main);
+    }
+}
+
+void bench_asm()
+{
+    std::vector<char> stack(s_stack_size);
+    HPS::MakeAsmContext(&s_asm_co, &stack[0], stack.size(), &asm_entry);
+
+    uint64_t begin = HPS::GetCurrentUS();
+    for (uint64_t i = 0; i < s_switches / 2; ++i)
+    {
+        HPS::SwapAsmContext(&s_asm_main, &s_asm_co);
+    }
+    report("asm", s_switches, HPS::GetCurrentUS() - begin);
+}
+#endif
+
+void bench_fiber()
+{
+    static bool s_stop = false;
+    HPS::Fiber::GetThis();
+    HPS::Fiber::ptr fiber(new HPS::Fiber([]()
+                                         {
+        while(!s_stop) {
+            HPS::Fiber::YieldToHold();
+        } }));
+    uint64_t begin = HPS::GetCurrentUS();
+    for (uint64_t i = 0; i < s_switches / 2; ++i)
+    {
+        fiber->call();
+    }
+    std::string name = std::string("Fiber(") + HPS::Fiber::ContextBackend() + ")";
+    report(name.c_str(), s_switches, HPS::GetCurrentUS() - begin);
+    s_stop = true;
+    fiber->call();
+}
+
+int main(int argc, char **argv)
+{
+    //! 关闭DEBUG日志,避免Fiber构造析构的日志影响结果
+    LOG_NAME("system")->setLevel(HPS::LogLevel::INFO);
+    bench_ucontext();
+#if HPS_HAS_ASM_CONTEXT
+    bench_asm();
+#endif
+    bench_fiber();
+    return 0;
+}
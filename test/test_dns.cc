@@ -0,0 +1,264 @@
+#include "../include/HPS.h"
+#include "../src/dns.h"
+#include "../src/fiber_group.h"
+#include "../src/uri.h"
+
+#include <fstream>
+#include <map>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 本地的DNS桩服务器: svc.test延迟30ms返回两条A记录(TTL 1秒), v6.test返回AAAA记录,
+//! drop.test不应答, spoof.test先从另一个端口伪造应答再正常应答, tc.test返回截断的应答, 其余域名返回NXDOMAIN
+static std::map<std::string, int> s_received;
+static std::vector<uint16_t> s_ids;
+static std::atomic<bool> s_running = {true};
+
+static std::string ParseQName(const uint8_t *buf, size_t len, size_t &off)
+{
+    std::string name;
+    while (off < len && buf[off])
+    {
+        if (!name.empty())
+        {
+            name.push_back('.');
+        }
+        name.append((const char *)buf + off + 1, buf[off]);
+        off += buf[off] + 1;
+    }
+    ++off;
+    return name;
+}
+
+static void AppendRecord(std::string &rsp, uint16_t type, uint32_t ttl, const void *data, uint16_t len)
+{
+    const uint8_t head[] = {0xc0, 0x0c, (uint8_t)(type >> 8), (uint8_t)type, 0, 1,
+                            (uint8_t)(ttl >> 24), (uint8_t)(ttl >> 16), (uint8_t)(ttl >> 8), (uint8_t)ttl,
+                            (uint8_t)(len >> 8), (uint8_t)len};
+    rsp.append((const char *)head, sizeof(head));
+    rsp.append((const char *)data, len);
+}
+
+void stub_server(HPS::Address::ptr addr)
+{
+    HPS::Socket::ptr sock = HPS::Socket::CreateUDP(addr);
+    sock->bind(addr);
+    sock->setRecvTimeout(50);
+    uint8_t buf[512];
+    while (s_running)
+    {
+        HPS::Address::ptr from(new HPS::IPv4Address);
+        int n = sock->recvFrom(buf, sizeof(buf), from);
+        if (n <= 12)
+        {
+            continue;
+        }
+        size_t off = 12;
+        std::string name = ParseQName(buf, n, off);
+        uint16_t qtype = (buf[off] << 8) | buf[off + 1];
+        off += 4;
+        ++s_received[name];
+        s_ids.push_back((buf[0] << 8) | buf[1]);
+
+        std::string rsp((const char *)buf, off);
+        rsp[2] = (char)0x81;
+        rsp[3] = (char)0x80;
+        int delay = 0;
+        int count = 0;
+        if (name == "svc.test" && qtype == 1)
+        {
+            in_addr a;
+            inet_pton(AF_INET, "10.0.0.1", &a);
+            AppendRecord(rsp, 1, 1, &a, 4);
+            inet_pton(AF_INET, "10.0.0.2", &a);
+            AppendRecord(rsp, 1, 300, &a, 4);
+            count = 2;
+            delay = 30;
+        }
+        else if (name == "v6.test" && qtype == 28)
+        {
+            in6_addr a;
+            inet_pton(AF_INET6, "fd00::1", &a);
+            AppendRecord(rsp, 28, 60, &a, 16);
+            count = 1;
+        }
+        else if (name == "drop.test")
+        {
+            continue;
+        }
+        else if (name == "spoof.test" && qtype == 1)
+        {
+            //! 猜中id的攻击者从其他端口抢先应答
+            std::string forged = rsp;
+            in_addr a;
+            inet_pton(AF_INET, "6.6.6.6", &a);
+            AppendRecord(forged, 1, 300, &a, 4);
+            forged[7] = 1;
+            HPS::Socket::ptr attacker = HPS::Socket::CreateUDP(addr);
+            attacker->sendTo(forged.data(), forged.size(), from);
+            inet_pton(AF_INET, "10.0.0.9", &a);
+            AppendRecord(rsp, 1, 300, &a, 4);
+            count = 1;
+            delay = 20;
+        }
+        else if (name == "tc.test")
+        {
+            rsp[2] = (char)0x83;
+        }
+        else if (name != "v6.test")
+        {
+            rsp[3] = (char)0x83;
+        }
+        rsp[7] = count;
+        HPS::Scheduler::GetThis()->schedule([sock, rsp, from, delay]()
+                                            {
+            usleep(delay * 1000);
+            sock->sendTo(rsp.data(), rsp.size(), from); });
+    }
+}
+
+//! 10个协程同时解析同一域名, 只发出一次查询; 之后命中缓存
+void test_dedup_and_cache()
+{
+    HPS::WaitGroup wg;
+    std::vector<std::string> results(10);
+    uint64_t begin = HPS::GetCurrentUS();
+    for (int i = 0; i < 10; ++i)
+    {
+        wg.add();
+        HPS::Scheduler::GetThis()->schedule([i, &wg, &results]()
+                                            {
+            HPS::IPAddress::ptr addr = HPS::Address::LookupAnyIPAddress("svc.test:8080");
+            results[i] = addr ? addr->toString() : "null";
+            wg.done(); });
+    }
+    wg.wait();
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    begin = HPS::GetCurrentUS();
+    std::vector<HPS::Address::ptr> all;
+    HPS::Address::Lookup(all, "svc.test");
+    LOG_INFO(g_logger) << "dedup: addr=" << results[0] << " last=" << results[9]
+                       << " queries=" << s_received["svc.test"] << " used=" << used / 1000 << "ms"
+                       << " cached=" << all.size() << " in " << (HPS::GetCurrentUS() - begin) << "us";
+}
+
+//! NXDOMAIN的否定缓存, hosts文件, AAAA, Uri
+void test_negative_hosts_v6()
+{
+    bool nx1 = HPS::Address::LookupAnyIPAddress("nx.test") == nullptr;
+    bool nx2 = HPS::Address::LookupAnyIPAddress("nx.test") == nullptr;
+    HPS::IPAddress::ptr local = HPS::Address::LookupAnyIPAddress("myhost.test:80");
+    HPS::IPAddress::ptr v6 = HPS::Address::LookupAnyIPAddress("v6.test:443", AF_INET6);
+    HPS::Address::ptr uri = HPS::Uri::Create("http://svc.test:8080/index")->createAddress();
+    LOG_INFO(g_logger) << "negative: nx=" << nx1 << nx2 << " queries=" << s_received["nx.test"]
+                       << " hosts=" << (local ? local->toString() : "null")
+                       << " v6=" << (v6 ? v6->toString() : "null")
+                       << " uri=" << (uri ? uri->toString() : "null");
+}
+
+//! 不应答的服务器只让当前协程等待超时, 不缓存失败
+void test_timeout()
+{
+    std::atomic<int> ticks = {0};
+    std::atomic<bool> ticking = {true};
+    HPS::Scheduler::GetThis()->schedule([&ticks, &ticking]()
+                                        {
+        while (ticking)
+        {
+            usleep(10 * 1000);
+            ++ticks;
+        } });
+    uint64_t begin = HPS::GetCurrentUS();
+    bool failed = HPS::Address::LookupAnyIPAddress("drop.test") == nullptr;
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    ticking = false;
+    usleep(20 * 1000);
+    LOG_INFO(g_logger) << "timeout: failed=" << failed << " queries=" << s_received["drop.test"]
+                       << " used=" << used / 1000 << "ms ticks=" << ticks;
+}
+
+//! 不是来自所查询服务器地址和端口的应答被忽略; 查询id不连续
+void test_spoof_and_id()
+{
+    HPS::IPAddress::ptr addr = HPS::Address::LookupAnyIPAddress("spoof.test");
+    for (int i = 0; i < 16; ++i)
+    {
+        HPS::Address::LookupAnyIPAddress("id" + std::to_string(i) + ".test");
+    }
+    int sequential = 0;
+    for (size_t i = 1; i < s_ids.size(); ++i)
+    {
+        if ((uint16_t)(s_ids[i - 1] + 1) == s_ids[i])
+        {
+            ++sequential;
+        }
+    }
+    LOG_INFO(g_logger) << "spoof: addr=" << (addr ? addr->toString() : "null")
+                       << " ids=" << s_ids.size() << " sequential=" << sequential;
+    ASSERT(addr && addr->toString() == "10.0.0.9:0");
+    ASSERT(sequential < (int)s_ids.size() / 2);
+}
+
+//! TTL过期后重新查询
+void test_ttl()
+{
+    int before = s_received["svc.test"];
+    usleep(1100 * 1000);
+    HPS::IPAddress::ptr addr = HPS::Address::LookupAnyIPAddress("svc.test");
+    LOG_INFO(g_logger) << "ttl: addr=" << (addr ? addr->toString() : "null")
+                       << " requeried=" << s_received["svc.test"] - before;
+}
+
+//! 按search补全后缀, 截断的应答不缓存, 解析失败时回退到getaddrinfo
+void test_search_fallback()
+{
+    HPS::IPAddress::ptr svc = HPS::Address::LookupAnyIPAddress("svc:80");
+    HPS::IPAddress::ptr absolute = HPS::Address::LookupAnyIPAddress("svc.");
+    HPS::Address::LookupAnyIPAddress("tc.test");
+    HPS::Address::LookupAnyIPAddress("tc.test");
+    //! 桩服务器对localhost返回NXDOMAIN, 测试用的hosts文件中也没有, 只有getaddrinfo能解析
+    HPS::IPAddress::ptr local = HPS::Address::LookupAnyIPAddress("localhost:80");
+    LOG_INFO(g_logger) << "search: svc=" << (svc ? svc->toString() : "null")
+                       << " corp=" << s_received["svc.corp.example"] << " test=" << s_received["svc.test"]
+                       << " absolute=" << (absolute ? absolute->toString() : "null") << " bare=" << s_received["svc"]
+                       << " tc=" << s_received["tc.test"] << " truncated=" << HPS::DnsMgr::GetInstance()->getStats().truncated
+                       << " localhost=" << (local ? local->toString() : "null");
+    ASSERT(svc && (svc->toString() == "10.0.0.1:80" || svc->toString() == "10.0.0.2:80"));
+    ASSERT(s_received["svc.corp.example"] == 1);
+    ASSERT(s_received["svc"] == 1);
+    ASSERT(s_received["tc.test"] == 2);
+    ASSERT(local && local->toString() == "127.0.0.1:80");
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    HPS::Config::Lookup<std::vector<std::string>>("dns.servers")->setValue({"127.0.0.1:5353"});
+    HPS::Config::Lookup<uint32_t>("dns.timeout")->setValue(100);
+    HPS::Config::Lookup<uint32_t>("dns.attempts")->setValue(1);
+    //! 服务器以dns.servers为准, resolv.conf只提供search
+    std::ofstream("/tmp/test_dns_resolv.conf") << "nameserver 192.0.2.1\nsearch corp.example test\noptions ndots:1\n";
+    std::ofstream("/tmp/test_dns_hosts") << "10.0.0.7 myhost.test\n";
+    HPS::Config::Lookup<std::string>("dns.resolv_conf")->setValue("/tmp/test_dns_resolv.conf");
+    HPS::Config::Lookup<std::string>("dns.hosts_file")->setValue("/tmp/test_dns_hosts");
+
+    HPS::IOManager iom(1, false, "dns");
+    HPS::Address::ptr addr = HPS::Address::LookupAnyIPAddress("127.0.0.1:5353");
+    iom.schedule(std::bind(stub_server, addr));
+    iom.schedule([]()
+                 {
+        test_dedup_and_cache();
+        test_negative_hosts_v6();
+        test_timeout();
+        test_spoof_and_id();
+        test_ttl();
+        test_search_fallback();
+        HPS::DnsResolver::Stats stats = HPS::DnsMgr::GetInstance()->getStats();
+        LOG_INFO(g_logger) << "stats: hits=" << stats.hits << " negative_hits=" << stats.negative_hits
+                           << " misses=" << stats.misses << " joined=" << stats.joined
+                           << " queries=" << stats.queries << " failures=" << stats.failures
+                           << " hosts_hits=" << stats.hosts_hits;
+        s_running = false; });
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include "../include/HPS.h"
+#include "../src/fiber_group.h"
+
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 父协程等待子协程时只挂起自身, 同一线程上的其他协程继续运行
+void test_wait_group()
+{
+    HPS::WaitGroup wg;
+    std::atomic<int> done = {0};
+    uint64_t begin = HPS::GetCurrentUS();
+    for (int ms : {30, 60, 10})
+    {
+        wg.add();
+        HPS::Scheduler::GetThis()->schedule([&wg, &done, ms]()
+                                            {
+            usleep(ms * 1000);
+            ++done;
+            wg.done(); });
+    }
+    wg.wait();
+    LOG_INFO(g_logger) << "wait_group: done=" << done
+                       << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 一个子协程失败, 其余子协程在检查点退出, join重新抛出第一个异常
+void test_first_exception()
+{
+    std::atomic<int> finished = {0};
+    std::atomic<int> stopped = {0};
+    std::string error;
+    uint64_t begin = HPS::GetCurrentUS();
+    HPS::FiberGroup group;
+    for (int i = 0; i < 4; ++i)
+    {
+        group.spawn([&group, &finished, &stopped]()
+                    {
+            for (int j = 0; j < 50; ++j)
+            {
+                if (group.isCancelled())
+                {
+                    ++stopped;
+                    return;
+                }
+                usleep(10 * 1000);
+            }
+            ++finished; });
+    }
+    group.spawn([]()
+                {
+        usleep(30 * 1000);
+        throw std::logic_error("upstream failed"); });
+    try
+    {
+        group.join();
+    }
+    catch (std::exception &ex)
+    {
+        error = ex.what();
+    }
+    LOG_INFO(g_logger) << "first_exception: error=" << error
+                       << " finished=" << finished << " stopped=" << stopped
+                       << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 请求超时时取消整个组, 子协程通过throwIfCancelled退出
+void test_timeout()
+{
+    std::atomic<int> steps = {0};
+    uint64_t begin = HPS::GetCurrentUS();
+    bool cancelled;
+    {
+        HPS::FiberGroup group;
+        group.cancelAfter(HPS::IOManager::GetThis(), 50);
+        for (int i = 0; i < 8; ++i)
+        {
+            group.spawn([&group, &steps]()
+                        {
+                while (true)
+                {
+                    group.throwIfCancelled();
+                    usleep(5 * 1000);
+                    ++steps;
+                } });
+        }
+        group.join();
+        cancelled = group.isCancelled();
+    }
+    LOG_INFO(g_logger) << "timeout: cancelled=" << cancelled << " steps=" << steps
+                       << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 组离开作用域时(如提前返回)取消并回收子协程
+void test_scope_exit()
+{
+    std::atomic<int> alive = {0};
+    uint64_t begin = HPS::GetCurrentUS();
+    {
+        HPS::FiberGroup group;
+        for (int i = 0; i < 100; ++i)
+        {
+            group.spawn([&group, &alive]()
+                        {
+                ++alive;
+                while (!group.isCancelled())
+                {
+                    usleep(1000);
+                }
+                --alive; });
+        }
+        usleep(10 * 1000);
+    }
+    LOG_INFO(g_logger) << "scope_exit: alive=" << alive
+                       << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    HPS::IOManager iom(2, false, "group");
+    iom.schedule([]()
+                 {
+        test_wait_group();
+        test_first_exception();
+        test_timeout();
+        test_scope_exit(); });
+    return 0;
+}
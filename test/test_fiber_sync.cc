@@ -0,0 +1,214 @@
+#include "../include/HPS.h"
+
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 持有协程锁期间做hook的IO, 同一线程上的其他协程照常运行
+void test_mutex_across_io()
+{
+    HPS::FiberMutex mutex;
+    std::atomic<int> ticks = {0};
+    std::atomic<bool> holding = {false};
+    int ticks_while_held = 0;
+    uint64_t waited_us = 0;
+    {
+        HPS::IOManager iom(1, false, "mutex_io");
+        iom.schedule([&]()
+                     {
+            HPS::FiberMutex::Lock lock(mutex);
+            holding = true;
+            int before = ticks;
+            usleep(100 * 1000);
+            ticks_while_held = ticks - before;
+            holding = false; });
+        iom.schedule([&]()
+                     {
+            while (!holding)
+            {
+                HPS::Fiber::YieldToReady();
+            }
+            uint64_t begin = HPS::GetCurrentUS();
+            HPS::FiberMutex::Lock lock(mutex);
+            waited_us = HPS::GetCurrentUS() - begin; });
+        iom.schedule([&]()
+                     {
+            for (int i = 0; i < 10; ++i)
+            {
+                usleep(5 * 1000);
+                ++ticks;
+            } });
+    }
+    LOG_INFO(g_logger) << "mutex across io: ticks_while_held=" << ticks_while_held
+                       << " waiter_blocked=" << waited_us << "us";
+}
+
+//! 多线程多协程在锁内让出, 计数不丢失
+void test_mutex_counter()
+{
+    HPS::FiberMutex mutex;
+    int64_t count = 0;
+    const int fibers = 100;
+    const int loops = 1000;
+    uint64_t begin = HPS::GetCurrentUS();
+    {
+        HPS::IOManager iom(2, false, "mutex_counter");
+        for (int i = 0; i < fibers; ++i)
+        {
+            iom.schedule([&]()
+                         {
+                for (int j = 0; j < loops; ++j)
+                {
+                    HPS::FiberMutex::Lock lock(mutex);
+                    int64_t v = count;
+                    if (j % 100 == 0)
+                    {
+                        HPS::Fiber::YieldToReady();
+                    }
+                    count = v + 1;
+                } });
+        }
+    }
+    LOG_INFO(g_logger) << "mutex counter: count=" << count
+                       << " expect=" << fibers * loops
+                       << " used=" << (HPS::GetCurrentUS() - begin) << "us";
+}
+
+//! 信号量限制同时进行IO的协程数量
+void test_semaphore()
+{
+    HPS::FiberSemaphore sem(3);
+    std::atomic<int> running = {0};
+    std::atomic<int> max_running = {0};
+    {
+        HPS::IOManager iom(2, false, "semaphore");
+        for (int i = 0; i < 20; ++i)
+        {
+            iom.schedule([&]()
+                         {
+                sem.wait();
+                int n = ++running;
+                int m = max_running;
+                while (n > m && !max_running.compare_exchange_weak(m, n))
+                    ;
+                usleep(10 * 1000);
+                --running;
+                sem.notify(); });
+        }
+    }
+    LOG_INFO(g_logger) << "semaphore: max_running=" << max_running
+                       << " concurrency=" << sem.getConcurrency();
+}
+
+//! 条件变量实现的生产者消费者
+void test_condition()
+{
+    HPS::FiberMutex mutex;
+    HPS::FiberCondition cond;
+    std::list<int> queue;
+    bool done = false;
+    int64_t sum = 0;
+    {
+        HPS::IOManager iom(2, false, "condition");
+        for (int c = 0; c < 4; ++c)
+        {
+            iom.schedule([&]()
+                         {
+                HPS::FiberMutex::Lock lock(mutex);
+                while (true)
+                {
+                    cond.wait(mutex, [&]()
+                              { return !queue.empty() || done; });
+                    if (queue.empty())
+                    {
+                        break;
+                    }
+                    sum += queue.front();
+                    queue.pop_front();
+                } });
+        }
+        iom.schedule([&]()
+                     {
+            for (int i = 1; i <= 1000; ++i)
+            {
+                {
+                    HPS::FiberMutex::Lock lock(mutex);
+                    queue.push_back(i);
+                }
+                cond.notify();
+                if (i % 100 == 0)
+                {
+                    usleep(1000);
+                }
+            }
+            HPS::FiberMutex::Lock lock(mutex);
+            done = true;
+            cond.notifyAll(); });
+    }
+    LOG_INFO(g_logger) << "condition: sum=" << sum << " expect=" << 1000 * 1001 / 2;
+}
+
+//! 读锁可以并发持有, 写锁独占
+void test_rwmutex()
+{
+    HPS::FiberRWMutex rwmutex;
+    std::atomic<int> readers = {0};
+    std::atomic<int> max_readers = {0};
+    std::atomic<int> writers = {0};
+    std::atomic<int> violations = {0};
+    {
+        HPS::IOManager iom(2, false, "rwmutex");
+        for (int i = 0; i < 20; ++i)
+        {
+            bool write = i % 5 == 0;
+            iom.schedule([&, write]()
+                         {
+                for (int j = 0; j < 5; ++j)
+                {
+                    if (write)
+                    {
+                        HPS::FiberRWMutex::WriteLock lock(rwmutex);
+                        if (++writers != 1 || readers != 0)
+                        {
+                            ++violations;
+                        }
+                        usleep(1000);
+                        --writers;
+                    }
+                    else
+                    {
+                        HPS::FiberRWMutex::ReadLock lock(rwmutex);
+                        int n = ++readers;
+                        int m = max_readers;
+                        while (n > m && !max_readers.compare_exchange_weak(m, n))
+                            ;
+                        if (writers != 0)
+                        {
+                            ++violations;
+                        }
+                        usleep(1000);
+                        --readers;
+                    }
+                } });
+        }
+    }
+    LOG_INFO(g_logger) << "rwmutex: max_readers=" << max_readers
+                       << " violations=" << violations;
+}
+
+//! 用法: test_fiber_sync [是否工作窃取]
+int main(int argc, char **argv)
+{
+    if (argc > 1 && atoi(argv[1]))
+    {
+        HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    }
+    g_logger->setLevel(HPS::LogLevel::INFO);
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    test_mutex_across_io();
+    test_mutex_counter();
+    test_semaphore();
+    test_condition();
+    test_rwmutex();
+    return 0;
+}
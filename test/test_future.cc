@@ -0,0 +1,165 @@
+#include "../include/HPS.h"
+#include "../src/future.h"
+#include "../src/http/http_connection.h"
+#include "../src/http/http_server.h"
+
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 模拟耗时的后端调用
+int backend(int ms)
+{
+    usleep(ms * 1000);
+    return ms;
+}
+
+//! 三个后端调用并发进行, 总耗时取决于最慢的一个
+void test_when_all()
+{
+    uint64_t begin = HPS::GetCurrentUS();
+    std::vector<HPS::Future<int>> calls;
+    for (int ms : {50, 80, 30})
+    {
+        calls.push_back(HPS::Async(nullptr, [ms]()
+                                   { return backend(ms); }));
+    }
+    std::vector<int> values = HPS::WhenAll(calls).get();
+    LOG_INFO(g_logger) << "when_all: values=" << values[0] << "," << values[1] << "," << values[2]
+                       << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 后续操作在另一个调度器上执行, 异常沿链传递
+void test_then(HPS::IOManager *other)
+{
+    int rt = HPS::Async(nullptr, []()
+                        { return backend(10); })
+                 .then(other, [](HPS::Future<int> f)
+                       { return f.get() * 2; })
+                 .then(other, [](HPS::Future<int> f)
+                       { return HPS::Scheduler::GetThis()->getName() + ":" + std::to_string(f.get()); })
+                 .then([](HPS::Future<std::string> f)
+                       { return f.get().size(); })
+                 .get();
+    HPS::Future<int> failed = HPS::Async(nullptr, []() -> int
+                                         { throw std::logic_error("backend down"); })
+                                  .then([](HPS::Future<int> f)
+                                        { return f.get() + 1; });
+    std::string error;
+    try
+    {
+        failed.get();
+    }
+    catch (std::exception &ex)
+    {
+        error = ex.what();
+    }
+    LOG_INFO(g_logger) << "then: size=" << rt << " error=" << error;
+}
+
+//! 不返回值的函数和后续操作的结果为Unit, 异常同样沿链传递
+void test_void()
+{
+    std::atomic<int> steps = {0};
+    HPS::Future<HPS::Unit> done = HPS::Async(nullptr, [&steps]()
+                                             { backend(10); ++steps; })
+                                      .then([&steps](HPS::Future<HPS::Unit> f)
+                                            { f.get(); ++steps; });
+    done.get();
+    bool failed = false;
+    try
+    {
+        HPS::Async(nullptr, []()
+                   { throw std::logic_error("backend down"); })
+            .then([](HPS::Future<HPS::Unit> f)
+                  { f.get(); })
+            .get();
+    }
+    catch (std::logic_error &)
+    {
+        failed = true;
+    }
+    LOG_INFO(g_logger) << "void: steps=" << steps << " failed=" << failed;
+    ASSERT(steps == 2);
+    ASSERT(failed);
+}
+
+//! 取最先返回的结果, 超时的调用得到FutureTimeout
+void test_any_and_timeout()
+{
+    std::vector<HPS::Future<int>> calls;
+    for (int ms : {60, 20, 40})
+    {
+        calls.push_back(HPS::Async(nullptr, [ms]()
+                                   { return backend(ms); }));
+    }
+    std::pair<size_t, int> first = HPS::WhenAny(calls).get();
+
+    HPS::Future<int> slow = HPS::Async(nullptr, []()
+                                       { return backend(200); })
+                                .withTimeout(HPS::IOManager::GetThis(), 50);
+    uint64_t begin = HPS::GetCurrentUS();
+    bool timeout = false;
+    try
+    {
+        slow.get();
+    }
+    catch (HPS::FutureTimeout &)
+    {
+        timeout = true;
+    }
+    LOG_INFO(g_logger) << "when_any: index=" << first.first << " value=" << first.second
+                       << " timeout=" << timeout
+                       << " waited=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 对上游的三个请求并发发出
+void test_http_fan_out()
+{
+    HPS::http::HttpServer::ptr server(new HPS::http::HttpServer(false));
+    HPS::Address::ptr addr = HPS::Address::LookupAnyIPAddress("127.0.0.1:8021");
+    if (!server->bind(addr))
+    {
+        LOG_ERROR(g_logger) << "bind " << *addr << " fail";
+        return;
+    }
+    server->getServletDispatch()->addServlet("/slow", [](HPS::http::HttpRequest::ptr req, HPS::http::HttpResponse::ptr rsp, HPS::http::HttpSession::ptr session)
+                                             {
+        int ms = atoi(req->getParam("ms", "0").c_str());
+        usleep(ms * 1000);
+        rsp->setBody(std::to_string(ms));
+        return 0; });
+    server->start();
+
+    HPS::http::HttpConnectionPool::ptr pool(new HPS::http::HttpConnectionPool(
+        "127.0.0.1", "", 8021, false, 10, 30 * 1000, 100));
+    uint64_t begin = HPS::GetCurrentUS();
+    std::vector<HPS::http::HttpResult::ptr> results = HPS::WhenAll(std::vector<HPS::Future<HPS::http::HttpResult::ptr>>{
+                                                                       pool->asyncGet("/slow?ms=50", 1000),
+                                                                       pool->asyncGet("/slow?ms=80", 1000),
+                                                                       pool->asyncGet("/slow?ms=30", 1000)})
+                                                          .get();
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    std::stringstream ss;
+    for (auto &i : results)
+    {
+        ss << i->result << ":" << (i->response ? i->response->getBody() : i->error) << " ";
+    }
+    LOG_INFO(g_logger) << "http fan_out: " << ss.str() << "used=" << used / 1000 << "ms";
+    server->stop();
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    HPS::IOManager other(1, false, "other");
+    HPS::IOManager iom(2, false, "main");
+    iom.schedule([&other]()
+                 {
+        test_when_all();
+        test_then(&other);
+        test_void();
+        test_any_and_timeout();
+        test_http_fan_out(); });
+    return 0;
+}
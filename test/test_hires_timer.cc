@@ -0,0 +1,105 @@
+#include "../include/HPS.h"
+
+#include <time.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 微秒精度的睡眠: 每次睡眠的平均耗时
+void test_sleep()
+{
+    const int count = 500;
+    uint64_t begin = HPS::GetMonotonicUS();
+    for (int i = 0; i < count; ++i)
+    {
+        usleep(200);
+    }
+    uint64_t t1 = HPS::GetMonotonicUS();
+    struct timespec ts = {0, 1500 * 1000};
+    for (int i = 0; i < 100; ++i)
+    {
+        nanosleep(&ts, nullptr);
+    }
+    uint64_t t2 = HPS::GetMonotonicUS();
+    //! 绝对时间的clock_nanosleep: 按固定节拍推进, 误差不累积
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < 100; ++i)
+    {
+        next.tv_nsec += 500 * 1000;
+        if (next.tv_nsec >= 1000 * 1000 * 1000)
+        {
+            next.tv_nsec -= 1000 * 1000 * 1000;
+            ++next.tv_sec;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+    }
+    uint64_t t3 = HPS::GetMonotonicUS();
+    LOG_INFO(g_logger) << "sleep: usleep(200)=" << (t1 - begin) / count << "us"
+                       << " nanosleep(1.5ms)=" << (t2 - t1) / 100 << "us"
+                       << " clock_nanosleep(abs 0.5ms)=" << (t3 - t2) / 100 << "us";
+}
+
+//! 令牌桶限速: 每秒rate个令牌, 令牌不足时睡眠到下一个令牌产生
+void test_token_bucket(uint64_t rate)
+{
+    const uint64_t interval_us = 1000 * 1000 / rate;
+    const int total = 2000;
+    uint64_t begin = HPS::GetMonotonicUS();
+    uint64_t tokens = 0;
+    uint64_t refilled = begin;
+    for (int sent = 0; sent < total;)
+    {
+        uint64_t now = HPS::GetMonotonicUS();
+        uint64_t add = (now - refilled) / interval_us;
+        tokens = std::min<uint64_t>(tokens + add, 8);
+        refilled += add * interval_us;
+        if (tokens == 0)
+        {
+            usleep(refilled + interval_us - now);
+            continue;
+        }
+        --tokens;
+        ++sent;
+    }
+    uint64_t used = HPS::GetMonotonicUS() - begin;
+    LOG_INFO(g_logger) << "token_bucket: rate=" << rate << "/s achieved=" << total * 1000 * 1000ull / used
+                       << "/s used=" << used / 1000 << "ms";
+}
+
+//! 微秒精度的循环定时器
+void test_recurring()
+{
+    std::atomic<int> fired = {0};
+    HPS::Timer::ptr timer = HPS::IOManager::GetThis()->addTimerUs(250, [&fired]()
+                                                                  { ++fired; },
+                                                                  true);
+    usleep(100 * 1000);
+    timer->cancel();
+    LOG_INFO(g_logger) << "recurring: 250us fired=" << fired << " in 100ms";
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    //! 参数为wheel时使用时间轮引擎(1毫秒精度), 为0时关闭epoll_pwait2
+    if (argc > 1)
+    {
+        if (std::string(argv[1]) == "wheel")
+        {
+            HPS::Config::Lookup<std::string>("timer.engine")->setValue("wheel");
+        }
+        else if (std::string(argv[1]) == "0")
+        {
+            HPS::Config::Lookup<bool>("iomanager.hires_wait")->setValue(false);
+        }
+    }
+    HPS::IOManager iom(1, false, "hires_timer");
+    iom.schedule([]()
+                 {
+        test_sleep();
+        test_token_bucket(5000);
+        test_token_bucket(20000);
+        test_recurring(); });
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include "../include/HPS.h"
+#include "../src/fd_manager.h"
+#include "../src/fiber_group.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/select.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 同一线程上的计时协程, 线程被阻塞时计数停止增长
+static std::atomic<bool> s_ticking = {true};
+static std::atomic<int> s_ticks = {0};
+
+void ticker()
+{
+    while (s_ticking)
+    {
+        usleep(5 * 1000);
+        ++s_ticks;
+    }
+}
+
+//! 以阻塞方式编写的第三方库: 自己用poll/select/epoll等待句柄
+namespace blocking_lib
+{
+    //! 等待可读, 超时返回false
+    bool wait_readable(int fd, int timeout_ms)
+    {
+        pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        return poll(&pfd, 1, timeout_ms) == 1 && (pfd.revents & POLLIN);
+    }
+
+    //! 用select睡眠
+    void nap(int ms)
+    {
+        timeval tv;
+        tv.tv_sec = ms / 1000;
+        tv.tv_usec = (ms % 1000) * 1000;
+        select(0, nullptr, nullptr, nullptr, &tv);
+    }
+
+    //! 自带epoll事件循环, 返回就绪的事件数
+    int run_once(int epfd, int timeout_ms)
+    {
+        epoll_event events[8];
+        return epoll_wait(epfd, events, 8, timeout_ms);
+    }
+}
+
+void test_poll_select()
+{
+    int fds[2];
+    pipe(fds);
+    s_ticks = 0;
+    uint64_t begin = HPS::GetCurrentUS();
+    bool timeout = !blocking_lib::wait_readable(fds[0], 30);
+    uint64_t t1 = HPS::GetCurrentUS();
+    HPS::IOManager::GetThis()->schedule([fds]()
+                                        {
+        usleep(40 * 1000);
+        write(fds[1], "x", 1); });
+    bool ready = blocking_lib::wait_readable(fds[0], 1000);
+    uint64_t t2 = HPS::GetCurrentUS();
+    char c;
+    //! 管道为阻塞模式: 数据读完后read只挂起当前协程
+    HPS::IOManager::GetThis()->schedule([fds]()
+                                        {
+        usleep(20 * 1000);
+        write(fds[1], "y", 1); });
+    read(fds[0], &c, 1);
+    read(fds[0], &c, 1);
+    uint64_t t3 = HPS::GetCurrentUS();
+    blocking_lib::nap(30);
+    uint64_t t4 = HPS::GetCurrentUS();
+    LOG_INFO(g_logger) << "poll: timeout=" << timeout << " " << (t1 - begin) / 1000 << "ms"
+                       << " ready=" << ready << " " << (t2 - t1) / 1000 << "ms"
+                       << " pipe_read=" << c << " " << (t3 - t2) / 1000 << "ms"
+                       << " select_nap=" << (t4 - t3) / 1000 << "ms ticks=" << s_ticks;
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_epoll_wait()
+{
+    int efd = eventfd(0, 0);
+    int epfd = epoll_create1(0);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = efd;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev);
+    s_ticks = 0;
+    HPS::IOManager::GetThis()->schedule([efd]()
+                                        {
+        usleep(40 * 1000);
+        uint64_t v = 1;
+        write(efd, &v, sizeof(v)); });
+    uint64_t begin = HPS::GetCurrentUS();
+    int n = blocking_lib::run_once(epfd, 1000);
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    uint64_t v = 0;
+    read(efd, &v, sizeof(v));
+    int idle = blocking_lib::run_once(epfd, 20);
+    LOG_INFO(g_logger) << "epoll_wait: events=" << n << " value=" << v << " used=" << used / 1000
+                       << "ms idle=" << idle << " ticks=" << s_ticks;
+    close(epfd);
+    close(efd);
+}
+
+//! accept4接入的连接上用sendfile发送文件, splice从管道转发
+void test_accept4_sendfile_splice()
+{
+    std::string path = "/tmp/test_hook_io.dat";
+    std::string data(4 * 1024 * 1024, 'a');
+    int file = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    write(file, data.data(), data.size());
+
+    HPS::Address::ptr addr = HPS::Address::LookupAnyIPAddress("127.0.0.1:0");
+    int lfd = socket(AF_INET, SOCK_STREAM, 0);
+    bind(lfd, addr->getAddr(), addr->getAddrLen());
+    listen(lfd, 16);
+    sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    getsockname(lfd, (sockaddr *)&local, &len);
+    HPS::Address::ptr server = HPS::Address::Create((sockaddr *)&local, len);
+
+    std::atomic<size_t> received = {0};
+    HPS::WaitGroup wg;
+    wg.add();
+    HPS::IOManager::GetThis()->schedule([server, &received, &wg]()
+                                        {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        connect(fd, server->getAddr(), server->getAddrLen());
+        char buf[64 * 1024];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            received += n;
+            //! 慢速的接收方让发送方写满缓冲区
+            usleep(1000);
+        }
+        close(fd);
+        wg.done(); });
+
+    s_ticks = 0;
+    uint64_t begin = HPS::GetCurrentUS();
+    int cfd = accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+    off_t off = 0;
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = sendfile(cfd, file, &off, data.size() - sent);
+        if (n <= 0)
+        {
+            break;
+        }
+        sent += n;
+    }
+    int fds[2];
+    pipe(fds);
+    HPS::IOManager::GetThis()->schedule([fds]()
+                                        {
+        usleep(10 * 1000);
+        write(fds[1], "spliced", 7);
+        close(fds[1]); });
+    ssize_t spliced = splice(fds[0], nullptr, cfd, nullptr, 1024, 0);
+    close(fds[0]);
+    close(cfd);
+    wg.wait();
+    LOG_INFO(g_logger) << "accept4/sendfile/splice: sent=" << sent << " spliced=" << spliced
+                       << " received=" << received << " used=" << (HPS::GetCurrentUS() - begin) / 1000
+                       << "ms ticks=" << s_ticks;
+    close(lfd);
+    close(file);
+    unlink(path.c_str());
+}
+
+//! dup/dup2后句柄上下文与实际句柄一致
+void test_dup()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    int copy = dup(sock);
+    bool copy_socket = HPS::FdMgr::GetInstance()->get(copy)->isSocket();
+    int fds[2];
+    pipe2(fds, O_NONBLOCK);
+    dup2(fds[0], copy);
+    HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(copy);
+    char c;
+    ssize_t n = read(copy, &c, 1);
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    bool pair_socket = HPS::FdMgr::GetInstance()->get(sv[1])->isSocket();
+    LOG_INFO(g_logger) << "dup: copy_socket=" << copy_socket
+                       << " after_dup2 socket=" << ctx->isSocket() << " pollable=" << ctx->isPollable()
+                       << " user_nonblock=" << ctx->getUserNonblock()
+                       << " read=" << n << " eagain=" << (errno == EAGAIN)
+                       << " socketpair=" << pair_socket;
+    for (int fd : {sock, copy, fds[0], fds[1], sv[0], sv[1]})
+    {
+        close(fd);
+    }
+}
+
+//! 继承的管道(未经hook创建)不被改为非阻塞; poll与阻塞读等待同一句柄时共享注册
+void test_inherited_and_shared_poll()
+{
+    int raw[2];
+    syscall(SYS_pipe2, raw, 0);
+    HPS::FdCtx::ptr ctx = HPS::FdMgr::GetInstance()->get(raw[0], true);
+    bool inherited_nonblock = fcntl(raw[0], F_GETFL) & O_NONBLOCK;
+    bool inherited_pollable = ctx->isPollable();
+    HPS::FdMgr::GetInstance()->del(raw[0]);
+    close(raw[0]);
+    close(raw[1]);
+
+    int fds[2];
+    pipe(fds);
+    std::atomic<bool> got = {false};
+    HPS::WaitGroup wg;
+    wg.add();
+    HPS::IOManager::GetThis()->schedule([fds, &got, &wg]()
+                                        {
+        char c;
+        got = read(fds[0], &c, 1) == 1;
+        wg.done(); });
+    uint64_t written = 0;
+    HPS::IOManager::GetThis()->schedule([fds, &written]()
+                                        {
+        usleep(50 * 1000);
+        written = HPS::GetCurrentUS();
+        write(fds[1], "ab", 2); });
+    //! 等读协程先登记读事件
+    usleep(10 * 1000);
+    bool shared = HPS::IOManager::GetThis()->hasEvent(fds[0], HPS::IOManager::READ);
+    pollfd pfd;
+    pfd.fd = fds[0];
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int rt = poll(&pfd, 1, 1000);
+    uint64_t latency = HPS::GetCurrentUS() - written;
+    wg.wait();
+    LOG_INFO(g_logger) << "inherited pipe: nonblock=" << inherited_nonblock << " pollable=" << inherited_pollable
+                       << " shared poll: shared=" << shared << " rt=" << rt << " read=" << got
+                       << " latency=" << latency << "us";
+    ASSERT(!inherited_nonblock && !inherited_pollable);
+    ASSERT(shared && rt == 1 && (pfd.revents & POLLIN) && got);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+//! 未经hook创建的句柄在hook之外关闭后, 同号的新句柄仍能等到事件
+void test_reused_fd()
+{
+    HPS::IOManager *iom = HPS::IOManager::GetThis();
+    std::atomic<int> fired = {0};
+    int fired_by[2] = {-1, -1};
+    for (int i = 0; i < 2; ++i)
+    {
+        int fd = syscall(SYS_eventfd2, 0, EFD_NONBLOCK);
+        iom->addEvent(fd, HPS::IOManager::READ, [&fired, &fired_by, i]()
+                      { fired_by[i] = ++fired; });
+        uint64_t one = 1;
+        write(fd, &one, sizeof(one));
+        for (int j = 0; j < 100 && fired == i; ++j)
+        {
+            usleep(10 * 1000);
+        }
+        iom->cancelAll(fd);
+        syscall(SYS_close, fd);
+    }
+    LOG_INFO(g_logger) << "reused_fd: first=" << fired_by[0] << " second=" << fired_by[1];
+    ASSERT(fired_by[1] == 2);
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    //! 参数为1时使用持久注册的epoll
+    if (argc > 1 && atoi(argv[1]))
+    {
+        HPS::Config::Lookup<bool>("iomanager.persistent_epoll")->setValue(true);
+    }
+    HPS::IOManager iom(1, false, "hook_io");
+    iom.schedule(ticker);
+    iom.schedule([]()
+                 {
+        test_poll_select();
+        test_epoll_wait();
+        test_accept4_sendfile_splice();
+        test_dup();
+        test_reused_fd();
+        test_inherited_and_shared_poll();
+        s_ticking = false; });
+    return 0;
+}
@@ -32,6 +32,15 @@ void run()
                 rsp->setBody("Glob:\r\n" + req->toString());
                 return 0; });
 
+    //! 输出调度器运行统计
+    sd->addServlet("/_/status", [](HPS::http::HttpRequest::ptr req, HPS::http::HttpResponse::ptr rsp, HPS::http::HttpSession::ptr session)
+                   {
+                std::stringstream ss;
+                HPS::Scheduler::GetThis()->dumpMetrics(ss);
+                rsp->setHeader("Content-Type", "text/plain");
+                rsp->setBody(ss.str());
+                return 0; });
+
     sd->addGlobServlet("/sylarx/*", [](HPS::http::HttpRequest::ptr req, HPS::http::HttpResponse::ptr rsp, HPS::http::HttpSession::ptr session)
                        {
                 rsp->setBody(XX(<html>
@@ -53,10 +62,21 @@ void run()
     server->start();
 }
 
+//! 用法: test_http_server [线程数] [是否多reactor]
 int main(int argc, char **argv)
 {
-    HPS::IOManager iom(1);
+    size_t threads = argc > 1 ? atoi(argv[1]) : 1;
+    bool multi_reactor = argc > 2 && atoi(argv[2]);
+    HPS::IOManager iom(threads, true, "main", multi_reactor);
     // worker.reset(new HPS::IOManager(3, false, "worker"));
     iom.schedule(run);
+    //! 定期输出被其他线程的epoll_wait唤醒的比例
+    iom.addTimer(5000, [&iom]()
+                 {
+        HPS::IOManager::WakeupStats stats = iom.getWakeupStats();
+        LOG_INFO(g_logger) << "multi_reactor=" << iom.isMultiReactor()
+                           << " fd_wakeups=" << stats.fd_wakeups
+                           << " cross_thread_wakeups=" << stats.cross_thread_wakeups; },
+                 true);
     return 0;
 }
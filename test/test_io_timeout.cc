@@ -0,0 +1,134 @@
+#include "../include/HPS.h"
+#include "fd_manager.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 统计全局的operator new调用次数
+static std::atomic<uint64_t> s_allocs = {0};
+
+void *operator new(size_t size)
+{
+    ++s_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static const int s_warmup = 1000;
+static const int s_cycles = 10000;
+
+//! 读协程每次都阻塞在带读超时的read上, 对端线程收到回复后才发送下一个字节
+void ping_pong(const std::string &mode)
+{
+    int fds[2];
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ASSERT(!rt);
+    HPS::Semaphore done;
+    uint64_t allocs = 0;
+    int errors = 0;
+    //! 不在协程中运行, 使用原始的阻塞读写
+    HPS::Thread::ptr peer(new HPS::Thread([&]()
+                                          {
+        char c = 'x';
+        for(int i = 0; i < s_warmup + s_cycles; ++i) {
+            if(write(fds[1], &c, 1) != 1 || read(fds[1], &c, 1) != 1) {
+                break;
+            }
+        } }, "peer"));
+    {
+        HPS::IOManager iom(1, false, mode);
+        iom.schedule([&]()
+                     {
+            HPS::FdMgr::GetInstance()->get(fds[0], true);
+            timeval tv = {1, 0};
+            setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            char c = 0;
+            uint64_t begin = 0;
+            for(int i = 0; i < s_warmup + s_cycles; ++i) {
+                if(i == s_warmup) {
+                    begin = s_allocs;
+                }
+                if(read(fds[0], &c, 1) != 1 || write(fds[0], &c, 1) != 1) {
+                    ++errors;
+                    break;
+                }
+            }
+            allocs = s_allocs - begin;
+            done.notify(); });
+        done.wait();
+    }
+    peer->join();
+    close(fds[0]);
+    close(fds[1]);
+    LOG_INFO(g_logger) << "mode=" << mode << " cycles=" << s_cycles
+                       << " allocations=" << allocs
+                       << " allocations/cycle=" << (double)allocs / s_cycles
+                       << " errors=" << errors;
+}
+
+//! 超时仍然按时返回ETIMEDOUT
+void test_timeout()
+{
+    int fds[2];
+    int rt = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    ASSERT(!rt);
+    HPS::IOManager iom(1, false, "timeout");
+    iom.schedule([fds]()
+                 {
+        HPS::FdMgr::GetInstance()->get(fds[0], true);
+        timeval tv = {0, 100 * 1000};
+        setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        for(int i = 0; i < 3; ++i) {
+            char c = 0;
+            uint64_t begin = HPS::GetCurrentMS();
+            ssize_t n = read(fds[0], &c, 1);
+            LOG_INFO(g_logger) << "read timeout n=" << n << " errno=" << errno
+                               << " (" << strerror(errno) << ") used="
+                               << (HPS::GetCurrentMS() - begin) << "ms";
+        }
+        close(fds[0]);
+        close(fds[1]); });
+}
+
+int main(int argc, char **argv)
+{
+    test_timeout();
+    //! 默认调度器的任务队列为std::list, 每次唤醒协程入队分配一个链表节点
+    ping_pong("list");
+    HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    ping_pong("work_stealing");
+    HPS::Config::Lookup<std::string>("timer.engine")->setValue("wheel");
+    ping_pong("work_stealing+wheel");
+    return 0;
+}
@@ -73,9 +73,61 @@ void test_timer()
         true);
 }
 
+//! 线程池外突发调度大量任务, 统计写eventfd的次数
+void test_tickle(bool multi_reactor)
+{
+    HPS::IOManager iom(4, false, "tickle", multi_reactor);
+    std::atomic<int> done = {0};
+    for (int round = 0; round < 5; ++round)
+    {
+        //! 等待所有线程进入idle
+        usleep(100 * 1000);
+        uint64_t before = iom.getSyscallStats().tickle;
+        for (int i = 0; i < 1000; ++i)
+        {
+            iom.schedule([&done]()
+                         { ++done; });
+        }
+        usleep(100 * 1000);
+        LOG_INFO(g_logger) << "multi_reactor=" << multi_reactor << " round=" << round
+                           << " scheduled=1000 tickle_writes=" << iom.getSyscallStats().tickle - before
+                           << " done=" << done;
+    }
+}
+
+//! 线程池外逐个调度任务, 每次等任务执行后再调度下一个, 统计最长的唤醒延迟;
+//! 任务恰好在工作线程进入idle前入队时也必须被及时执行
+void test_wakeup_latency(bool multi_reactor)
+{
+    HPS::IOManager iom(4, false, "latency", multi_reactor);
+    std::atomic<uint64_t> ran = {0};
+    uint64_t max_us = 0;
+    uint64_t total_us = 0;
+    const int rounds = 20000;
+    for (int i = 0; i < rounds; ++i)
+    {
+        uint64_t begin = HPS::GetCurrentUS();
+        iom.schedule([&ran]()
+                     { ran = HPS::GetCurrentUS(); });
+        while (ran == 0)
+        {
+        }
+        uint64_t used = ran - begin;
+        ran = 0;
+        max_us = std::max(max_us, used);
+        total_us += used;
+    }
+    LOG_INFO(g_logger) << "multi_reactor=" << multi_reactor << " wakeups=" << rounds
+                       << " avg_us=" << total_us / rounds << " max_us=" << max_us;
+}
+
 int main(int argc, char **argv)
 {
     test1();
+    test_tickle(false);
+    test_tickle(true);
+    test_wakeup_latency(false);
+    test_wakeup_latency(true);
     // test_timer();
     return 0;
 }
@@ -0,0 +1,141 @@
+#include "../include/HPS.h"
+#include "mpsc_queue.h"
+
+#include <list>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const int s_producers = 4;
+static const int s_batch = 256;
+static const int s_rounds = 1000;
+
+struct Item : public HPS::MpscNode
+{
+    int value = 0;
+};
+
+//! 每个生产者每轮发布s_batch个元素,对应IOManager一轮epoll_wait唤醒的协程
+void bench_mpsc()
+{
+    HPS::MpscQueue queue;
+    std::vector<std::unique_ptr<Item[]>> items;
+    for (int p = 0; p < s_producers; ++p)
+    {
+        items.emplace_back(new Item[s_batch * s_rounds]);
+    }
+    std::atomic<bool> done = {false};
+    uint64_t consumed = 0;
+
+    uint64_t begin = HPS::GetCurrentUS();
+    HPS::Thread::ptr consumer(new HPS::Thread([&]()
+                                              {
+        while(true) {
+            HPS::MpscNode* node = queue.pop();
+            if(node) {
+                ++consumed;
+                continue;
+            }
+            if(done && queue.empty()) {
+                break;
+            }
+        } }, "mpsc_consumer"));
+
+    std::vector<HPS::Thread::ptr> thrs;
+    for (int p = 0; p < s_producers; ++p)
+    {
+        thrs.push_back(HPS::Thread::ptr(new HPS::Thread([&, p]()
+                                                        {
+            for(int r = 0; r < s_rounds; ++r) {
+                Item* v = items[p].get() + r * s_batch;
+                for(int i = 0; i + 1 < s_batch; ++i) {
+                    v[i].next.store(&v[i + 1], std::memory_order_relaxed);
+                }
+                queue.pushChain(&v[0], &v[s_batch - 1]);
+            } }, "mpsc_" + std::to_string(p))));
+    }
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    done = true;
+    consumer->join();
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    LOG_INFO(g_logger) << "mpsc batch publish: items=" << consumed
+                       << " used=" << used << "us"
+                       << " ops/s=" << (consumed * 1000000.0 / used);
+}
+
+void bench_list_mutex()
+{
+    HPS::Mutex mutex;
+    std::list<int> queue;
+    std::atomic<bool> done = {false};
+    uint64_t consumed = 0;
+
+    uint64_t begin = HPS::GetCurrentUS();
+    HPS::Thread::ptr consumer(new HPS::Thread([&]()
+                                              {
+        while(true) {
+            HPS::Mutex::Lock lock(mutex);
+            if(!queue.empty()) {
+                queue.pop_front();
+                ++consumed;
+                continue;
+            }
+            if(done) {
+                break;
+            }
+        } }, "list_consumer"));
+
+    std::vector<HPS::Thread::ptr> thrs;
+    for (int p = 0; p < s_producers; ++p)
+    {
+        thrs.push_back(HPS::Thread::ptr(new HPS::Thread([&]()
+                                                        {
+            for(int r = 0; r < s_rounds; ++r) {
+                //! 与Scheduler::schedule相同,每个元素加锁一次
+                for(int i = 0; i < s_batch; ++i) {
+                    HPS::Mutex::Lock lock(mutex);
+                    queue.push_back(i);
+                }
+            } }, "list_" + std::to_string(p))));
+    }
+    for (auto &i : thrs)
+    {
+        i->join();
+    }
+    done = true;
+    consumer->join();
+    uint64_t used = HPS::GetCurrentUS() - begin;
+    LOG_INFO(g_logger) << "list+mutex per-item: items=" << consumed
+                       << " used=" << used << "us"
+                       << " ops/s=" << (consumed * 1000000.0 / used);
+}
+
+void test_task_batch()
+{
+    //! IOManager::idle的路径: 一批任务通过唤醒队列一次发布
+    static std::atomic<int> s_run = {0};
+    {
+        HPS::Scheduler sc(2, false, "batch");
+        sc.start();
+        HPS::Scheduler::TaskBatch batch(&sc);
+        for (int i = 0; i < 1000; ++i)
+        {
+            std::function<void()> cb = []()
+            { ++s_run; };
+            batch.add(cb);
+        }
+        sc.submit(batch);
+        sc.stop();
+    }
+    LOG_INFO(g_logger) << "task batch run=" << s_run;
+}
+
+int main(int argc, char **argv)
+{
+    bench_list_mutex();
+    bench_mpsc();
+    test_task_batch();
+    return 0;
+}
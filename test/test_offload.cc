@@ -0,0 +1,161 @@
+#include "../include/HPS.h"
+#include "../src/fiber_group.h"
+#include "../src/offload.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 同一线程上的计时协程, 线程被阻塞时计数停止增长
+static std::atomic<bool> s_ticking = {false};
+static std::atomic<int> s_ticks = {0};
+
+void ticker()
+{
+    while (s_ticking)
+    {
+        usleep(1000);
+        ++s_ticks;
+    }
+}
+
+//! 阻塞调用交给线程池, 等待期间计时协程照常运行; 异常传回调用方
+void test_blocking_call()
+{
+    s_ticks = 0;
+    uint64_t begin = HPS::GetCurrentUS();
+    int rt = HPS::OffloadMgr::GetInstance()->call([]()
+                                                  {
+        //! 线程池中没有hook, 真正阻塞50ms
+        usleep(50 * 1000);
+        return 42; });
+    std::string error;
+    try
+    {
+        HPS::OffloadMgr::GetInstance()->run([]()
+                                            { throw std::runtime_error("bad key file"); });
+    }
+    catch (std::exception &ex)
+    {
+        error = ex.what();
+    }
+    LOG_INFO(g_logger) << "blocking_call: rt=" << rt << " error=" << error
+                       << " ticks=" << s_ticks << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! hook的普通文件读写/刷盘自动交给线程池
+void test_file_io()
+{
+    std::string path = "/tmp/test_offload.dat";
+    std::string block(1024 * 1024, 'x');
+    uint64_t before = HPS::OffloadMgr::GetInstance()->getStats().submitted;
+    s_ticks = 0;
+    uint64_t begin = HPS::GetCurrentUS();
+    int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    size_t bytes = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        bytes += write(fd, block.data(), block.size());
+    }
+    fsync(fd);
+    for (off_t off = 0; off < (off_t)bytes; off += block.size())
+    {
+        pread(fd, &block[0], block.size(), off);
+    }
+    //! 小的读写直接执行
+    char small[16];
+    pread(fd, small, sizeof(small), 0);
+    close(fd);
+    unlink(path.c_str());
+    LOG_INFO(g_logger) << "file_io: bytes=" << bytes
+                       << " offloaded=" << HPS::OffloadMgr::GetInstance()->getStats().submitted - before
+                       << " ticks=" << s_ticks << " used=" << (HPS::GetCurrentUS() - begin) / 1000 << "ms";
+}
+
+//! 排队达到上限时在调用方执行
+void test_overflow()
+{
+    HPS::OffloadPool pool(1, 2, "small");
+    HPS::WaitGroup wg;
+    for (int i = 0; i < 6; ++i)
+    {
+        wg.add();
+        HPS::Scheduler::GetThis()->schedule([&pool, &wg]()
+                                            {
+            pool.run([]()
+                     { usleep(10 * 1000); });
+            wg.done(); });
+    }
+    wg.wait();
+    HPS::OffloadPool::Stats stats = pool.getStats();
+    LOG_INFO(g_logger) << "overflow: submitted=" << stats.submitted << " overflow=" << stats.overflow
+                       << " max_queued=" << stats.max_queued;
+}
+
+//! 共享栈上的协程读文件: 挂起时栈被换出, 调用在协程中直接执行, 其他协程的栈不受影响
+void test_shared_stack()
+{
+    HPS::Config::Lookup<bool>("scheduler.shared_stack")->setValue(true);
+    HPS::Config::Lookup<uint32_t>("fiber.shared_stack_count")->setValue(1);
+    std::string path = "/tmp/test_offload_shared.dat";
+    int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+    std::string block(8 * 1024 * 1024, 'y');
+    write(fd, block.data(), block.size());
+    close(fd);
+
+    std::atomic<ssize_t> n = {0};
+    std::atomic<int> broken = {0};
+    uint64_t before = HPS::OffloadMgr::GetInstance()->getStats().submitted;
+    {
+        HPS::IOManager iom(1, false, "shared");
+        for (int i = 0; i < 50; ++i)
+        {
+            iom.schedule([i, &broken]()
+                         {
+                char buf[512];
+                memset(buf, 'a' + i % 26, sizeof(buf));
+                for (int k = 0; k < 20; ++k)
+                {
+                    usleep(50);
+                }
+                if (buf[0] != 'a' + i % 26 || buf[sizeof(buf) - 1] != buf[0])
+                {
+                    ++broken;
+                } });
+        }
+        iom.schedule([&path, &n]()
+                     {
+            std::vector<char> buf(8 * 1024 * 1024);
+            int fd = open(path.c_str(), O_RDONLY);
+            n = read(fd, &buf[0], buf.size());
+            close(fd); });
+    }
+    unlink(path.c_str());
+    HPS::Config::Lookup<bool>("scheduler.shared_stack")->setValue(false);
+    LOG_INFO(g_logger) << "shared_stack: read=" << n << " broken=" << broken
+                       << " offloaded=" << HPS::OffloadMgr::GetInstance()->getStats().submitted - before;
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::WARN);
+    {
+        HPS::IOManager iom(1, false, "main");
+        s_ticking = true;
+        iom.schedule(ticker);
+        iom.schedule([]()
+                     {
+            test_blocking_call();
+            test_file_io();
+            test_overflow();
+            s_ticking = false;
+            HPS::OffloadPool::Stats stats = HPS::OffloadMgr::GetInstance()->getStats();
+            LOG_INFO(g_logger) << "stats: threads=" << stats.threads << " submitted=" << stats.submitted
+                               << " completed=" << stats.completed << " overflow=" << stats.overflow
+                               << " max_queued=" << stats.max_queued << " wait_us=" << stats.wait_us
+                               << " run_us=" << stats.run_us; });
+    }
+    test_shared_stack();
+    return 0;
+}
@@ -0,0 +1,177 @@
+#include "../include/HPS.h"
+
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+//! 统计当前线程的operator new调用次数, 只计入调度方自身的分配
+static thread_local uint64_t t_allocs = 0;
+
+void *operator new(size_t size)
+{
+    ++t_allocs;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+static const int s_rounds = 100;
+static const int s_tasks = 1000;
+static std::atomic<int> s_done = {0};
+
+void noop()
+{
+    ++s_done;
+}
+
+//! 与TcpServer::handleClient相同形式的std::bind
+class Session : public std::enable_shared_from_this<Session>
+{
+public:
+    void handle(int fd) { ++s_done; }
+};
+
+//! 每轮调度s_tasks个任务, 等待执行完后再进入下一轮; 第一轮为预热
+template <class Schedule>
+uint64_t bench(const std::string &name, Schedule schedule_one, std::function<void()> prepare = nullptr)
+{
+    HPS::Scheduler sc(1, false, name);
+    sc.start();
+    uint64_t allocs = 0;
+    for (int r = 0; r < s_rounds; ++r)
+    {
+        s_done = 0;
+        if (prepare)
+        {
+            prepare();
+        }
+        uint64_t begin = t_allocs;
+        for (int i = 0; i < s_tasks; ++i)
+        {
+            schedule_one(sc, i);
+        }
+        if (r > 0)
+        {
+            allocs += t_allocs - begin;
+        }
+        while (s_done < s_tasks)
+        {
+            usleep(100);
+        }
+    }
+    sc.stop();
+    uint64_t schedules = (uint64_t)(s_rounds - 1) * s_tasks;
+    LOG_INFO(g_logger) << "case=" << name
+                       << " work_stealing=" << sc.isWorkStealing()
+                       << " schedules=" << schedules
+                       << " allocations=" << allocs
+                       << " allocations/schedule=" << (double)allocs / schedules;
+    return allocs;
+}
+
+//! 构造并移动s_tasks个回调, 返回分配次数; inlined为回调是否内联存放
+template <class F>
+uint64_t count_callback(F make, bool inlined)
+{
+    uint64_t begin = t_allocs;
+    for (int i = 0; i < s_tasks; ++i)
+    {
+        HPS::Fiber::Callback cb(make(i));
+        ASSERT(cb.isInline() == inlined);
+        HPS::Fiber::Callback moved(std::move(cb));
+        ASSERT(moved && !cb);
+    }
+    return t_allocs - begin;
+}
+
+//! 内联存放的回调构造和移动都不分配内存, 超过内联存储的每个回调恰好分配一次
+void check_callback()
+{
+    std::atomic<int> *done = &s_done;
+    ASSERT(count_callback([done](int i)
+                          { return [done, i]()
+                            { ++*done; }; },
+                          true) == 0);
+    std::shared_ptr<Session> session(new Session);
+    ASSERT(count_callback([&session](int i)
+                          { return std::bind(&Session::handle, session, i); },
+                          true) == 0);
+    ASSERT(count_callback([](int i)
+                          {
+        char pad[64] = {0};
+        return [pad, i]() { ++s_done; (void)pad; }; },
+                          false) == (uint64_t)s_tasks);
+    LOG_INFO(g_logger) << "callback: inline=0 allocations, heap=1 allocation per callback";
+}
+
+void run_all()
+{
+    //! 协程在每轮计数前创建, 上一轮的协程可能还在工作线程上退出, 不重用
+    std::vector<HPS::Fiber::ptr> fibers;
+    bench("fiber", [&fibers](HPS::Scheduler &sc, int i)
+          { sc.schedule(fibers[i]); },
+          [&fibers]()
+          {
+        fibers.clear();
+        for (int i = 0; i < s_tasks; ++i)
+        {
+            fibers.push_back(HPS::Fiber::ptr(new HPS::Fiber(&noop)));
+        } });
+
+    //! 内联的回调本身不分配, 只剩队列节点在线程间迁移时偶尔的分配
+    uint64_t schedules = (uint64_t)(s_rounds - 1) * s_tasks;
+    uint64_t allocs = bench("lambda", [](HPS::Scheduler &sc, int i)
+                            {
+        std::atomic<int> *done = &s_done;
+        sc.schedule([done, i]() { ++*done; }); });
+    ASSERT(allocs < schedules / 100);
+
+    std::shared_ptr<Session> session(new Session);
+    allocs = bench("bind", [&session](HPS::Scheduler &sc, int i)
+                   { sc.schedule(std::bind(&Session::handle, session->shared_from_this(), i)); });
+    ASSERT(allocs < schedules / 100);
+
+    //! 超过内联存储的捕获退化为一次堆分配
+    allocs = bench("large_lambda", [](HPS::Scheduler &sc, int i)
+                   {
+        char pad[64] = {0};
+        sc.schedule([pad, i]() { ++s_done; (void)pad; }); });
+    ASSERT(allocs >= schedules);
+}
+
+int main(int argc, char **argv)
+{
+    check_callback();
+    run_all();
+    HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    run_all();
+    return 0;
+}
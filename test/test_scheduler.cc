@@ -17,6 +17,138 @@ void test_fiber() {
     sleep(1);
 }
 
+static std::atomic<int> s_done = {0};
+
+void test_steal_task() {
+    //! 在线程池内再派生任务,进入本线程本地队列,由空闲线程窃取
+    for(int i = 0; i < 10; ++i) {
+        HPS::Scheduler::GetThis()->schedule([](){
+            for(int j = 0; j < 100; ++j) {
+                HPS::Fiber::YieldToReady();
+            }
+            ++s_done;
+        });
+    }
+}
+
+void test_work_stealing() {
+    HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    uint64_t begin = HPS::GetCurrentMS();
+    {
+        HPS::Scheduler sc(4, false, "steal");
+        sc.start();
+        for(int i = 0; i < 100; ++i) {
+            sc.schedule(&test_steal_task);
+        }
+        sc.stop();
+    }
+    LOG_INFO(g_logger) << "work stealing done=" << s_done
+                       << " used=" << (HPS::GetCurrentMS() - begin) << "ms";
+    HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(false);
+}
+
+//! 不让出的小回调: 普通调度每个回调都在任务协程上执行, 非阻塞调度直接在调度协程上执行
+void test_nonblocking() {
+    for(bool nonblocking : {false, true}) {
+        std::atomic<int> count = {0};
+        uint64_t begin = HPS::GetCurrentUS();
+        {
+            HPS::Scheduler sc(2, false, "nonblocking");
+            sc.start();
+            for(int i = 0; i < 100000; ++i) {
+                std::function<void()> cb = [&count](){ ++count; };
+                if(nonblocking) {
+                    sc.scheduleNonBlocking(cb);
+                } else {
+                    sc.schedule(cb);
+                }
+            }
+            sc.stop();
+        }
+        LOG_INFO(g_logger) << "nonblocking=" << nonblocking << " count=" << count
+                           << " used=" << (HPS::GetCurrentUS() - begin) << "us";
+    }
+}
+
+//! 后台任务积压时, 高优先级的请求任务不必排在整个积压之后
+void test_priority() {
+    for(bool use_priority : {false, true}) {
+        std::atomic<int> count = {0};
+        HPS::Scheduler::QueueDelayStats high, low;
+        {
+            HPS::Scheduler sc(1, false, "priority");
+            sc.start();
+            for(int i = 0; i < 2000; ++i) {
+                //! 每个后台任务占用约50us
+                sc.schedule([&count](){
+                    uint64_t begin = HPS::GetCurrentUS();
+                    while(HPS::GetCurrentUS() - begin < 50);
+                    ++count;
+                }, use_priority ? HPS::Scheduler::PRIORITY_LOW : HPS::Scheduler::PRIORITY_NORMAL);
+                if(i % 20 == 0) {
+                    sc.schedule([&count](){ ++count; },
+                                use_priority ? HPS::Scheduler::PRIORITY_HIGH : HPS::Scheduler::PRIORITY_NORMAL);
+                }
+            }
+            sc.stop();
+            //! 全部执行完后入队数与执行数一致
+            HPS::Scheduler::Metrics metrics = sc.getMetrics();
+            ASSERT(metrics.queued == 0 && metrics.scheduled == 2100 && metrics.executed == 2100);
+            high = sc.getQueueDelayStats(HPS::Scheduler::PRIORITY_HIGH);
+            low = sc.getQueueDelayStats(use_priority ? HPS::Scheduler::PRIORITY_LOW : HPS::Scheduler::PRIORITY_NORMAL);
+            std::stringstream ss;
+            sc.dumpMetrics(ss);
+            LOG_INFO(g_logger) << "metrics:\n" << ss.str();
+        }
+        LOG_INFO(g_logger) << "use_priority=" << use_priority << " count=" << count
+                           << " high: n=" << high.count
+                           << " avg=" << (high.count ? high.total_us / high.count : 0) << "us"
+                           << " max=" << high.max_us << "us"
+                           << " background: n=" << low.count
+                           << " avg=" << (low.count ? low.total_us / low.count : 0) << "us"
+                           << " max=" << low.max_us << "us";
+    }
+}
+
+//! 按名称从配置读取CPU放置, 任务在绑定的CPU上执行
+void test_affinity() {
+    for(auto& spec : {"0", "0-1,3", "node:0", "node:9"}) {
+        std::vector<int> cpus = HPS::Thread::ParseCpus(spec);
+        std::stringstream ss;
+        for(int cpu : cpus) {
+            ss << cpu << " ";
+        }
+        LOG_INFO(g_logger) << "spec=" << spec << " cpus=" << ss.str();
+    }
+
+    YAML::Node root = YAML::Load("scheduler:\n  cpu_affinity:\n    pinned: \"node:0\"\n");
+    HPS::Config::LoadFromYaml(root);
+    HPS::Scheduler sc(0, false, "pinned");
+    sc.start();
+    std::atomic<int> count = {0};
+    for(int i = 0; i < 10; ++i) {
+        sc.schedule([&count](){
+            LOG_INFO(g_logger) << "running on cpu " << sched_getcpu();
+            ++count;
+        });
+    }
+    std::stringstream ss;
+    sc.dump(ss);
+    LOG_INFO(g_logger) << ss.str();
+    sc.stop();
+
+    //! 解析不出CPU的放置退化为不绑核, 线程数按CPU数量
+    HPS::Scheduler fallback(0, false, "fallback", "node:9");
+    fallback.start();
+    count = 0;
+    for(int i = 0; i < 10; ++i) {
+        fallback.schedule([&count](){ ++count; });
+    }
+    fallback.stop();
+    LOG_INFO(g_logger) << "fallback: node:9 ran=" << count;
+    ASSERT(count == 10);
+}
+
 int main(int argc, char** argv) {
     LOG_INFO(g_logger) << "main";
     HPS::Scheduler sc(1, false, "test");
@@ -26,5 +158,12 @@ int main(int argc, char** argv) {
     sc.schedule(&test_fiber);
     sc.stop();
     LOG_INFO(g_logger) << "over";
+
+    test_work_stealing();
+    test_nonblocking();
+    test_affinity();
+    test_priority();
+    HPS::Config::Lookup<bool>("scheduler.work_stealing")->setValue(true);
+    test_priority();
     return 0;
 }
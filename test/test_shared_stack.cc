@@ -0,0 +1,132 @@
+#include "../include/HPS.h"
+#include "stack_allocator.h"
+#include "fd_manager.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const int s_connections = 5000;
+
+static std::atomic<int> s_parked = {0};
+static std::atomic<int> s_finished = {0};
+static std::atomic<int> s_errors = {0};
+
+//! 模拟一个空闲连接: 解析请求时用到一些栈,然后阻塞在read上
+void connection(int fd)
+{
+    char buf[1024];
+    memset(buf, 'a' + fd % 26, sizeof(buf));
+    ++s_parked;
+    char c = 0;
+    if (read(fd, &c, 1) != 1 || buf[0] != 'a' + fd % 26 || buf[sizeof(buf) - 1] != buf[0])
+    {
+        ++s_errors;
+    }
+    close(fd);
+    ++s_finished;
+}
+
+void bench_idle(bool shared)
+{
+    HPS::Config::Lookup<bool>("scheduler.shared_stack")->setValue(shared);
+    s_parked = s_finished = s_errors = 0;
+    std::vector<int> peers;
+    {
+        HPS::IOManager iom(1, false, shared ? "shared" : "standalone");
+        for (int i = 0; i < s_connections; ++i)
+        {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+            {
+                LOG_ERROR(g_logger) << "socketpair errno=" << errno;
+                break;
+            }
+            //! socketpair未被hook,手动登记使read走协程调度
+            HPS::FdMgr::GetInstance()->get(fds[0], true);
+            peers.push_back(fds[1]);
+            iom.schedule(std::bind(&connection, fds[0]));
+        }
+        while (s_parked < (int)peers.size())
+        {
+            usleep(10 * 1000);
+        }
+        //! 等待最后一个协程进入挂起
+        usleep(100 * 1000);
+
+        HPS::StackAllocator::Stats stats = HPS::StackAllocator::GetStats();
+        uint64_t resident = HPS::StackAllocator::GetTotalResidentBytes();
+        uint64_t saved = HPS::Fiber::SharedStackSavedBytes();
+        LOG_INFO(g_logger) << (shared ? "shared stack" : "standalone stack")
+                           << " connections=" << peers.size()
+                           << " stack_mapped_bytes=" << stats.mapped_bytes
+                           << " stack_resident_bytes=" << resident
+                           << " saved_bytes=" << saved
+                           << " bytes_per_idle_connection=" << (resident + saved) / peers.size();
+
+        for (int fd : peers)
+        {
+            write(fd, "x", 1);
+        }
+        while (s_finished < (int)peers.size())
+        {
+            usleep(10 * 1000);
+        }
+    }
+    for (int fd : peers)
+    {
+        close(fd);
+    }
+    HPS::StackAllocator::Trim();
+    LOG_INFO(g_logger) << "finished=" << s_finished << " errors=" << s_errors
+                       << " saved_bytes_after=" << HPS::Fiber::SharedStackSavedBytes();
+}
+
+//! 共享栈上的协程交替挂起,栈内容在换出换入后保持不变
+void test_switch()
+{
+    HPS::Fiber::GetThis();
+    std::vector<HPS::Fiber::ptr> fibers;
+    for (int i = 0; i < 64; ++i)
+    {
+        fibers.push_back(HPS::Fiber::ptr(new HPS::Fiber([i]()
+                                                        {
+            int values[256];
+            for(int j = 0; j < 256; ++j) {
+                values[j] = i * 1000 + j;
+            }
+            for(int round = 0; round < 10; ++round) {
+                HPS::Fiber::YieldToHold();
+                for(int j = 0; j < 256; ++j) {
+                    if(values[j] != i * 1000 + j) {
+                        ++s_errors;
+                    }
+                }
+            } },
+                                                        0, false, true)));
+    }
+    for (int round = 0; round < 11; ++round)
+    {
+        for (auto &i : fibers)
+        {
+            i->call();
+        }
+    }
+    for (auto &i : fibers)
+    {
+        ASSERT(i->getState() == HPS::Fiber::TERM);
+    }
+    LOG_INFO(g_logger) << "shared stack switch errors=" << s_errors
+                       << " saved_bytes=" << HPS::Fiber::SharedStackSavedBytes();
+}
+
+int main(int argc, char **argv)
+{
+    //! 登记已映射的栈以统计驻留内存
+    HPS::Config::Lookup<bool>("fiber.stack_registry")->setValue(true);
+    test_switch();
+    bench_idle(false);
+    bench_idle(true);
+    return 0;
+}
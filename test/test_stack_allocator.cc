@@ -0,0 +1,88 @@
+#include "../include/HPS.h"
+#include "stack_allocator.h"
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const int s_fibers = 10000;
+
+static void dump_stats(const std::string &name)
+{
+    HPS::StackAllocator::Stats stats = HPS::StackAllocator::GetStats();
+    uint64_t resident = HPS::StackAllocator::GetTotalResidentBytes();
+    LOG_INFO(g_logger) << name
+                       << " mapped=" << stats.mapped_count
+                       << " mapped_bytes=" << stats.mapped_bytes
+                       << " inuse=" << stats.inuse_count
+                       << " cached=" << stats.cached_count
+                       << " cached_bytes=" << stats.cached_bytes
+                       << " reuse=" << stats.reuse_count
+                       << " resident_bytes=" << resident
+                       << " resident_per_fiber=" << (stats.mapped_count ? resident / stats.mapped_count : 0);
+}
+
+//! 模拟一个连接协程: 使用少量栈后挂起
+void connection_fiber()
+{
+    char buf[2048];
+    memset(buf, 0, sizeof(buf));
+    HPS::Fiber::YieldToHold();
+}
+
+void test_resident()
+{
+    HPS::Fiber::GetThis();
+    std::vector<HPS::Fiber::ptr> fibers;
+    for (int i = 0; i < s_fibers; ++i)
+    {
+        HPS::Fiber::ptr fiber(new HPS::Fiber(&connection_fiber));
+        fiber->call();
+        fibers.push_back(fiber);
+    }
+    dump_stats("10k idle fibers");
+    for (auto &i : fibers)
+    {
+        i->call();
+    }
+    fibers.clear();
+    dump_stats("after destroy");
+
+    //! 重新创建时复用缓存中的栈
+    for (int i = 0; i < 16; ++i)
+    {
+        HPS::Fiber::ptr fiber(new HPS::Fiber(&connection_fiber));
+        fiber->call();
+        fiber->call();
+    }
+    dump_stats("after reuse");
+    HPS::StackAllocator::Trim();
+    dump_stats("after trim");
+}
+
+//! 映射失败抛出bad_alloc时不计入使用中
+void test_map_failure()
+{
+    uint64_t inuse = HPS::StackAllocator::GetStats().inuse_count;
+    bool thrown = false;
+    try
+    {
+        HPS::StackAllocator::Alloc(1ull << 50);
+    }
+    catch (std::bad_alloc &)
+    {
+        thrown = true;
+    }
+    LOG_INFO(g_logger) << "map failure: thrown=" << thrown
+                       << " inuse_before=" << inuse
+                       << " inuse_after=" << HPS::StackAllocator::GetStats().inuse_count;
+    ASSERT(thrown && HPS::StackAllocator::GetStats().inuse_count == inuse);
+}
+
+int main(int argc, char **argv)
+{
+    LOG_NAME("system")->setLevel(HPS::LogLevel::INFO);
+    //! 登记已映射的栈以统计驻留内存
+    HPS::Config::Lookup<bool>("fiber.stack_registry")->setValue(true);
+    test_resident();
+    test_map_failure();
+    return 0;
+}
@@ -0,0 +1,124 @@
+#include "../include/HPS.h"
+
+#include <random>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+class BenchTimerManager : public HPS::TimerManager
+{
+protected:
+    void onTimerInsertedAtFront() override {}
+};
+
+//! 模拟大量连接的读超时: 插入, 每次EAGAIN刷新, 连接关闭时取消
+void bench_churn(const std::string &engine, size_t count)
+{
+    HPS::Config::Lookup<std::string>("timer.engine")->setValue(engine);
+    BenchTimerManager manager;
+    std::mt19937 rng(count);
+    std::vector<HPS::Timer::ptr> timers;
+    timers.reserve(count);
+
+    uint64_t begin = HPS::GetCurrentUS();
+    for (size_t i = 0; i < count; ++i)
+    {
+        timers.push_back(manager.addTimer(1000 + rng() % 60000, []() {}));
+    }
+    uint64_t added = HPS::GetCurrentUS();
+    for (auto &i : timers)
+    {
+        i->refresh();
+    }
+    uint64_t refreshed = HPS::GetCurrentUS();
+    for (auto &i : timers)
+    {
+        i->cancel();
+    }
+    uint64_t canceled = HPS::GetCurrentUS();
+
+    LOG_INFO(g_logger) << "engine=" << engine << " timers=" << count
+                       << " add=" << (added - begin) * 1000.0 / count << "ns/op"
+                       << " refresh=" << (refreshed - added) * 1000.0 / count << "ns/op"
+                       << " cancel=" << (canceled - refreshed) * 1000.0 / count << "ns/op"
+                       << " has_timer=" << manager.hasTimer();
+}
+
+//! 到期时间与set引擎一致: 不早于设定时间, 取消的定时器不执行
+void test_expire(const std::string &engine)
+{
+    HPS::Config::Lookup<std::string>("timer.engine")->setValue(engine);
+    BenchTimerManager manager;
+    std::mt19937 rng(1);
+    int fired = 0, early = 0, late = 0, recurring = 0;
+    const int count = 2000;
+    std::vector<HPS::Timer::ptr> canceled;
+    for (int i = 0; i < count; ++i)
+    {
+        uint64_t ms = rng() % 700;
+        uint64_t deadline = HPS::GetCurrentMS() + ms;
+        manager.addTimer(ms, [&, deadline]()
+                         {
+            ++fired;
+            uint64_t now = HPS::GetCurrentMS();
+            if(now < deadline) {
+                ++early;
+            } else if(now > deadline + 20) {
+                ++late;
+            } });
+        canceled.push_back(manager.addTimer(ms, [&]()
+                                            { ++early; }));
+    }
+    HPS::Timer::ptr timer = manager.addTimer(50, [&]()
+                                             { ++recurring; },
+                                             true);
+    for (auto &i : canceled)
+    {
+        i->cancel();
+    }
+    uint64_t end = HPS::GetCurrentMS() + 1000;
+    while (HPS::GetCurrentMS() < end)
+    {
+        std::vector<std::function<void()>> cbs;
+        uint64_t next = manager.getNextTimer();
+        usleep(std::min<uint64_t>(next, 5) * 1000);
+        manager.listExpiredCb(cbs);
+        for (auto &cb : cbs)
+        {
+            cb();
+        }
+    }
+    timer->cancel();
+    LOG_INFO(g_logger) << "engine=" << engine << " fired=" << fired << "/" << count
+                       << " early=" << early << " late=" << late
+                       << " recurring=" << recurring
+                       << " has_timer=" << manager.hasTimer();
+}
+
+//! 时间轮空闲一段时间后插入定时器, 下次到期时间按当前时间计算, 不追赶空闲期间
+void test_wheel_idle()
+{
+    HPS::Config::Lookup<std::string>("timer.engine")->setValue("wheel");
+    BenchTimerManager manager;
+    manager.addTimer(1, []() {});
+    usleep(5 * 1000);
+    std::vector<std::function<void()>> cbs;
+    manager.listExpiredCb(cbs);
+    usleep(300 * 1000);
+    manager.addTimer(10, []() {});
+    uint64_t next = manager.getNextTimer();
+    LOG_INFO(g_logger) << "wheel idle: fired=" << cbs.size() << " next=" << next << "ms";
+    ASSERT(cbs.size() == 1 && next > 0);
+}
+
+int main(int argc, char **argv)
+{
+    test_wheel_idle();
+    test_expire("set");
+    test_expire("wheel");
+    for (size_t count : {10000, 100000, 1000000})
+    {
+        bench_churn("set", count);
+        bench_churn("wheel", count);
+    }
+    return 0;
+}
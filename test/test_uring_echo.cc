@@ -0,0 +1,232 @@
+#include "../include/HPS.h"
+#include "fd_manager.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static HPS::Logger::ptr g_logger = LOG_ROOT();
+
+static const int s_clients = 4;
+static const int s_requests = 10000;
+static const size_t s_message = 64;
+
+static int s_port = 0;
+static HPS::Semaphore s_listening;
+
+void handle_client(int fd)
+{
+    timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char buf[1024];
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            break;
+        }
+        if (send(fd, buf, n, 0) != n)
+        {
+            break;
+        }
+    }
+    close(fd);
+}
+
+void run_server()
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(sock, (sockaddr *)&addr, len) || listen(sock, 128) || getsockname(sock, (sockaddr *)&addr, &len))
+    {
+        LOG_ERROR(g_logger) << "listen errno=" << errno;
+        return;
+    }
+    s_port = ntohs(addr.sin_port);
+    s_listening.notify();
+    for (int i = 0; i < s_clients; ++i)
+    {
+        int fd = accept(sock, nullptr, nullptr);
+        if (fd < 0)
+        {
+            LOG_ERROR(g_logger) << "accept errno=" << errno;
+            break;
+        }
+        HPS::IOManager::GetThis()->schedule(std::bind(&handle_client, fd));
+    }
+    close(sock);
+}
+
+//! 客户端在普通线程中使用原始阻塞socket, 不计入服务端的系统调用
+void run_client()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(s_port);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)))
+    {
+        LOG_ERROR(g_logger) << "connect errno=" << errno;
+        return;
+    }
+    char buf[s_message];
+    memset(buf, 'x', sizeof(buf));
+    for (int i = 0; i < s_requests; ++i)
+    {
+        if (write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(buf))
+        {
+            ssize_t n = read(fd, buf + got, sizeof(buf) - got);
+            if (n <= 0)
+            {
+                break;
+            }
+            got += n;
+        }
+    }
+    close(fd);
+}
+
+void bench_echo(const std::string &backend, bool persistent = false, uint32_t busy_poll_us = 0)
+{
+    HPS::Config::Lookup<std::string>("iomanager.backend")->setValue(backend);
+    HPS::Config::Lookup<bool>("iomanager.persistent_epoll")->setValue(persistent);
+    HPS::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(busy_poll_us);
+    HPS::IOManager iom(1, false, backend);
+    iom.schedule(&run_server);
+    s_listening.wait();
+
+    uint64_t begin = HPS::GetCurrentUS();
+    std::vector<HPS::Thread::ptr> clients;
+    for (int i = 0; i < s_clients; ++i)
+    {
+        clients.push_back(HPS::Thread::ptr(new HPS::Thread(&run_client, "client_" + std::to_string(i))));
+    }
+    for (auto &i : clients)
+    {
+        i->join();
+    }
+    uint64_t used = HPS::GetCurrentUS() - begin;
+
+    //! hook的读写计数是线程本地的, 在服务端线程上读取
+    HPS::Semaphore sem;
+    uint64_t io_count = 0;
+    iom.schedule([&]()
+                 {
+        io_count = HPS::get_hook_io_count();
+        sem.notify(); });
+    sem.wait();
+    HPS::IOManager::SyscallStats stats = iom.getSyscallStats();
+    HPS::IOManager::IdleStats idle = iom.getIdleStats();
+    uint64_t requests = s_clients * s_requests;
+    uint64_t total = stats.epoll_wait + stats.epoll_ctl + stats.uring_enter + io_count;
+    LOG_INFO(g_logger) << "backend=" << backend << " uring=" << iom.hasUring()
+                       << " persistent=" << persistent
+                       << " busy_poll_us=" << busy_poll_us
+                       << " requests=" << requests
+                       << " req/s=" << requests * 1000000.0 / used
+                       << " epoll_wait=" << stats.epoll_wait
+                       << " epoll_ctl=" << stats.epoll_ctl
+                       << " uring_enter=" << stats.uring_enter
+                       << " read/write=" << io_count
+                       << " syscalls/req=" << (double)total / requests
+                       << " spin_us=" << idle.spin_us
+                       << " blocked_us=" << idle.blocked_us
+                       << " spin_hits=" << idle.spin_hits
+                       << " spin_misses=" << idle.spin_misses;
+}
+
+//! io_uring后端的超时通过链接的超时操作实现
+void test_timeout()
+{
+    HPS::Config::Lookup<std::string>("iomanager.backend")->setValue("io_uring");
+    HPS::IOManager iom(1, false, "timeout");
+    iom.schedule([]()
+                 {
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        HPS::FdMgr::GetInstance()->get(fds[0], true);
+        timeval tv = {0, 100 * 1000};
+        setsockopt(fds[0], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char c = 0;
+        uint64_t begin = HPS::GetCurrentMS();
+        ssize_t n = recv(fds[0], &c, 1, 0);
+        LOG_INFO(g_logger) << "uring=" << HPS::IOManager::GetThis()->hasUring()
+                           << " recv timeout n=" << n << " errno=" << errno
+                           << " used=" << (HPS::GetCurrentMS() - begin) << "ms";
+        write(fds[1], "y", 1);
+        n = recv(fds[0], &c, 1, 0);
+        LOG_INFO(g_logger) << "recv n=" << n << " c=" << c;
+        close(fds[0]);
+        close(fds[1]); });
+}
+
+//! 绑定到忙碌线程的任务不算其他线程的就绪任务, 空闲线程不会为它们空转
+void test_pinned_busy_poll()
+{
+    HPS::Config::Lookup<std::string>("iomanager.backend")->setValue("epoll");
+    HPS::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(200);
+    HPS::IOManager iom(2, false, "pinned");
+    std::atomic<int> busy_thread = {-1};
+    std::atomic<int> done = {0};
+    iom.schedule([&]()
+                 {
+        busy_thread = HPS::GetThreadId();
+        //! 不让出地占用线程100ms
+        uint64_t begin = HPS::GetCurrentUS();
+        while (HPS::GetCurrentUS() - begin < 100 * 1000)
+        {
+        } });
+    while (busy_thread == -1)
+    {
+    }
+    HPS::IOManager::IdleStats before = iom.getIdleStats();
+    for (int i = 0; i < 8; ++i)
+    {
+        iom.schedule([&done]()
+                     { ++done; },
+                     busy_thread);
+    }
+    //! 另一线程被定时器频繁唤醒, 每次进入idle都会轮询
+    iom.schedule([&done]()
+                 {
+        while (done < 8)
+        {
+            usleep(500);
+        } });
+    while (done < 8)
+    {
+        usleep(1000);
+    }
+    HPS::IOManager::IdleStats after = iom.getIdleStats();
+    LOG_INFO(g_logger) << "pinned busy_poll: done=" << done
+                       << " spin_hits=" << after.spin_hits - before.spin_hits
+                       << " spin_misses=" << after.spin_misses - before.spin_misses
+                       << " spin_us=" << after.spin_us - before.spin_us;
+    HPS::Config::Lookup<uint32_t>("iomanager.busy_poll_us")->setValue(0);
+}
+
+int main(int argc, char **argv)
+{
+    test_timeout();
+    test_pinned_busy_poll();
+    bench_echo("epoll");
+    //! 持久注册: 稳态下不再调用epoll_ctl
+    bench_echo("epoll", true);
+    //! 阻塞前忙轮询: 请求间隔短时省去睡眠和唤醒
+    bench_echo("epoll", true, 50);
+    bench_echo("io_uring");
+    return 0;
+}